@@ -0,0 +1,24 @@
+#!/usr/bin/env python3
+
+import math
+import sys
+
+from compare_times import read_times
+
+def mean_time(filename):
+    ((_, time),) = read_times(filename).items()
+    return math.exp(time['mean_log'])
+
+if __name__ == '__main__':
+    test_names = sys.argv[1:]
+    name_width = max(map(len, test_names + ['program']))
+    print(f'{"program":<{name_width}}  {"compiled (s)":>12}  {"interpreted (s)":>15}  {"ratio":>8}')
+    ratio_log_sum = 0
+    for test_name in test_names:
+        compiled = mean_time(f'progs/{test_name}-time.csv')
+        interpreted = mean_time(f'progs/{test_name}-interp-time.csv')
+        ratio = interpreted / compiled
+        ratio_log_sum += math.log(ratio)
+        print(f'{test_name:<{name_width}}  {compiled:>12.3e}  {interpreted:>15.3e}  {ratio:>7.1f}x')
+    mean_ratio = math.exp(ratio_log_sum / len(test_names))
+    print(f'The interpreter took {mean_ratio:.1f}x as long as compiled code (geometric mean)')
@@ -0,0 +1,79 @@
+#ifndef ASM_H
+#define ASM_H
+
+/**
+ * A buffer of x86-64 assembly lines, collected before they are printed so a
+ * peephole optimizer can rewrite them. Each line is a label or an
+ * instruction with up to three operands.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** The most operands an instruction can have */
+#define MAX_ASM_ARGS 3
+/** The longest mnemonic, label, or operand, including its terminator */
+#define ASM_TOKEN_SIZE 40
+
+/** A line of assembly */
+typedef struct {
+    /** True for a label, whose name is in mnemonic */
+    bool is_label;
+    char mnemonic[ASM_TOKEN_SIZE];
+    char args[MAX_ASM_ARGS][ASM_TOKEN_SIZE];
+    uint8_t num_args;
+} asm_line_t;
+
+/** A growable list of assembly lines */
+typedef struct {
+    asm_line_t *lines;
+    size_t num_lines;
+    size_t capacity;
+} asm_buffer_t;
+
+/** The rewrites the peephole optimizer makes, for counting how often each applies */
+typedef enum {
+    /** movq a, b; movq b, a drops the second move */
+    PEEPHOLE_MOVE_BACK,
+    /** movq r, m; movq m, s reads r instead of reloading m */
+    PEEPHOLE_STORE_LOAD,
+    /** movq $0, r becomes xorl r, r when the flags are dead */
+    PEEPHOLE_ZERO_XOR,
+    /** movq x, scratch; op scratch, y uses x directly */
+    PEEPHOLE_FORWARD_SCRATCH,
+    NUM_PEEPHOLE_RULES
+} peephole_rule_t;
+
+/** The name of each peephole rule, as reported by --stats */
+extern char *const PEEPHOLE_RULES[NUM_PEEPHOLE_RULES];
+
+/** Constructs an empty buffer */
+asm_buffer_t *init_buffer(void);
+
+/**
+ * Appends a line to a buffer, formatted like printf: either a label ending in
+ * ':' or an instruction whose operands are separated by ", ".
+ */
+void emit(asm_buffer_t *buffer, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * Runs the peephole optimizer over a buffer until no rule applies, adding the
+ * number of times each rule applied to hits (indexed by peephole_rule_t).
+ * Assumes, as the emitter guarantees, that the flags and the scratch
+ * registers %rax, %rcx and %rdx are never live across a label or jump.
+ */
+void optimize_buffer(asm_buffer_t *buffer, size_t *hits);
+
+/** Returns the low 32-bit half of a 64-bit register, or NULL if it has none */
+char *low_half(char *reg);
+
+/** Prints the lines in a buffer */
+void print_buffer(asm_buffer_t *buffer, FILE *stream);
+
+/** Frees a buffer */
+void free_buffer(asm_buffer_t *buffer);
+
+#endif /* ASM_H */
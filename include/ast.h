@@ -140,6 +140,9 @@ node_t *init_while_node(node_t *condition, node_t *body);
 /** Frees an AST node and all its descendants */
 void free_ast(node_t *node);
 
+/** Copies an AST node and all its descendants */
+node_t *copy_ast(node_t *node);
+
 /** Prints a string representation of an AST node to stderr */
 void print_ast(node_t *node);
 
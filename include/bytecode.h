@@ -0,0 +1,134 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+/**
+ * A register bytecode for TeenyBASIC and the virtual machine that runs it.
+ * Variables live in registers 0 to 25 and intermediate values in the
+ * registers after them. Constants are stored in the instructions that use
+ * them, so a statement like LET X = X + 1 is a single instruction.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast.h"
+
+/** The number of registers, which instructions name with a byte */
+#define NUM_VM_REGS 256
+
+/**
+ * The bytecode operations. The _RR forms read registers a and b, the _RC
+ * forms register a and the constant imm, and the _CR forms imm and b.
+ * Each group of branches is ordered like ir_cond_t, so adding a condition
+ * to the group's first operation gives the operation testing it.
+ */
+typedef enum {
+    /** dest = imm */
+    OP_LOAD,
+    /** dest = a */
+    OP_MOVE,
+    OP_ADD_RR,
+    OP_ADD_RC,
+    OP_SUB_RR,
+    OP_SUB_RC,
+    OP_SUB_CR,
+    OP_MUL_RR,
+    OP_MUL_RC,
+    OP_DIV_RR,
+    OP_DIV_RC,
+    OP_DIV_CR,
+    /** Prints a */
+    OP_PRINT_R,
+    /** Prints imm */
+    OP_PRINT_C,
+    /** Continues at target */
+    OP_JUMP,
+    /** Continues at target if `a cond b` */
+    OP_BRANCH_LT_RR,
+    OP_BRANCH_EQ_RR,
+    OP_BRANCH_GT_RR,
+    OP_BRANCH_LE_RR,
+    OP_BRANCH_NE_RR,
+    OP_BRANCH_GE_RR,
+    /** Continues at target if `a cond imm` */
+    OP_BRANCH_LT_RC,
+    OP_BRANCH_EQ_RC,
+    OP_BRANCH_GT_RC,
+    OP_BRANCH_LE_RC,
+    OP_BRANCH_NE_RC,
+    OP_BRANCH_GE_RC,
+    /**
+     * The end of a counting loop: adds the signed byte a to dest, then
+     * continues at target if `dest cond b`
+     */
+    OP_STEP_LT_RR,
+    OP_STEP_EQ_RR,
+    OP_STEP_GT_RR,
+    OP_STEP_LE_RR,
+    OP_STEP_NE_RR,
+    OP_STEP_GE_RR,
+    /** Adds the signed byte a to dest, then continues at target if `dest cond imm` */
+    OP_STEP_LT_RC,
+    OP_STEP_EQ_RC,
+    OP_STEP_GT_RC,
+    OP_STEP_LE_RC,
+    OP_STEP_NE_RC,
+    OP_STEP_GE_RC,
+    /** Ends the program */
+    OP_HALT,
+    NUM_OPCODES
+} opcode_t;
+
+/** A bytecode instruction. Which fields are used depends on the operation. */
+typedef struct {
+    /** The opcode_t */
+    uint8_t op;
+    /** The register written */
+    uint8_t dest;
+    /** The first register read, or the step of an OP_STEP operation */
+    uint8_t a;
+    /** The second register read */
+    uint8_t b;
+    /** The index of the instruction a jump or branch continues at */
+    int32_t target;
+    /** The constant operand */
+    value_t imm;
+} vm_instr_t;
+
+/** A program's bytecode */
+typedef struct {
+    vm_instr_t *instrs;
+    size_t length;
+    size_t capacity;
+} bytecode_t;
+
+/**
+ * Translates a program into bytecode ending with OP_HALT. Comparisons are
+ * fused with the branches that test them, and a loop whose body ends by
+ * adding a small constant to the variable its condition tests ends with a
+ * single OP_STEP operation.
+ *
+ * @param program the program's statements
+ * @param bytecode receives the program's bytecode, which the caller frees
+ *   with free_bytecode() even if the translation fails
+ * @return false if an expression is nested too deeply to fit in the registers
+ */
+bool lower_program(node_t *program, bytecode_t *bytecode);
+
+/**
+ * Runs bytecode from its first instruction until OP_HALT, starting with every
+ * register 0.
+ *
+ * @param bytecode the bytecode to run
+ * @param print whether to print the values PRINT statements print to stdout.
+ *   If false, they are ignored, so the program can be timed.
+ * @return false if the program divided by zero or overflowed a division,
+ *   where compiled code would trap
+ */
+bool run_bytecode(bytecode_t *bytecode, bool print);
+
+/** Frees the instructions of bytecode */
+void free_bytecode(bytecode_t *bytecode);
+
+#endif /* BYTECODE_H */
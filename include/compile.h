@@ -3,15 +3,32 @@
 
 #include <stdbool.h>
 
+#include "asm.h"
 #include "ast.h"
 
+/** Options controlling compilation, set from the command line */
+typedef struct {
+    /** Print the IR after lowering and after each pass instead of assembly */
+    bool emit_ir;
+    /** Print counts of what the optimizations did to stderr */
+    bool print_stats;
+    /** Run the peephole optimizer over the emitted assembly */
+    bool peephole;
+    /** Write a relocatable ELF object instead of assembly */
+    bool object;
+    /** Run the program in the compiler's process instead of writing its code */
+    bool run;
+} compile_options_t;
+
 /**
- * Prints x86-64 assembly code that implements the given TeenyBASIC statement.
- * This function will be called on each statement in the TeenyBASIC program in order.
+ * Generates x86-64 assembly code that implements the given TeenyBASIC program.
  *
- * @param node the statement to compile (either a PRINT, LET, label, GOTO, or IF)
+ * @param node the program's statements (a PRINT, LET, IF, WHILE, or SEQUENCE)
+ * @param options the options controlling compilation
+ * @param buffer receives the assembly of basic_main, after any lines already
+ *   in it. The peephole optimizer runs over the whole buffer.
  * @return true iff compilation succeeds
  */
-bool compile_ast(node_t *node);
+bool compile_ast(node_t *node, compile_options_t *options, asm_buffer_t *buffer);
 
 #endif /* COMPILE_H */
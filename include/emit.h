@@ -0,0 +1,31 @@
+#ifndef EMIT_H
+#define EMIT_H
+
+/**
+ * Translation of the IR into x86-64 assembly.
+ * Values are assigned registers by coloring their interference graph. Each
+ * variable gets its own copy inside every loop, so a variable can live in a
+ * register inside a hot loop even if it has to live on the stack elsewhere.
+ */
+
+#include "asm.h"
+#include "ir.h"
+
+/** The number of registers values can be allocated to */
+#define NUM_REGS 11
+
+/**
+ * Splits the live ranges of variables at loop boundaries: inside each loop
+ * with a preheader, every variable used or live there is renamed to a fresh
+ * copy, with copies in and out of it in the preheader and the loop exits.
+ */
+void split_loops(ir_program_t *program);
+
+/**
+ * Allocates registers for a program and emits the assembly for basic_main,
+ * including a prologue and epilogue sized to the registers and slots it uses,
+ * into a buffer
+ */
+void emit_program(ir_program_t *program, asm_buffer_t *buffer);
+
+#endif /* EMIT_H */
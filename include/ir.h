@@ -0,0 +1,313 @@
+#ifndef IR_H
+#define IR_H
+
+/**
+ * Definitions for the three-address intermediate representation of TeenyBASIC.
+ * The AST is lowered into a control flow graph of basic blocks, each holding a
+ * list of instructions of the form `dest = a op b` and ending in a terminator
+ * that transfers control to other blocks. Optimization passes rewrite the IR,
+ * and the emitter translates it into x86-64 assembly.
+ *
+ * Every instruction reads and writes numbered values. Values 0 to 25 are the
+ * variables A to Z; later values are either temporaries, each assigned by a
+ * single instruction, or further copies of a variable (for example, the copy of
+ * a variable that lives in a register inside a loop). Values that are assigned
+ * more than once but are not copies of a variable, like a product maintained
+ * by strength reduction, are named after the variable they derive from.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ast.h"
+
+/** The number of TeenyBASIC variables, which are IR values 0 to 25 */
+#define NUM_VARS 26
+
+/** The types of IR instructions */
+typedef enum {
+    /** dest = a */
+    IR_MOV,
+    /** dest = a + b */
+    IR_ADD,
+    /** dest = a - b */
+    IR_SUB,
+    /** dest = a * b */
+    IR_MUL,
+    /** dest = a / b, truncating */
+    IR_DIV,
+    /** dest = a - a / b * b, the remainder of the truncating division */
+    IR_MOD,
+    /** Prints a */
+    IR_PRINT
+} ir_op_t;
+
+/** The conditions a branch can test, arranged so that 5 - cond negates cond */
+typedef enum { COND_LT, COND_EQ, COND_GT, COND_LE, COND_NE, COND_GE } ir_cond_t;
+
+/** What range analysis proved about the operands of a division or remainder */
+typedef enum {
+    /** Nothing: the operands may have any 64-bit values */
+    RANGE_ANY,
+    /** The dividend is at least 0 */
+    RANGE_NON_NEGATIVE,
+    /** The dividend is in [0, 2^32) and the divisor in [1, 2^32) */
+    RANGE_32_BIT
+} ir_range_t;
+
+/** An operand of an instruction: either a value or an immediate constant */
+typedef struct {
+    bool is_imm;
+    /** The value read, if !is_imm */
+    size_t value;
+    /** The constant, if is_imm */
+    value_t imm;
+} ir_operand_t;
+
+/** A three-address instruction */
+typedef struct {
+    ir_op_t op;
+    /** The value the instruction assigns. Unused by IR_PRINT. */
+    size_t dest;
+    ir_operand_t a;
+    /** The second operand. Only used by binary operations. */
+    ir_operand_t b;
+    /** For IR_DIV and IR_MOD, what narrow_ranges() proved about the operands */
+    ir_range_t range;
+} ir_instr_t;
+
+/** The ways a basic block can end */
+typedef enum {
+    /** Continue at targets[0] */
+    TERM_JUMP,
+    /** Continue at targets[0] if `a cond b`, otherwise at targets[1] */
+    TERM_BRANCH,
+    /** Return from basic_main */
+    TERM_RETURN
+} ir_term_kind_t;
+
+struct ir_block;
+
+/** The control transfer at the end of a basic block */
+typedef struct {
+    ir_term_kind_t kind;
+    ir_cond_t cond;
+    ir_operand_t a;
+    ir_operand_t b;
+    struct ir_block *targets[2];
+} ir_term_t;
+
+/** A basic block: straight-line instructions followed by a terminator */
+typedef struct ir_block {
+    /** The block's index in its program's layout order */
+    size_t id;
+    ir_instr_t *instrs;
+    size_t num_instrs;
+    size_t instrs_capacity;
+    ir_term_t term;
+    /** The estimated number of times the block runs */
+    uint64_t weight;
+    /** The blocks that can transfer control here. Filled by compute_preds(). */
+    struct ir_block **preds;
+    size_t num_preds;
+} ir_block_t;
+
+/** A natural loop in the control flow graph */
+typedef struct {
+    /** The block every iteration starts at */
+    ir_block_t *header;
+    /** The only block outside the loop that jumps to the header, or NULL */
+    ir_block_t *preheader;
+    /** in_loop[id] is true iff the block with that id is part of the loop */
+    bool *in_loop;
+    /** The number of loops containing this one */
+    size_t depth;
+} ir_loop_t;
+
+/** Counts of what the optimizations did to a program, reported by --stats */
+typedef struct {
+    /**
+     * Registers that evaluating expressions left to right would have needed
+     * beyond those available, but evaluating them in Sethi-Ullman order did
+     * not. An estimate, since it ignores the variables live at the time.
+     */
+    size_t estimated_spills_avoided;
+    /** Operations replaced by a copy of an earlier operation's equal result */
+    size_t redundant_ops;
+    /** Loops replaced by the final values of the variables they count with */
+    size_t closed_loops;
+    /** Additions moved out of a loop by computing their total from a counter */
+    size_t closed_accumulators;
+    /** Multiplications replaced by a value updated with an induction variable */
+    size_t reduced_products;
+    /** Divisions and remainders whose operands were proven non-negative */
+    size_t narrowed_divisions;
+    /** Branches replaced by a jump because ranges decide their condition */
+    size_t folded_branches;
+    /** Jumps and branches retargeted past empty blocks that only jump onward */
+    size_t threaded_jumps;
+    /** Rarely run blocks moved out of line, after the rest of the code */
+    size_t cold_blocks;
+    /** Branches around short IF statements replaced by conditional moves */
+    size_t converted_branches;
+} ir_stats_t;
+
+/** A TeenyBASIC program in IR form */
+typedef struct {
+    /** The blocks in layout order. blocks[0] is the entry block. */
+    ir_block_t **blocks;
+    size_t num_blocks;
+    size_t blocks_capacity;
+    /** The variable each value belongs to ('A' to 'Z'), or 0 for temporaries */
+    var_name_t *names;
+    size_t num_values;
+    size_t values_capacity;
+    ir_stats_t stats;
+} ir_program_t;
+
+/** The values live at the boundaries of each block, as bit vectors */
+typedef struct {
+    /** The number of 64-bit words in each bit vector */
+    size_t words;
+    /** The values live on entry to each block, indexed by block id */
+    uint64_t **live_in;
+    /** The values live on exit from each block, indexed by block id */
+    uint64_t **live_out;
+    size_t num_blocks;
+} ir_liveness_t;
+
+/** Constructs an empty program with values for the variables A to Z */
+ir_program_t *init_program(void);
+
+/** Adds a new temporary to a program and returns its value number */
+size_t new_temp(ir_program_t *program);
+
+/** Adds a new value belonging to a variable to a program */
+size_t new_var_value(ir_program_t *program, var_name_t name);
+
+/** Constructs a block that is not yet part of any program */
+ir_block_t *init_block(uint64_t weight);
+
+/** Appends a block to a program's layout */
+void add_block(ir_program_t *program, ir_block_t *block);
+
+/**
+ * Inserts a block into a program's layout before the block at index,
+ * renumbering the blocks after it. Predecessors must be recomputed.
+ */
+void insert_block(ir_program_t *program, size_t index, ir_block_t *block);
+
+/** Appends an instruction to a block */
+void add_instr(ir_block_t *block, ir_instr_t instr);
+
+/** Inserts an instruction into a block before the instruction at index */
+void insert_instr(ir_block_t *block, size_t index, ir_instr_t instr);
+
+/** Removes the instruction at index from a block */
+void remove_instr(ir_block_t *block, size_t index);
+
+/** Constructs an operand reading a value */
+ir_operand_t value_operand(size_t value);
+
+/** Constructs an immediate operand */
+ir_operand_t imm_operand(value_t imm);
+
+/** Returns true iff two operands are the same value or the same constant */
+bool same_operand(ir_operand_t a, ir_operand_t b);
+
+/** Returns true iff an instruction assigns its dest value */
+bool has_dest(ir_instr_t *instr);
+
+/** Returns true iff an instruction reads its b operand */
+bool is_binary(ir_op_t op);
+
+/** Returns true iff an instruction can trap at runtime, so it must not be removed */
+bool may_trap(ir_instr_t *instr);
+
+/** Returns the number of successors of a block (0, 1, or 2) */
+size_t num_succs(ir_block_t *block);
+
+/**
+ * Computes `a op b` for a binary operation with TeenyBASIC's wrapping 64-bit
+ * semantics. Returns false if the operation would trap at runtime
+ * (division by zero or overflowing division), in which case it must not be
+ * folded.
+ */
+bool fold_op(ir_op_t op, value_t a, value_t b, value_t *result);
+
+/** Returns the IR operation for an arithmetic operator ('+', '-', '*', or '/') */
+ir_op_t ir_op(char op);
+
+/** Returns the IR condition for a comparison operator ('<', '=', or '>') */
+ir_cond_t ir_cond(char op);
+
+/** Returns true iff `a cond b` */
+bool eval_cond(ir_cond_t cond, value_t a, value_t b);
+
+/** Returns the condition that is true exactly when cond is false */
+ir_cond_t negate_cond(ir_cond_t cond);
+
+/** Returns the condition that tests `b cond' a` iff cond tests `a cond b` */
+ir_cond_t swap_cond(ir_cond_t cond);
+
+/** Renumbers the blocks in layout order and recomputes their predecessors */
+void compute_preds(ir_program_t *program);
+
+/** Removes blocks that cannot be reached from the entry block */
+void remove_unreachable(ir_program_t *program);
+
+/**
+ * Numbers the blocks reachable from block in postorder, setting order[id] and
+ * visited[id] for each. count is the number of blocks numbered so far.
+ */
+void postorder(ir_block_t *block, bool *visited, size_t *order, size_t *count);
+
+/**
+ * Computes the immediate dominator of each block, indexed by block id.
+ * The entry block is its own immediate dominator.
+ * Requires compute_preds() to be up to date.
+ */
+ir_block_t **compute_dominators(ir_program_t *program);
+
+/** Returns true iff block a dominates block b, given compute_dominators() */
+bool dominates(ir_block_t **idom, ir_block_t *a, ir_block_t *b);
+
+/**
+ * Finds the natural loops of a program, outermost loops first.
+ * Requires compute_preds() to be up to date.
+ */
+ir_loop_t *find_loops(ir_program_t *program, size_t *num_loops);
+
+/** Frees the loops returned by find_loops() */
+void free_loops(ir_loop_t *loops, size_t num_loops);
+
+/** Returns the number of 64-bit words in a bit vector of n values */
+size_t set_words(size_t n);
+
+/** Returns true iff value is in a bit vector */
+bool set_has(uint64_t *set, size_t value);
+
+/** Adds a value to a bit vector */
+void set_add(uint64_t *set, size_t value);
+
+/** Removes a value from a bit vector */
+void set_remove(uint64_t *set, size_t value);
+
+/**
+ * Computes the values live at the boundaries of each block.
+ * Requires compute_preds() to be up to date.
+ */
+ir_liveness_t *compute_liveness(ir_program_t *program);
+
+/** Frees the result of compute_liveness() */
+void free_liveness(ir_liveness_t *liveness);
+
+/** Prints a program's IR in a human-readable form */
+void print_ir(ir_program_t *program, FILE *stream);
+
+/** Frees a program and all its blocks */
+void free_program(ir_program_t *program);
+
+#endif /* IR_H */
@@ -0,0 +1,44 @@
+#ifndef JIT_H
+#define JIT_H
+
+/**
+ * In-process execution of compiled programs. The machine code for basic_main
+ * is placed in executable memory and called directly, with print_int and
+ * print_output provided by the compiler itself, so running a program takes
+ * no assembler, linker, or second process. As with the linked executables,
+ * print_int clobbers the caller-save registers and the call checks that the
+ * callee-save registers survive.
+ */
+
+#include <stdbool.h>
+#include <time.h>
+
+#include "asm.h"
+#include "precompute.h"
+
+/** How running a program went */
+typedef enum {
+    /** The program ran to completion */
+    RUN_OK,
+    /** The code could not be encoded or mapped executable */
+    RUN_ENCODING_ERROR,
+    /** The program ran but changed a callee-save register */
+    RUN_CONVENTION_VIOLATED
+} run_status_t;
+
+/**
+ * Encodes basic_main, runs it, and writes what it prints to stdout.
+ *
+ * @param code the assembly of basic_main
+ * @param output the precomputed output the code refers to, which may be empty
+ * @param start when the compiler started, from CLOCK_MONOTONIC
+ * @param print_stats whether to print to stderr how long after start the
+ *   machine code was ready to run and the program printed its first line
+ * @return RUN_ENCODING_ERROR if the code could not be encoded or mapped
+ *   executable, RUN_CONVENTION_VIOLATED if it did not preserve the
+ *   callee-save registers, which the call checks like runtime/call_check.s
+ */
+run_status_t run_code(asm_buffer_t *code, output_t *output, struct timespec *start,
+                      bool print_stats);
+
+#endif /* JIT_H */
@@ -0,0 +1,72 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+/**
+ * Direct output of relocatable ELF object files. The compiler encodes the
+ * x86-64 instructions in an assembly buffer into machine code itself, so the
+ * program can be linked without running an assembler first.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "asm.h"
+#include "precompute.h"
+
+/** A reference from machine code to a symbol the linker resolves */
+typedef struct {
+    /** The offset in the code of the 32-bit field to fill in */
+    uint64_t offset;
+    /** The symbol referred to */
+    char name[ASM_TOKEN_SIZE];
+    /** The ELF relocation type, R_X86_64_PC32 or R_X86_64_PLT32 */
+    uint32_t type;
+    /** The value added to the symbol's address minus the field's address */
+    int64_t addend;
+} reloc_t;
+
+/** Machine code being assembled, with the relocations it needs */
+typedef struct {
+    uint8_t *bytes;
+    size_t length;
+    size_t capacity;
+    reloc_t *relocs;
+    size_t num_relocs;
+    size_t relocs_capacity;
+} machine_code_t;
+
+/**
+ * Encodes assembly into machine code. Jumps to labels in the code are
+ * resolved; calls to other names and %rip-relative references to data
+ * become relocations.
+ *
+ * @param code the assembly of basic_main
+ * @param machine_code receives the machine code, which the caller frees with
+ *   free_machine_code() even if encoding fails
+ * @return false if the code has an instruction the encoder does not support
+ */
+bool assemble_buffer(asm_buffer_t *code, machine_code_t *machine_code);
+
+/**
+ * Frees the bytes and relocations of machine code.
+ *
+ * @param code the machine code, whose struct itself is not freed
+ */
+void free_machine_code(machine_code_t *code);
+
+/**
+ * Writes an x86-64 ELF object file whose .text section holds basic_main.
+ * Calls and jumps to names that are not labels in the code (print_int and
+ * print_output) become relocations against undefined symbols, and the
+ * precomputed output is placed in .rodata under OUTPUT_LABEL.
+ *
+ * @param code the assembly of basic_main, as the emitter and peephole
+ *   optimizer produce it
+ * @param output the precomputed output, which may be empty
+ * @param stream the stream to write the object file to
+ * @return false if the code has an instruction the encoder does not support
+ */
+bool write_object(asm_buffer_t *code, output_t *output, FILE *stream);
+
+#endif /* OBJECT_H */
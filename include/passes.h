@@ -0,0 +1,107 @@
+#ifndef PASSES_H
+#define PASSES_H
+
+/**
+ * Optimization passes over the IR.
+ * Each pass rewrites a program in place without changing its output.
+ */
+
+#include "ir.h"
+
+/**
+ * Sparse conditional constant and copy propagation. Finds the values known to
+ * be constant or equal to another value at each point, considering only the
+ * paths that can run given the branches whose conditions are known. Known
+ * constants and copies replace the operands that read them, operations on
+ * constants are folded, branches on constants become jumps, and blocks that
+ * can never run are removed. Operations that would trap are left alone.
+ */
+void propagate_constants(ir_program_t *program);
+
+/**
+ * Algebraic simplification. Applies identities such as x + 0 = x and
+ * x * 0 = 0, removes negations, and reassociates chains of + and - (and of *)
+ * so their constants are combined into one: (x + 5) + (y - 7) becomes
+ * (x + y) + -2. Only operations in the same block are combined. The results
+ * are exact under TeenyBASIC's wrapping arithmetic and truncating division.
+ */
+void reassociate(ir_program_t *program);
+
+/**
+ * Global value numbering. An operation computing the same function of the
+ * same operands as an earlier operation that dominates it, with no assignment
+ * to those operands on any path in between, is replaced by a copy of the
+ * earlier result. Commutative operations match with their operands swapped.
+ */
+void number_values(ir_program_t *program);
+
+/**
+ * Loop-invariant code motion. Moves operations whose operands have the same
+ * value on every iteration of a loop into the loop's preheader, innermost
+ * loops first. Operations that could trap are not moved.
+ */
+void hoist_invariants(ir_program_t *program);
+
+/**
+ * Loop unswitching. A loop containing a branch whose condition has the same
+ * value on every iteration is duplicated, with the condition tested once
+ * before the loop to pick the copy specialized for its outcome. The total
+ * growth in program size is bounded.
+ */
+void unswitch_loops(ir_program_t *program);
+
+/**
+ * Scalar evolution of loop variables. A variable the loop adds the same
+ * loop-invariant amount to once per iteration evolves as a linear function of
+ * the iteration count. A loop that does nothing but update such variables,
+ * and exits when one compares false against another or a constant with known
+ * starting values, runs a number of iterations that can be solved for with
+ * exact wrapping arithmetic; the loop is replaced by the variables' final
+ * values. In other loops, such as those that print, a variable the loop never
+ * reads is instead updated once after the loop, by a multiple of how far a
+ * counter moved.
+ */
+void evaluate_loops(ir_program_t *program);
+
+/**
+ * Strength reduction of induction variables. A variable incremented by a
+ * constant in a loop is a basic induction variable. A multiplication of one
+ * (plus a constant) by a loop-invariant factor, or by itself (plus another
+ * constant), is replaced by a new value computed once in the preheader and
+ * updated with additions wherever the variable is incremented: a product
+ * i * c grows by step * c, and i * i by step * (2 * i + step). A branch
+ * testing the product, like the exit test of WHILE T * T < N, then tests the
+ * new value. Other assignments to the variable recompute the product.
+ */
+void reduce_strength(ir_program_t *program);
+
+/**
+ * Value range analysis. Finds the range of numbers each value can hold at each
+ * point, starting from constants and narrowing the ranges along each edge of
+ * a branch to the values that take it, so a loop's exit test bounds its
+ * counter. A branch whose condition the ranges decide becomes a jump, and
+ * each division and remainder records whether its dividend is non-negative
+ * and whether both operands fit in 32 bits, which lets the emitter use
+ * cheaper instructions. Arithmetic that may overflow gives the full range.
+ */
+void narrow_ranges(ir_program_t *program);
+
+/**
+ * Removes instructions whose results are never read and copies of values
+ * to themselves. Operations that could trap are kept.
+ */
+void remove_dead_code(ir_program_t *program);
+
+/**
+ * Cleans up the control flow graph and orders its blocks for the emitter.
+ * Jumps and branches to empty blocks that only jump onward are retargeted to
+ * where those blocks lead, branches that continue at the same block either
+ * way or compare two constants become jumps, and a block only reached by a
+ * jump is merged into the block that jumps to it. Then each IF branch inside
+ * a loop that prints, when the other way does not, is moved to the end of
+ * the program, since printing is rare in a loop that runs often; the common
+ * path through the loop falls through without taken jumps.
+ */
+void lay_out_blocks(ir_program_t *program);
+
+#endif /* PASSES_H */
@@ -0,0 +1,62 @@
+#ifndef PRECOMPUTE_H
+#define PRECOMPUTE_H
+
+/**
+ * Compile-time evaluation of TeenyBASIC programs. Programs read no input, so
+ * the compiler can run their statements itself, leaving the executable only
+ * the output they print and whatever statements took too long to run.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "asm.h"
+#include "ast.h"
+
+/** The label of the precomputed output in the read-only data section */
+#define OUTPUT_LABEL "precomputed_output"
+
+/** The text printed by the statements run at compile time */
+typedef struct {
+    char *text;
+    size_t length;
+    size_t capacity;
+} output_t;
+
+/**
+ * Runs a program's statements in order in an interpreter, giving each
+ * top-level statement and each run of a loop its own budget of steps: one per
+ * statement run and per loop condition tested. Steps taken in a nested loop
+ * count against that loop's budget, not the enclosing one's, and the run as a
+ * whole stops after a fixed multiple of the budget. A loop that exceeds its
+ * budget, divides by zero, overflows a division, or reads a variable that has
+ * not been assigned stops after its last finished iteration. A statement
+ * outside any loop that does so stops before it. What ran is replaced by its
+ * effect.
+ *
+ * @param program the program's statements. Replaced by LET statements
+ *   assigning the variables their values where running stopped, followed by
+ *   the statements that finish the program from there (the loop that stopped,
+ *   the rest of each enclosing statement, and the rest of the program), or by
+ *   NULL if all of them ran.
+ * @param budget the number of steps each top-level statement and each run of
+ *   a loop may take
+ * @param output receives the text the statements that ran printed
+ */
+void precompute(node_t **program, size_t budget, output_t *output);
+
+/**
+ * Prints the assembly of a read-only data section holding precomputed output.
+ * It must be printed outside the code section.
+ */
+void emit_output_data(output_t *output);
+
+/**
+ * Appends the instructions that write precomputed output at the start of
+ * basic_main to a buffer. If the whole program was precomputed, they also
+ * return from basic_main; otherwise the compiled remainder of the program
+ * follows them.
+ */
+void emit_output_writer(asm_buffer_t *buffer, output_t *output, bool finished);
+
+#endif /* PRECOMPUTE_H */
@@ -0,0 +1,80 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+/**
+ * A graph-coloring register allocator.
+ * Clients describe the values that need a location as nodes of an interference
+ * graph, connect nodes that are live at the same time, and record the copies
+ * between nodes that coalescing should try to remove. Coloring assigns each
+ * node one of `num_colors` registers, or marks it as spilled.
+ *
+ * Nodes 0 to `num_colors - 1` are precolored: node `i` stands for register `i`.
+ * Interfering with a precolored node keeps a node out of that register.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The color of a node that did not fit in any register */
+#define SPILLED (-1)
+
+/** A copy between two nodes that coloring should try to make a no-op */
+typedef struct {
+    size_t a;
+    size_t b;
+    /** The estimated number of times the copy runs */
+    uint64_t weight;
+    /**
+     * Whether the nodes may be merged into one.
+     * Otherwise the copy only biases the choice of colors.
+     */
+    bool coalesce;
+} move_t;
+
+/** An interference graph */
+typedef struct {
+    /** The number of nodes, including the precolored nodes */
+    size_t num_nodes;
+    /** The number of registers available */
+    uint8_t num_colors;
+    /** A `num_nodes * num_nodes` bit matrix of interference edges */
+    uint64_t *edges;
+    /** The estimated cost of spilling each node */
+    uint64_t *costs;
+    /** The copies between nodes */
+    move_t *moves;
+    size_t num_moves;
+    size_t moves_capacity;
+    /** The register chosen for each node, or SPILLED */
+    int8_t *colors;
+    /** The number of copies removed by merging nodes */
+    size_t coalesced;
+} graph_t;
+
+/** Constructs a graph with `num_nodes` nodes, the first `num_colors` precolored */
+graph_t *init_graph(size_t num_nodes, uint8_t num_colors);
+
+/** Records that nodes a and b cannot share a register */
+void add_interference(graph_t *graph, size_t a, size_t b);
+
+/** Returns true iff nodes a and b cannot share a register */
+bool interferes(graph_t *graph, size_t a, size_t b);
+
+/** Adds to the estimated cost of spilling a node */
+void add_cost(graph_t *graph, size_t node, uint64_t cost);
+
+/** Records a copy between nodes a and b */
+void add_move(graph_t *graph, size_t a, size_t b, uint64_t weight, bool coalesce);
+
+/**
+ * Assigns a color to every node, filling `graph->colors`.
+ * Nodes that cannot be colored without interfering get SPILLED,
+ * choosing the nodes with the smallest cost per interference to spill.
+ */
+void color_graph(graph_t *graph);
+
+/** Frees a graph */
+void free_graph(graph_t *graph);
+
+#endif /* REGALLOC_H */
@@ -0,0 +1,54 @@
+#ifndef REGISTER_NEED_H
+#define REGISTER_NEED_H
+
+/**
+ * Sethi-Ullman numbering of expressions, which both code generators use to
+ * evaluate the operand of each operation that needs more registers first.
+ * Evaluating an operand has no side effects, so either order computes the
+ * same value, and the order that goes deeper first holds fewer results while
+ * the other operand is evaluated.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ast.h"
+
+/**
+ * The number of registers each operation in the expression last labeled
+ * needs, an open-addressing hash table keyed by the operation's node.
+ * A zero-initialized table is empty.
+ */
+typedef struct {
+    binary_node_t **nodes;
+    size_t *needs;
+    /** The number of slots the current expression uses, a power of 2 */
+    size_t capacity;
+    /** The number of slots allocated */
+    size_t allocated;
+} register_labels_t;
+
+/**
+ * Labels each operation in an expression with the number of registers needed
+ * to evaluate it when the operand needing more goes first, replacing the
+ * labels of the previous expression. Constants and variables need none.
+ * Each operation is visited once.
+ *
+ * @param labels the table to store the labels in
+ * @param node the expression
+ * @param fixed receives the number of registers the expression needs when the
+ *   left operand always goes first
+ * @return the number of registers the expression needs
+ */
+size_t label_registers(register_labels_t *labels, node_t *node, size_t *fixed);
+
+/**
+ * Returns whether an operation in the expression last labeled should evaluate
+ * its right operand first, because it needs more registers than the left.
+ */
+bool right_first(register_labels_t *labels, binary_node_t *bin_node);
+
+/** Frees the table of labels */
+void free_labels(register_labels_t *labels);
+
+#endif /* REGISTER_NEED_H */
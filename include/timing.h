@@ -0,0 +1,45 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+/**
+ * The statistics the benchmarks compare run times by. runtime/timing.c
+ * reports them for compiled programs and bin/interp for interpreted ones, so
+ * both print the same CSV format.
+ */
+
+#include <stdbool.h>
+#include <time.h>
+
+/** The number of seconds in a nanosecond */
+#define SEC_PER_NS 1e-9
+
+/**
+ * Returns the number of seconds from one clock reading to a later one.
+ *
+ * @param start the earlier reading
+ * @param end the later reading
+ * @return the seconds elapsed
+ */
+static inline double seconds_between(struct timespec *start, struct timespec *end) {
+    return end->tv_sec - start->tv_sec + (end->tv_nsec - start->tv_nsec) * SEC_PER_NS;
+}
+
+/**
+ * Reruns a program for at least a second of CPU time and at least 3 times,
+ * then prints the mean and variance of the log of its duration as CSV to
+ * stdout, and their geometric mean and spread to stderr. Each run counts as at
+ * least one tick of the CPU clock, since the shortest programs can finish
+ * before it advances.
+ *
+ * @param test_name the test's name, of which the first name_length characters
+ *   are printed
+ * @param name_length the length of the test's name
+ * @param label what the line on stderr calls the duration, e.g. "duration"
+ * @param run runs the program once, returning false if it failed
+ * @param program passed to run
+ * @return false if a run failed, in which case nothing is printed
+ */
+bool print_times(const char *test_name, int name_length, const char *label,
+                 bool (*run)(void *program), void *program);
+
+#endif /* TIMING_H */
@@ -0,0 +1,29 @@
+    # Prints the numbers below 5000 whose digits add up to 30, then how many
+    # numbers in that range have digits that add up to more than 20
+LET N = 0
+LET C = 0
+WHILE N < 5000
+    LET S = 0
+    LET M = N
+    WHILE M > 0
+        LET S = S + M - M / 10 * 10
+        LET M = M / 10
+    END WHILE
+    IF S = 30
+        PRINT N
+    ELSE
+        IF 1 < 2
+        END IF
+    END IF
+    IF S > 20
+        LET C = C + 1
+    END IF
+    LET N = N + 1
+END WHILE
+PRINT C
+
+#3999
+#4899
+#4989
+#4998
+#872
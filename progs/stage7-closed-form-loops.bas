@@ -0,0 +1,120 @@
+LET A = 7
+LET B = 0
+WHILE A < 1000000
+    LET A = A + 3
+    LET B = B - 5
+END WHILE
+PRINT A
+PRINT B
+
+LET I = 9223372036854775707
+LET C = 0
+WHILE I > 0
+    LET I = I + 100
+    LET C = C + 1
+END WHILE
+PRINT I
+PRINT C
+
+LET X = -9223372036854775800
+LET Y = 9223372036854775000
+LET C = 0
+WHILE X < Y
+    LET X = X - 1000000000000000000
+    LET Y = Y + 3000000000000000000
+    LET C = C + 1
+END WHILE
+PRINT X
+PRINT Y
+PRINT C
+
+LET S = 0
+WHILE S = 0
+    LET S = S + 5
+END WHILE
+PRINT S
+
+LET I = 0
+LET T = 0
+LET W = 0
+WHILE I < 6
+    PRINT I * I
+    LET W = W + I
+    LET T = T + 9
+    LET I = I + 1
+END WHILE
+PRINT T
+
+LET I = 0
+LET T = 0
+LET U = 0
+LET V = 0
+WHILE I < 10
+    PRINT I
+    LET T = T + 3
+    LET U = U + W
+    LET V = V - 4
+    LET I = I + 2
+END WHILE
+PRINT T
+PRINT U
+PRINT V
+
+LET Q = I * W
+LET R = 0
+LET Z = 1
+WHILE R < 50
+    LET R = R + 1
+    LET Q = Q + 3
+    LET Z = Z + W
+END WHILE
+PRINT Q
+PRINT Z
+
+LET I = 0
+LET C = 0
+WHILE I < 1000
+    LET J = 0
+    WHILE J < 1000
+        LET J = J + 1
+        LET C = C + 1
+    END WHILE
+    LET I = I + 1
+END WHILE
+PRINT C
+
+LET S = 0
+LET I = 0
+WHILE I < 300000000
+    LET S = S + 7
+    LET I = I + 1
+END WHILE
+PRINT S
+
+#1000000
+#-1666655
+#-9223372036854775709
+#2
+#8223372036854775816
+#-6223372036854776616
+#1
+#5
+#0
+#1
+#4
+#9
+#16
+#25
+#54
+#0
+#2
+#4
+#6
+#8
+#15
+#75
+#-20
+#300
+#751
+#1000000
+#2100000000
@@ -0,0 +1,35 @@
+LET M = 0
+WHILE M < 1
+    LET M = M + 1
+END WHILE
+LET A = M * 6 + 1
+LET B = 6 * M + 1
+PRINT A * B
+LET X = M + 10
+IF X > 5
+    LET M = M + 1
+END IF
+LET Y = M + 10
+PRINT X
+PRINT Y
+LET I = 0
+LET S = 0
+WHILE I < 3
+    LET S = S + I * I
+    LET T = I * I
+    LET I = I + 1
+    LET S = S + I * I + T
+END WHILE
+PRINT S
+LET P = M / 2
+IF P = 1
+    PRINT M / 2
+ELSE
+    PRINT M / 2 + 100
+END IF
+
+#49
+#11
+#12
+#24
+#1
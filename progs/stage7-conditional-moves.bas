@@ -0,0 +1,33 @@
+    # Branches on pseudorandom bits, which a branch predictor cannot learn
+LET S = 12345
+LET I = 0
+LET M = 0
+LET C = 0
+LET D = 0
+LET T = 0
+WHILE I < 2000000
+    LET S = S * 6364136223846793005 + 1442695040888963407
+    LET X = S / 4294967296
+    IF X > M
+        LET M = X
+    END IF
+    IF X < 0
+        LET C = C + 1
+    ELSE
+        LET D = D + X
+    END IF
+    IF X > 1000000
+        LET X = 1000000
+    END IF
+    LET T = T * 3 + X
+    LET I = I + 1
+END WHILE
+PRINT M
+PRINT C
+PRINT D
+PRINT T
+
+#2147483572
+#1000726
+#1073283805204821
+#-5064644212423468582
@@ -0,0 +1,326 @@
+    # Divides edge-case dividends by constant divisors, which compile to
+    # shifts and multiplications instead of idivq
+LET I = 0
+WHILE I < 13
+    IF I = 0
+        LET X = -9223372036854775808
+    END IF
+    IF I = 1
+        LET X = -9223372036854775807
+    END IF
+    IF I = 2
+        LET X = -4294967297
+    END IF
+    IF I = 3
+        LET X = -1000000007
+    END IF
+    IF I = 4
+        LET X = -7
+    END IF
+    IF I = 5
+        LET X = -1
+    END IF
+    IF I = 6
+        LET X = 0
+    END IF
+    IF I = 7
+        LET X = 1
+    END IF
+    IF I = 8
+        LET X = 6
+    END IF
+    IF I = 9
+        LET X = 7
+    END IF
+    IF I = 10
+        LET X = 2147483648
+    END IF
+    IF I = 11
+        LET X = 4611686018427387907
+    END IF
+    IF I = 12
+        LET X = 9223372036854775807
+    END IF
+    PRINT X / 1
+    PRINT X / 2
+    PRINT X / 3
+    PRINT X / 5
+    PRINT X / 7
+    PRINT X / 10
+    PRINT X / 16
+    PRINT X / 641
+    PRINT X / 4294967296
+    PRINT X / 1000000007
+    PRINT X / 9223372036854775807
+    PRINT X / -9223372036854775808
+    PRINT X / 4611686018427387904
+    PRINT X / -2
+    PRINT X / -3
+    PRINT X / -7
+    PRINT X / -16
+    PRINT X / -641
+    PRINT X / -4611686018427387904
+    PRINT X / -9223372036854775807
+    LET I = I + 1
+END WHILE
+
+#-9223372036854775808
+#-4611686018427387904
+#-3074457345618258602
+#-1844674407370955161
+#-1317624576693539401
+#-922337203685477580
+#-576460752303423488
+#-14389035938931007
+#-2147483648
+#-9223371972
+#-1
+#1
+#-2
+#4611686018427387904
+#3074457345618258602
+#1317624576693539401
+#576460752303423488
+#14389035938931007
+#2
+#1
+#-9223372036854775807
+#-4611686018427387903
+#-3074457345618258602
+#-1844674407370955161
+#-1317624576693539401
+#-922337203685477580
+#-576460752303423487
+#-14389035938931007
+#-2147483647
+#-9223371972
+#-1
+#0
+#-1
+#4611686018427387903
+#3074457345618258602
+#1317624576693539401
+#576460752303423487
+#14389035938931007
+#1
+#1
+#-4294967297
+#-2147483648
+#-1431655765
+#-858993459
+#-613566756
+#-429496729
+#-268435456
+#-6700417
+#-1
+#-4
+#0
+#0
+#0
+#2147483648
+#1431655765
+#613566756
+#268435456
+#6700417
+#0
+#0
+#-1000000007
+#-500000003
+#-333333335
+#-200000001
+#-142857143
+#-100000000
+#-62500000
+#-1560062
+#0
+#-1
+#0
+#0
+#0
+#500000003
+#333333335
+#142857143
+#62500000
+#1560062
+#0
+#0
+#-7
+#-3
+#-2
+#-1
+#-1
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#3
+#2
+#1
+#0
+#0
+#0
+#0
+#-1
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#1
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#6
+#3
+#2
+#1
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#-3
+#-2
+#0
+#0
+#0
+#0
+#0
+#7
+#3
+#2
+#1
+#1
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#-3
+#-2
+#-1
+#0
+#0
+#0
+#0
+#2147483648
+#1073741824
+#715827882
+#429496729
+#306783378
+#214748364
+#134217728
+#3350208
+#0
+#2
+#0
+#0
+#0
+#-1073741824
+#-715827882
+#-306783378
+#-134217728
+#-3350208
+#0
+#0
+#4611686018427387907
+#2305843009213693953
+#1537228672809129302
+#922337203685477581
+#658812288346769701
+#461168601842738790
+#288230376151711744
+#7194517969465503
+#1073741824
+#4611685986
+#0
+#0
+#1
+#-2305843009213693953
+#-1537228672809129302
+#-658812288346769701
+#-288230376151711744
+#-7194517969465503
+#-1
+#0
+#9223372036854775807
+#4611686018427387903
+#3074457345618258602
+#1844674407370955161
+#1317624576693539401
+#922337203685477580
+#576460752303423487
+#14389035938931007
+#2147483647
+#9223371972
+#1
+#0
+#1
+#-4611686018427387903
+#-3074457345618258602
+#-1317624576693539401
+#-576460752303423487
+#-14389035938931007
+#-1
+#-1
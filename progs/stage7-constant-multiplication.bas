@@ -0,0 +1,472 @@
+    # Multiplies edge-case values by constants, which compile to chains of
+    # leaq, shifts and adds or to imulq with an immediate
+LET I = 0
+WHILE I < 11
+    IF I = 0
+        LET X = -9223372036854775808
+    END IF
+    IF I = 1
+        LET X = -9223372036854775807
+    END IF
+    IF I = 2
+        LET X = -1000000007
+    END IF
+    IF I = 3
+        LET X = -7
+    END IF
+    IF I = 4
+        LET X = -1
+    END IF
+    IF I = 5
+        LET X = 0
+    END IF
+    IF I = 6
+        LET X = 1
+    END IF
+    IF I = 7
+        LET X = 7
+    END IF
+    IF I = 8
+        LET X = 2147483648
+    END IF
+    IF I = 9
+        LET X = 4611686018427387907
+    END IF
+    IF I = 10
+        LET X = 9223372036854775807
+    END IF
+    PRINT X * 0
+    PRINT X * 1
+    PRINT X * -1
+    PRINT X * 2
+    PRINT X * 3
+    PRINT X * 5
+    PRINT X * 6
+    PRINT X * 7
+    PRINT X * 9
+    PRINT X * 10
+    PRINT X * 12
+    PRINT X * 15
+    PRINT X * 24
+    PRINT X * 25
+    PRINT X * 27
+    PRINT X * 31
+    PRINT X * 33
+    PRINT X * 45
+    PRINT X * 63
+    PRINT X * 64
+    PRINT X * 65
+    PRINT X * 81
+    PRINT X * 100
+    PRINT X * 1000
+    PRINT X * -3
+    PRINT X * -5
+    PRINT X * -7
+    PRINT X * -31
+    PRINT X * -63
+    PRINT X * -1000
+    PRINT X * 2147483648
+    PRINT X * -2147483648
+    PRINT X * 1099511627776
+    PRINT X * 4294967297
+    PRINT X * -9223372036854775808
+    PRINT X * 9223372036854775807
+    LET I = I + 1
+END WHILE
+
+#0
+#-9223372036854775808
+#-9223372036854775808
+#0
+#-9223372036854775808
+#-9223372036854775808
+#0
+#-9223372036854775808
+#-9223372036854775808
+#0
+#0
+#-9223372036854775808
+#0
+#-9223372036854775808
+#-9223372036854775808
+#-9223372036854775808
+#-9223372036854775808
+#-9223372036854775808
+#-9223372036854775808
+#0
+#-9223372036854775808
+#-9223372036854775808
+#0
+#0
+#-9223372036854775808
+#-9223372036854775808
+#-9223372036854775808
+#-9223372036854775808
+#-9223372036854775808
+#0
+#0
+#0
+#0
+#-9223372036854775808
+#0
+#-9223372036854775808
+#0
+#-9223372036854775807
+#9223372036854775807
+#2
+#-9223372036854775805
+#-9223372036854775803
+#6
+#-9223372036854775801
+#-9223372036854775799
+#10
+#12
+#-9223372036854775793
+#24
+#-9223372036854775783
+#-9223372036854775781
+#-9223372036854775777
+#-9223372036854775775
+#-9223372036854775763
+#-9223372036854775745
+#64
+#-9223372036854775743
+#-9223372036854775727
+#100
+#1000
+#9223372036854775805
+#9223372036854775803
+#9223372036854775801
+#9223372036854775777
+#9223372036854775745
+#-1000
+#2147483648
+#-2147483648
+#1099511627776
+#-9223372032559808511
+#-9223372036854775808
+#-1
+#0
+#-1000000007
+#1000000007
+#-2000000014
+#-3000000021
+#-5000000035
+#-6000000042
+#-7000000049
+#-9000000063
+#-10000000070
+#-12000000084
+#-15000000105
+#-24000000168
+#-25000000175
+#-27000000189
+#-31000000217
+#-33000000231
+#-45000000315
+#-63000000441
+#-64000000448
+#-65000000455
+#-81000000567
+#-100000000700
+#-1000000007000
+#3000000021
+#5000000035
+#7000000049
+#31000000217
+#63000000441
+#1000000007000
+#-2147483663032385536
+#2147483663032385536
+#7293008949991702528
+#-4294967327064771079
+#-9223372036854775808
+#-9223372035854775801
+#0
+#-7
+#7
+#-14
+#-21
+#-35
+#-42
+#-49
+#-63
+#-70
+#-84
+#-105
+#-168
+#-175
+#-189
+#-217
+#-231
+#-315
+#-441
+#-448
+#-455
+#-567
+#-700
+#-7000
+#21
+#35
+#49
+#217
+#441
+#7000
+#-15032385536
+#15032385536
+#-7696581394432
+#-30064771079
+#-9223372036854775808
+#-9223372036854775801
+#0
+#-1
+#1
+#-2
+#-3
+#-5
+#-6
+#-7
+#-9
+#-10
+#-12
+#-15
+#-24
+#-25
+#-27
+#-31
+#-33
+#-45
+#-63
+#-64
+#-65
+#-81
+#-100
+#-1000
+#3
+#5
+#7
+#31
+#63
+#1000
+#-2147483648
+#2147483648
+#-1099511627776
+#-4294967297
+#-9223372036854775808
+#-9223372036854775807
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#0
+#1
+#-1
+#2
+#3
+#5
+#6
+#7
+#9
+#10
+#12
+#15
+#24
+#25
+#27
+#31
+#33
+#45
+#63
+#64
+#65
+#81
+#100
+#1000
+#-3
+#-5
+#-7
+#-31
+#-63
+#-1000
+#2147483648
+#-2147483648
+#1099511627776
+#4294967297
+#-9223372036854775808
+#9223372036854775807
+#0
+#7
+#-7
+#14
+#21
+#35
+#42
+#49
+#63
+#70
+#84
+#105
+#168
+#175
+#189
+#217
+#231
+#315
+#441
+#448
+#455
+#567
+#700
+#7000
+#-21
+#-35
+#-49
+#-217
+#-441
+#-7000
+#15032385536
+#-15032385536
+#7696581394432
+#30064771079
+#-9223372036854775808
+#9223372036854775801
+#0
+#2147483648
+#-2147483648
+#4294967296
+#6442450944
+#10737418240
+#12884901888
+#15032385536
+#19327352832
+#21474836480
+#25769803776
+#32212254720
+#51539607552
+#53687091200
+#57982058496
+#66571993088
+#70866960384
+#96636764160
+#135291469824
+#137438953472
+#139586437120
+#173946175488
+#214748364800
+#2147483648000
+#-6442450944
+#-10737418240
+#-15032385536
+#-66571993088
+#-135291469824
+#-2147483648000
+#4611686018427387904
+#-4611686018427387904
+#0
+#-9223372034707292160
+#0
+#-2147483648
+#0
+#4611686018427387907
+#-4611686018427387907
+#-9223372036854775802
+#-4611686018427387895
+#4611686018427387919
+#-9223372036854775790
+#-4611686018427387883
+#4611686018427387931
+#-9223372036854775778
+#36
+#-4611686018427387859
+#72
+#4611686018427387979
+#-4611686018427387823
+#-4611686018427387811
+#4611686018427388003
+#4611686018427388039
+#-4611686018427387715
+#192
+#4611686018427388099
+#4611686018427388147
+#300
+#3000
+#4611686018427387895
+#-4611686018427387919
+#4611686018427387883
+#4611686018427387811
+#4611686018427387715
+#-3000
+#6442450944
+#-6442450944
+#3298534883328
+#4611686031312289795
+#-9223372036854775808
+#4611686018427387901
+#0
+#9223372036854775807
+#-9223372036854775807
+#-2
+#9223372036854775805
+#9223372036854775803
+#-6
+#9223372036854775801
+#9223372036854775799
+#-10
+#-12
+#9223372036854775793
+#-24
+#9223372036854775783
+#9223372036854775781
+#9223372036854775777
+#9223372036854775775
+#9223372036854775763
+#9223372036854775745
+#-64
+#9223372036854775743
+#9223372036854775727
+#-100
+#-1000
+#-9223372036854775805
+#-9223372036854775803
+#-9223372036854775801
+#-9223372036854775777
+#-9223372036854775745
+#1000
+#-2147483648
+#2147483648
+#-1099511627776
+#9223372032559808511
+#-9223372036854775808
+#1
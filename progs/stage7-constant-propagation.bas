@@ -0,0 +1,46 @@
+LET A = 6
+LET B = A * 7
+IF B = 42
+    LET C = B + 1
+ELSE
+    LET C = 0
+END IF
+PRINT C
+LET I = 0
+LET K = 3
+LET S = 0
+WHILE I < 5
+    LET D = K * 2
+    LET E = I
+    LET S = S + D + E
+    LET I = I + 1
+END WHILE
+PRINT S
+IF K > 5
+    PRINT 1
+END IF
+LET X = 10
+LET Y = X
+LET X = X + 1
+PRINT Y
+PRINT X
+LET N = 0
+LET M = 1
+WHILE N < 3
+    LET M = M * 2
+    LET N = N + 1
+END WHILE
+PRINT M
+IF I = 5
+    LET Z = 100
+ELSE
+    LET Z = 100
+END IF
+PRINT Z * 3
+
+#43
+#40
+#10
+#11
+#8
+#300
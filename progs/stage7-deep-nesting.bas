@@ -0,0 +1,11 @@
+LET A = 2
+LET B = 3
+PRINT (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + (A + A))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))
+LET C = (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + (B - (A + B))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))
+PRINT C
+IF (A * (1 - (B * (A - (1 * (B - (A * (1 - (B * (A - (1 * (B - (A * (1 - (B * (A - (1 * (B - (A * (1 - (B * (A - (1 * (B - (A * (1 - (B * (A - (1 * (B - (A * (1 - (B * (A - (1 * (B - (A * (1 - (B * (A - (1 * (B - (A * (1 - (B * (A - (1 * (B - (A * (1 - (B * (A - (1 * (B - (A * (1 - (B * (A - (1 * (B - (A * (1 - (B * (A - (1 * (B - (A * (1 - (B * (A - (1 * (B - (A * (1 - (B * (A - (1 * (B - (A * (1 - (B * (A - (1 * (B - (A * (1 - (B * (A - (1 * (B - (A * (1 - (B * (A - (1 * (B - (A * (1 - (B * (A - 1)))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))) < C
+    PRINT 1
+END IF
+#602
+#3
+#1
@@ -0,0 +1,58 @@
+LET A = 7
+LET B = 3
+LET M = 0
+WHILE M < 0
+    LET M = M + 1
+END WHILE
+LET I = 0
+LET S = 0
+WHILE I < 10
+    LET S = S + A * B + I
+    IF M = 1
+        LET S = S + 100
+    ELSE
+        LET S = S - 1
+    END IF
+    LET I = I + 1
+END WHILE
+PRINT S
+WHILE M < 1
+    LET M = M + 1
+END WHILE
+LET I = 0
+WHILE I < 4
+    LET C = A * B
+    IF M > 0
+        PRINT C + I
+    END IF
+    LET A = A + 1
+    LET I = I + 1
+END WHILE
+PRINT A
+LET Z = 0
+LET I = 0
+WHILE I < 0
+    PRINT 5 / Z
+END WHILE
+LET J = 0
+LET T = 0
+WHILE J < 3
+    LET K = 0
+    WHILE K < 3
+        IF B < M
+            LET T = T + 1000
+        END IF
+        LET T = T + J * B + K * M
+        LET K = K + 1
+    END WHILE
+    LET J = J + 1
+END WHILE
+PRINT T
+
+#245
+#21
+#25
+#29
+#33
+#11
+#36
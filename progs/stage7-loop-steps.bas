@@ -0,0 +1,82 @@
+    # Loops the bytecode interpreter ends with a single step-and-branch
+    # instruction, and loops that look alike but must not be fused
+LET S = 0
+LET I = 0
+WHILE I < 10
+    LET S = S + I
+    LET I = I + 1
+END WHILE
+PRINT S
+LET I = 20
+WHILE 0 < I
+    LET S = S - I
+    LET I = I - 3
+END WHILE
+PRINT S
+PRINT I
+LET N = 7
+LET I = 0
+WHILE I < N
+    LET S = S + I * I
+    LET I = I + 2
+END WHILE
+PRINT S
+PRINT I
+LET I = 0
+WHILE I < 10
+    IF I > 4
+        LET S = S + 100
+    ELSE
+        LET I = I + 1
+    END IF
+    LET I = I + 1
+END WHILE
+PRINT S
+LET I = 0
+WHILE I < 10
+    PRINT I
+    IF I = 3
+        LET I = I + 5
+    END IF
+    LET I = I + 1
+END WHILE
+LET I = 0
+WHILE I < 1000
+    LET I = I + 300
+END WHILE
+PRINT I
+LET I = 5
+WHILE I = 5
+    LET I = I + 1
+END WHILE
+PRINT I
+LET I = 0
+LET J = 0
+WHILE I < 3
+    WHILE J < 3
+        LET J = J + 1
+    END WHILE
+    LET S = S + J
+    LET J = 0
+    LET I = I + 1
+END WHILE
+PRINT S
+PRINT 0 - (1 - (2 - (3 - (4 - (5 - (6 - (7 - (8 - (9 - N))))))))) / -2
+PRINT (7 + 8) * (9 - 2) / 4
+
+#45
+#-32
+#-1
+#24
+#8
+#424
+#0
+#1
+#2
+#3
+#9
+#1200
+#6
+#433
+#-1
+#26
@@ -0,0 +1,41 @@
+LET C = 1
+LET D = 2
+LET E = 3
+LET F = 4
+LET G = 5
+LET H = 6
+LET J = 7
+LET K = 8
+LET L = 9
+LET M = 10
+LET T = 0
+LET I = 0
+WHILE I < 5
+    LET C = C + I
+    LET D = D + C
+    LET E = E + D
+    LET F = F + E
+    LET G = G + F
+    LET H = H + G
+    LET J = J + H
+    LET K = K + J
+    LET L = L + K
+    LET M = M + L
+    LET B = M * 3 + I
+    LET S = B - C
+    LET T = T + S * 5
+    LET I = I + 1
+END WHILE
+PRINT C + D + E + F + G + H + J + K + L + M + T
+PRINT B
+LET I = 0
+WHILE I < 3
+    PRINT I * B
+    LET I = I + 1
+END WHILE
+
+#139505
+#16111
+#0
+#16111
+#32222
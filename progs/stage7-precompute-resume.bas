@@ -0,0 +1,24 @@
+LET I = 0
+LET S = 0
+WHILE I < 30000
+    LET J = 0
+    WHILE J < 5
+        LET S = S * 3 + I - J
+        LET J = J + 1
+    END WHILE
+    IF I - I / 5000 * 5000 = 0
+        PRINT S
+    END IF
+    LET I = I + 1
+END WHILE
+PRINT S
+PRINT I
+
+#-58
+#5188282930438969082
+#5518632803448167726
+#-283580766952820126
+#6608479394637969046
+#-4808085045153560118
+#267848554161444696
+#30000
@@ -0,0 +1,37 @@
+LET X = 0
+LET Y = 0
+LET I = 0
+WHILE I < 2
+    LET X = X - 1000000007
+    LET Y = Y + 9223372036854775807
+    LET I = I + 1
+END WHILE
+PRINT ((X + 5) + 7) - 12
+PRINT (X + 9223372036854775807) + 10
+PRINT ((0 - X) * 7) * -3
+PRINT 0 - (X - Y)
+PRINT ((X * 1) - 0) + (0 * Y)
+PRINT 10 - (3 - X)
+PRINT 10 - (X + 3)
+PRINT (X / 3) / 5
+PRINT (X / -3) / 5
+PRINT (Y / 4611686018427387904) / 2
+PRINT ((X + 1) + (Y - 1)) + ((X * 3) * (Y * 5))
+PRINT (X - (0 - Y)) + ((0 - X) + Y)
+PRINT (5 - X) - (7 - Y)
+PRINT ((X * -1) - X) - X
+
+#-2000000014
+#9223372034854775803
+#-42000000294
+#2000000012
+#-2000000014
+#-2000000007
+#2000000021
+#-133333334
+#133333334
+#0
+#58000000404
+#-4
+#2000000010
+#6000000042
@@ -0,0 +1,80 @@
+LET A = 0
+LET B = 0
+LET I = 0
+WHILE I < 4
+    LET A = A * 3 - 47
+    LET B = B + 5 - I * 3
+    LET I = I + 1
+END WHILE
+PRINT A
+PRINT B
+PRINT A - A / B * B
+PRINT A / B * B
+PRINT B - B / A * A
+LET Q = A / B
+LET R = A - A / B * B
+PRINT Q
+PRINT R
+PRINT Q * B + R
+LET Q = 0 - A / B
+LET R = 0 - A - (0 - A) / B * B
+PRINT Q
+PRINT R
+
+LET N = 0
+LET D = 2
+WHILE D < 60
+    IF 360 / D * D = 360
+        LET N = N + 1
+    END IF
+    IF 360 - 360 / D * D = 0
+        LET N = N + 100
+    END IF
+    LET D = D + 1
+END WHILE
+PRINT N
+
+LET X = -9223372036854775807 - 1
+LET Y = 3
+PRINT X - X / Y * Y
+PRINT X / Y * Y
+
+LET S = 0
+LET X = -50
+WHILE X < 50
+    LET Y = X / 7 + 9
+    LET Q = X / Y
+    LET R = X - X / Y * Y
+    LET S = S * 31 + Q * 1000 + R
+    LET X = X + 3
+END WHILE
+PRINT S
+
+LET S = 0
+LET A = -400
+LET B = 9
+WHILE A < 400
+    LET Q = A / B
+    LET C = A + B
+    LET R = A - A / B * B
+    LET S = S * 7 + Q * 100 + R + C
+    LET A = A + 37
+    LET B = B - 2
+END WHILE
+PRINT S
+
+#-1880
+#2
+#0
+#-1880
+#2
+#-940
+#0
+#-1880
+#940
+#0
+#1717
+#-2
+#-9223372036854775806
+#-62005037281079652
+#-3366966622944325039
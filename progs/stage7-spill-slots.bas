@@ -0,0 +1,82 @@
+LET A = -5
+LET B = 17
+LET C = 14
+LET D = -12
+LET F = 18
+LET I = 17
+LET M = 10
+LET N = -4
+LET Q = -8
+LET S = 14
+LET T = 15
+LET U = 10
+LET V = 5
+LET W = 20
+LET X = -11
+LET Y = -6
+LET T = 0
+WHILE T < 3
+    LET S = 0
+    WHILE S < 2
+        LET W = 0
+        WHILE W < 3
+            LET B = Q - 3
+            LET W = W + 1
+        END WHILE
+        LET S = S + 1
+    END WHILE
+    PRINT Y * 9
+    LET C = T * 6
+    LET U = 0
+    WHILE U < 1
+        PRINT D
+        LET U = U + 1
+    END WHILE
+    LET Q = T * 8
+    LET T = T + 1
+END WHILE
+LET W = 0
+WHILE W < 1
+    LET V = 0
+    WHILE V < 1
+        WHILE T < 1
+            LET M = V * 6
+            LET A = W * 8
+            LET X = F
+            LET T = T + 1
+        END WHILE
+        LET V = V + 1
+    END WHILE
+    LET N = W * 5
+    LET I = D + 9
+    LET W = W + 1
+END WHILE
+PRINT Q
+PRINT A
+PRINT B
+PRINT C
+PRINT I
+PRINT M
+PRINT N
+PRINT T
+PRINT V
+PRINT W
+PRINT X
+
+#-54
+#-12
+#-54
+#-12
+#-54
+#-12
+#16
+#-5
+#5
+#12
+#-3
+#10
+#0
+#3
+#1
+#1
+#-11
@@ -0,0 +1,90 @@
+LET N = 1000003
+LET T = 2
+WHILE T * T < N + 1
+    IF N / T * T = N
+        LET T = N
+    END IF
+    LET T = T + 1
+END WHILE
+PRINT T
+
+LET C = 0
+WHILE C < 3
+    LET C = C + 1
+END WHILE
+LET I = 10
+LET S = 0
+WHILE I > -10
+    LET S = S + I * C - (I - 4) * 7
+    LET I = I - 3
+END WHILE
+PRINT S
+PRINT I
+
+LET I = 0
+LET S = 0
+WHILE I < 40
+    LET S = S + (I + 2) * (I - 5)
+    LET I = I + 3
+END WHILE
+PRINT S
+
+LET I = 3037000490
+LET S = 0
+LET K = 0
+WHILE K < 30
+    LET S = S + I * I
+    PRINT I * 3074457345618258603
+    LET I = I + 1
+    LET K = K + 1
+END WHILE
+PRINT S
+
+LET X = 0
+LET S = 0
+WHILE X < 5
+    LET Y = 0
+    WHILE Y < X * X
+        LET S = S + X * 100 + Y * Y
+        LET Y = Y + 2
+    END WHILE
+    LET X = X + 1
+END WHILE
+PRINT S
+
+#1001
+#168
+#-11
+#6412
+#6148914692248850702
+#-9223372035842442311
+#-6148914690224183708
+#-3074457344605925105
+#1012333498
+#3074457346630592101
+#6148914692248850704
+#-9223372035842442309
+#-6148914690224183706
+#-3074457344605925103
+#1012333500
+#3074457346630592103
+#6148914692248850706
+#-9223372035842442307
+#-6148914690224183704
+#-3074457344605925101
+#1012333502
+#3074457346630592105
+#6148914692248850708
+#-9223372035842442305
+#-6148914690224183702
+#-3074457344605925099
+#1012333504
+#3074457346630592107
+#6148914692248850710
+#-9223372035842442303
+#-6148914690224183700
+#-3074457344605925097
+#1012333506
+#3074457346630592109
+#824354363615
+#5884
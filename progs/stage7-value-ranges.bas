@@ -0,0 +1,63 @@
+    # Divisions whose operands loop bounds keep small and non-negative
+
+LET S = 0
+LET I = 0
+WHILE I < 300
+    LET J = 1
+    WHILE J < 40
+        LET S = S + I / J * 7 + (I - I / J * J)
+        LET J = J + 3
+    END WHILE
+    IF I < 0
+        PRINT 0 - 1
+    END IF
+    IF I > -1
+        LET S = S + I / 8 + (I - I / 8 * 8) + I / 7 + (I - I / 7 * 7) - I / -7
+    END IF
+    LET I = I + 1
+END WHILE
+PRINT S
+
+LET X = 4294967295
+LET Y = 1
+LET S = 0
+WHILE Y < 20
+    LET S = S * 3 + X / Y + (X - X / Y * Y)
+    LET Y = Y + 1
+END WHILE
+PRINT S
+LET X = X + 1
+LET Y = 1
+WHILE Y < 20
+    LET S = S * 3 + X / Y + (X - X / Y * Y)
+    LET Y = Y + 1
+END WHILE
+PRINT S
+
+LET K = 20
+LET S = 0
+WHILE K > -50
+    LET K = K - 3
+    LET S = S * 5 + K / 4 + (K - K / 5 * 5) + K / (K - K / 7 * 7 + 9)
+END WHILE
+PRINT S
+
+LET P = 1
+LET N = 0
+WHILE P > 0
+    LET P = P * 3
+    LET N = N + 1
+END WHILE
+PRINT N
+PRINT P / 7
+PRINT P / 8
+PRINT P - P / 9 * 9
+
+#637943
+#2024031132077477991
+#1257155603581119739
+#104452390167309597
+#40
+#-898439802093231830
+#-786134826831577851
+#-7
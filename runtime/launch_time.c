@@ -0,0 +1,53 @@
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "timing.h"
+
+// The number of times each executable is launched
+const size_t LAUNCHES = 1000;
+
+// Runs an executable to completion with its output discarded.
+// Returns false if it could not be run or exited with an error.
+bool launch(char *path, int null_fd) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        return false;
+    }
+    if (pid == 0) {
+        dup2(null_fd, STDOUT_FILENO);
+        execl(path, path, (char *) NULL);
+        _exit(127);
+    }
+    int status;
+    return waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+           WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd < 0) {
+        perror("/dev/null");
+        return 1;
+    }
+
+    // Measure the wall-clock time from starting each executable to its exit
+    for (int i = 1; i < argc; i++) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t run = 0; run < LAUNCHES; run++) {
+            if (!launch(argv[i], null_fd)) {
+                fprintf(stderr, "%s failed\n", argv[i]);
+                return 1;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        fprintf(stderr, "%s mean exec-to-exit time: %e seconds\n", argv[i],
+                seconds_between(&start, &end) / LAUNCHES);
+    }
+    close(null_fd);
+}
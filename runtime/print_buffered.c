@@ -0,0 +1,61 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "print_format.h"
+
+char output_buffer[OUTPUT_BUFFER_SIZE];
+size_t output_length = 0;
+// Whether flush_at_exit() will run when the program exits
+bool flush_registered = false;
+
+// Calls write(2), turning its errors into negated error numbers
+long write_stdout(const char *text, size_t length) {
+    ssize_t written = write(STDOUT_FILENO, text, length);
+    return written < 0 ? -errno : written;
+}
+
+// Writes out the buffered output
+void flush_output(void) {
+    write_all(output_buffer, output_length);
+    output_length = 0;
+}
+
+// Flushes the output when the program exits. on_exit() is used rather than
+// atexit(), which needs the C runtime's startup files that bin/% leaves out.
+void flush_at_exit(int status, void *arg) {
+    (void) status;
+    (void) arg;
+    flush_output();
+}
+
+// Makes room for length more bytes at the end of the buffer
+void reserve_output(size_t length) {
+    if (!flush_registered) {
+        on_exit(flush_at_exit, NULL);
+        flush_registered = true;
+    }
+    if (OUTPUT_BUFFER_SIZE - output_length < length) {
+        flush_output();
+    }
+}
+
+// A function that can be called from assembly to print text the compiler
+// precomputed, a sequence of lines in print_int's format
+void print_output(const char *text, size_t length) {
+    reserve_output(length);
+    if (length > OUTPUT_BUFFER_SIZE) {
+        write_all(text, length);
+        return;
+    }
+    memcpy(output_buffer + output_length, text, length);
+    output_length += length;
+}
+
+// A function that can be called from assembly to print an integer
+void print_int(value_t value) {
+    reserve_output(MAX_LINE_LENGTH);
+    output_length += format_line(value, output_buffer + output_length);
+    clobber_caller_saves();
+}
@@ -0,0 +1,96 @@
+#ifndef PRINT_FORMAT_H
+#define PRINT_FORMAT_H
+
+// The parts of the runtimes that do not depend on libc: the output buffer's
+// size, the conversion of a value to a line of decimal text, writing text out
+// in full, and clobbering the registers a call may overwrite. Each buffered
+// runtime defines write_stdout() with the system calls it has available.
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast.h"
+
+// The size of the output buffer, which is written out whenever it fills up
+#define OUTPUT_BUFFER_SIZE (1 << 16)
+// The longest line print_int writes: a sign, 19 digits, and a newline
+#define MAX_LINE_LENGTH 21
+
+// The two decimal digits of each number from 0 to 99, in order
+static const char DIGIT_PAIRS[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Writes up to length bytes of text to stdout once.
+// Returns the number written, or the negated error number if it failed.
+long write_stdout(const char *text, size_t length);
+
+// Writes text to stdout, retrying writes that are interrupted or partial
+static inline void write_all(const char *text, size_t length) {
+    while (length > 0) {
+        long written = write_stdout(text, length);
+        if (written < 0) {
+            if (written == -EINTR) {
+                continue;
+            }
+            return;
+        }
+        text += written;
+        length -= written;
+    }
+}
+
+// Writes value in decimal followed by a newline to line, which has room for
+// MAX_LINE_LENGTH bytes. Returns the length of the line. The digits are
+// counted first, so they can be written straight into place two at a time
+// from the end of the line.
+static inline size_t format_line(value_t value, char *line) {
+    uint64_t magnitude = value < 0 ? -(uint64_t) value : (uint64_t) value;
+    size_t digits = 1;
+    for (uint64_t power = 10; digits < 20 && magnitude >= power; power *= 10) {
+        digits++;
+    }
+    char *start = line;
+    if (value < 0) {
+        *start++ = '-';
+    }
+    char *end = start + digits;
+    *end = '\n';
+    while (magnitude >= 100) {
+        end -= 2;
+        end[0] = DIGIT_PAIRS[magnitude % 100 * 2];
+        end[1] = DIGIT_PAIRS[magnitude % 100 * 2 + 1];
+        magnitude /= 100;
+    }
+    if (magnitude >= 10) {
+        start[0] = DIGIT_PAIRS[magnitude * 2];
+        start[1] = DIGIT_PAIRS[magnitude * 2 + 1];
+    }
+    else {
+        start[0] = '0' + magnitude;
+    }
+    return start + digits + 1 - line;
+}
+
+// Overwrites all caller-save registers with garbage, so a program that relies
+// on them surviving a call to the runtime fails
+static inline void clobber_caller_saves(void) {
+    asm("movq $0x6A2CFE91073BD845, %%rax\n"
+        "movq $0x03BAD7C14F2E6589, %%rdi\n"
+        "movq $0x5D41EA960C72F8B3, %%rsi\n"
+        "movq $0xEC364B2D5A7F9810, %%rdx\n"
+        "movq $0xFC85AD49320BE167, %%rcx\n"
+        "movq $0x529A48CDB7163E0F, %%r8\n"
+        "movq $0x92E1587A4BDCF630, %%r9\n"
+        "movq $0x47DC36501F89AEB2, %%r10\n"
+        "movq $0xAF4B29785C61ED30, %%r11\n"
+        :
+        :
+        : "rax", "rdi", "rsi", "rdx", "rcx", "r8", "r9", "r10", "r11");
+}
+
+#endif /* PRINT_FORMAT_H */
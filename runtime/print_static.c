@@ -0,0 +1,56 @@
+#include "print_format.h"
+
+// A runtime for statically linked programs that uses no libc at all: output
+// is written with raw system calls, and static_start.s calls flush_output()
+// before exiting.
+
+// The Linux x86-64 system call number of write
+#define SYS_WRITE 1
+
+char static_buffer[OUTPUT_BUFFER_SIZE];
+size_t static_length = 0;
+
+// Calls write(1, text, length) without libc, which returns the negated
+// error number itself
+long write_stdout(const char *text, size_t length) {
+    long result;
+    asm volatile("syscall"
+                 : "=a"(result)
+                 : "a"(SYS_WRITE), "D"(1), "S"(text), "d"(length)
+                 : "rcx", "r11", "memory");
+    return result;
+}
+
+// Writes out the buffered output. Called by static_start.s before exiting.
+void flush_output(void) {
+    write_all(static_buffer, static_length);
+    static_length = 0;
+}
+
+// Copies bytes with rep movsb, which keeps the compiler from calling memcpy
+void copy_bytes(char *dest, const char *src, size_t length) {
+    asm volatile("rep movsb" : "+D"(dest), "+S"(src), "+c"(length) : : "memory");
+}
+
+// A function that can be called from assembly to print text the compiler
+// precomputed, a sequence of lines in print_int's format
+void print_output(const char *text, size_t length) {
+    if (OUTPUT_BUFFER_SIZE - static_length < length) {
+        flush_output();
+    }
+    if (length > OUTPUT_BUFFER_SIZE) {
+        write_all(text, length);
+        return;
+    }
+    copy_bytes(static_buffer + static_length, text, length);
+    static_length += length;
+}
+
+// A function that can be called from assembly to print an integer
+void print_int(value_t value) {
+    if (OUTPUT_BUFFER_SIZE - static_length < MAX_LINE_LENGTH) {
+        flush_output();
+    }
+    static_length += format_line(value, static_buffer + static_length);
+    clobber_caller_saves();
+}
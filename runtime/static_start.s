@@ -0,0 +1,25 @@
+# A libc-free entry point for statically linked programs. It runs the same
+# checks as call_check.s: basic_main() must satisfy the x86-64 calling
+# convention, leaving the callee-save registers and all memory above %rsp at
+# its start unmodified. Output and exit use raw system calls, and the output
+# print_static.c buffered is flushed before exiting.
+
+.include "runtime/call_check.inc"
+
+    # Checks succeeded; exit with code 0
+    call flush_output
+    movl $0, %edi
+    movl $60, %eax # exit
+    syscall
+
+    # Checks failed; print a warning message and exit with error status
+    check_failed:
+    call flush_output
+    movl $2, %edi # stderr
+    leaq check_failed_msg(%rip), %rsi
+    movl $check_failed_length, %edx
+    movl $1, %eax # write
+    syscall
+    movl $1, %edi
+    movl $60, %eax # exit
+    syscall
@@ -0,0 +1,56 @@
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "timing.h"
+
+// Returns the amount of CPU time one run of the program takes, in seconds.
+// Around the shortest programs the clock can read the same time twice, so the
+// duration is at least one tick (log(0) would make the mean -inf).
+double time_run(bool (*run)(void *program), void *program, double resolution,
+                bool *ran) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    *ran = run(program);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+    double duration = seconds_between(&start, &end);
+    return duration > resolution ? duration : resolution;
+}
+
+bool print_times(const char *test_name, int name_length, const char *label,
+                 bool (*run)(void *program), void *program) {
+    struct timespec tick;
+    clock_getres(CLOCK_PROCESS_CPUTIME_ID, &tick);
+    double resolution = tick.tv_sec + tick.tv_nsec * SEC_PER_NS;
+
+    // Rerun the program for at least a second and at least 3 times
+    double duration_sum = 0;
+    double duration_log_sum = 0, duration_log_square_sum = 0;
+    size_t runs = 0;
+    while (duration_sum < 1.0 || runs < 3) {
+        bool ran;
+        double duration = time_run(run, program, resolution, &ran);
+        if (!ran) {
+            return false;
+        }
+        duration_sum += duration;
+        double log_duration = log(duration);
+        duration_log_sum += log_duration;
+        duration_log_square_sum += log_duration * log_duration;
+        runs++;
+    }
+
+    /* Compute the mean and standard deviation of the estimated time the program takes
+     * We use log(duration), so we compute the geometric mean and variance.
+     * This makes the mean much more resistant to large outliers. */
+    double mean_log_duration = duration_log_sum / runs;
+    double variance_log_duration =
+        (duration_log_square_sum / runs - mean_log_duration * mean_log_duration) / runs;
+    printf(
+        "test_name,mean_log_duration,variance_log_duration\n"
+        "%.*s,%f,%e\n",
+        name_length, test_name, mean_log_duration, variance_log_duration);
+    fprintf(stderr, "%.*s mean %s: %e seconds (+/- %e x)\n", name_length, test_name,
+            label, exp(mean_log_duration), expm1(sqrt(variance_log_duration)));
+    return true;
+}
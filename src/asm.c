@@ -0,0 +1,389 @@
+#include "asm.h"
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+char *const PEEPHOLE_RULES[NUM_PEEPHOLE_RULES] = {
+    "move-back",
+    "store-load",
+    "zero-xor",
+    "forward-scratch",
+};
+
+// The registers the emitter only uses within a single IR instruction
+char *const SCRATCH_REGS[] = {"%rax", "%rcx", "%rdx"};
+#define NUM_SCRATCH_REGS 3
+
+// Each 64-bit register followed by its low 32 bits
+char *const REG_HALVES[][2] = {
+    {"%rax", "%eax"},  {"%rbx", "%ebx"},   {"%rcx", "%ecx"},   {"%rdx", "%edx"},
+    {"%rsi", "%esi"},  {"%rdi", "%edi"},   {"%r8", "%r8d"},    {"%r9", "%r9d"},
+    {"%r10", "%r10d"}, {"%r11", "%r11d"},  {"%r12", "%r12d"},  {"%r13", "%r13d"},
+    {"%r14", "%r14d"}, {"%r15", "%r15d"},
+};
+#define NUM_REG_HALVES (sizeof(REG_HALVES) / sizeof(REG_HALVES[0]))
+
+// Instructions whose last operand is only written, not read
+char *const MOVES[] = {"movq", "movl", "leaq", "popq"};
+#define NUM_MOVES (sizeof(MOVES) / sizeof(MOVES[0]))
+
+// Instructions that leave the flags alone
+char *const FLAG_PRESERVING[] = {"movq", "movl", "leaq", "pushq", "popq", "push", "pop"};
+#define NUM_FLAG_PRESERVING (sizeof(FLAG_PRESERVING) / sizeof(FLAG_PRESERVING[0]))
+
+asm_buffer_t *init_buffer(void) {
+    asm_buffer_t *buffer = malloc(sizeof(asm_buffer_t));
+    assert(buffer != NULL);
+    buffer->lines = NULL;
+    buffer->num_lines = 0;
+    buffer->capacity = 0;
+    return buffer;
+}
+
+/*
+ * Inserts a line into a buffer before the line at index.
+ */
+void insert_line(asm_buffer_t *buffer, size_t index, asm_line_t line) {
+    if (buffer->num_lines == buffer->capacity) {
+        buffer->capacity = buffer->capacity == 0 ? 256 : buffer->capacity * 2;
+        buffer->lines = realloc(buffer->lines, buffer->capacity * sizeof(asm_line_t));
+        assert(buffer->lines != NULL);
+    }
+    memmove(&buffer->lines[index + 1], &buffer->lines[index],
+            (buffer->num_lines - index) * sizeof(asm_line_t));
+    buffer->lines[index] = line;
+    buffer->num_lines++;
+}
+
+/*
+ * Removes the line at index from a buffer.
+ */
+void remove_line(asm_buffer_t *buffer, size_t index) {
+    memmove(&buffer->lines[index], &buffer->lines[index + 1],
+            (buffer->num_lines - index - 1) * sizeof(asm_line_t));
+    buffer->num_lines--;
+}
+
+/*
+ * Splits a line of assembly into its mnemonic and operands.
+ */
+asm_line_t parse_line(char *text) {
+    asm_line_t line = {.num_args = 0};
+    size_t length = strlen(text);
+    assert(length > 0);
+    if (text[length - 1] == ':') {
+        line.is_label = true;
+        assert(length < ASM_TOKEN_SIZE);
+        memcpy(line.mnemonic, text, length - 1);
+        line.mnemonic[length - 1] = '\0';
+        return line;
+    }
+    line.is_label = false;
+    char *space = strchr(text, ' ');
+    size_t mnemonic_length = space != NULL ? (size_t) (space - text) : length;
+    assert(mnemonic_length < ASM_TOKEN_SIZE);
+    memcpy(line.mnemonic, text, mnemonic_length);
+    line.mnemonic[mnemonic_length] = '\0';
+    char *arg = space;
+    while (arg != NULL) {
+        arg++;
+        char *end = strstr(arg, ", ");
+        size_t arg_length = end != NULL ? (size_t) (end - arg) : strlen(arg);
+        assert(line.num_args < MAX_ASM_ARGS && arg_length < ASM_TOKEN_SIZE);
+        memcpy(line.args[line.num_args], arg, arg_length);
+        line.args[line.num_args][arg_length] = '\0';
+        line.num_args++;
+        arg = end != NULL ? end + 1 : NULL;
+    }
+    return line;
+}
+
+void emit(asm_buffer_t *buffer, const char *format, ...) {
+    char text[4 * ASM_TOKEN_SIZE];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    assert(length > 0 && (size_t) length < sizeof(text));
+    insert_line(buffer, buffer->num_lines, parse_line(text));
+}
+
+/*
+ * Constructs an instruction line.
+ */
+asm_line_t make_instr(char *mnemonic, char *a, char *b) {
+    asm_line_t line = {.is_label = false, .num_args = 0};
+    strcpy(line.mnemonic, mnemonic);
+    char *args[] = {a, b};
+    for (size_t i = 0; i < 2 && args[i] != NULL; i++) {
+        strcpy(line.args[line.num_args++], args[i]);
+    }
+    return line;
+}
+
+/*
+ * Returns true iff a line is an instruction with the given mnemonic.
+ */
+bool is_instr(asm_line_t *line, char *mnemonic) {
+    return !line->is_label && strcmp(line->mnemonic, mnemonic) == 0;
+}
+
+/*
+ * Returns true iff a mnemonic is in a list.
+ */
+bool in_list(char *mnemonic, char *const *list, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (strcmp(mnemonic, list[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Returns true iff an operand is a register.
+ */
+bool is_reg(char *arg) {
+    return arg[0] == '%';
+}
+
+/*
+ * Returns true iff an operand is in memory.
+ */
+bool is_mem(char *arg) {
+    return strchr(arg, '(') != NULL;
+}
+
+/*
+ * Returns true iff an operand is an immediate that fits in 32 bits, so it
+ * can be the source of any arithmetic instruction.
+ */
+bool is_imm32(char *arg) {
+    if (arg[0] != '$') {
+        return false;
+    }
+    long long imm = strtoll(arg + 1, NULL, 10);
+    return imm >= INT32_MIN && imm <= INT32_MAX;
+}
+
+/*
+ * Returns true iff an operand mentions a 64-bit register, or its low half.
+ */
+bool mentions_reg(char *arg, char *reg) {
+    for (size_t i = 0; i < NUM_REG_HALVES; i++) {
+        if (strcmp(REG_HALVES[i][0], reg) != 0) {
+            continue;
+        }
+        // %r8 is a prefix of %r8d, which is the same register anyway.
+        return strstr(arg, reg) != NULL || strstr(arg, REG_HALVES[i][1]) != NULL;
+    }
+    return strstr(arg, reg) != NULL;
+}
+
+/*
+ * Returns true iff an operand is exactly a register or its low half.
+ */
+bool is_exactly_reg(char *arg, char *reg) {
+    return is_reg(arg) && mentions_reg(arg, reg);
+}
+
+/*
+ * Returns true iff an instruction may read a register.
+ */
+bool reads_reg(asm_line_t *line, char *reg) {
+    if (is_instr(line, "call")) {
+        return strcmp(reg, "%rdi") == 0;
+    }
+    if (is_instr(line, "cqto") || is_instr(line, "retq")) {
+        return strcmp(reg, "%rax") == 0;
+    }
+    if (is_instr(line, "idivq") || is_instr(line, "divl") ||
+        (is_instr(line, "imulq") && line->num_args == 1)) {
+        if (strcmp(reg, "%rax") == 0 || strcmp(reg, "%rdx") == 0) {
+            return true;
+        }
+    }
+    if (line->mnemonic[0] == 'x' && line->num_args == 2 &&
+        strcmp(line->args[0], line->args[1]) == 0) {
+        // xor of a register with itself does not depend on its value.
+        return false;
+    }
+    for (uint8_t i = 0; i < line->num_args; i++) {
+        bool written_only = i == line->num_args - 1 && i > 0 &&
+                            in_list(line->mnemonic, MOVES, NUM_MOVES) &&
+                            !is_mem(line->args[i]);
+        if (!written_only && mentions_reg(line->args[i], reg)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Returns true iff an instruction overwrites a register without reading it.
+ */
+bool overwrites_reg(asm_line_t *line, char *reg) {
+    if (is_instr(line, "call")) {
+        return strcmp(reg, "%rax") == 0 || strcmp(reg, "%rcx") == 0 ||
+               strcmp(reg, "%rdx") == 0;
+    }
+    if (reads_reg(line, reg) || line->num_args == 0) {
+        return false;
+    }
+    char *dest = line->args[line->num_args - 1];
+    bool zeroes = line->mnemonic[0] == 'x' && line->num_args == 2 &&
+                  strcmp(line->args[0], dest) == 0;
+    return (zeroes || in_list(line->mnemonic, MOVES, NUM_MOVES)) &&
+           is_exactly_reg(dest, reg);
+}
+
+/*
+ * Returns true iff a line ends a basic block or starts one.
+ */
+bool is_boundary(asm_line_t *line) {
+    return line->is_label || line->mnemonic[0] == 'j' || is_instr(line, "retq");
+}
+
+/*
+ * Returns true iff a scratch register's value is never read after the line at
+ * index. Scratch registers are never live across a block boundary.
+ */
+bool scratch_dead_after(asm_buffer_t *buffer, size_t index, char *reg) {
+    for (size_t k = index + 1; k < buffer->num_lines; k++) {
+        asm_line_t *line = &buffer->lines[k];
+        if (line->is_label) {
+            return true;
+        }
+        if (reads_reg(line, reg)) {
+            return false;
+        }
+        if (overwrites_reg(line, reg) || is_boundary(line)) {
+            return true;
+        }
+    }
+    return true;
+}
+
+/*
+ * Returns true iff the flags set before the line at index are never read.
+ * The flags are never live across a block boundary, except from a
+ * conditional jump's comparison to the conditional jump right after it.
+ */
+bool flags_dead_after(asm_buffer_t *buffer, size_t index) {
+    for (size_t k = index; k < buffer->num_lines; k++) {
+        asm_line_t *line = &buffer->lines[k];
+        if (line->is_label || is_instr(line, "jmp") || is_instr(line, "retq")) {
+            return true;
+        }
+        char *mnemonic = line->mnemonic;
+        if (mnemonic[0] == 'j' || strncmp(mnemonic, "cmov", 4) == 0 ||
+            strncmp(mnemonic, "set", 3) == 0) {
+            return false;
+        }
+        if (!in_list(mnemonic, FLAG_PRESERVING, NUM_FLAG_PRESERVING)) {
+            return true;
+        }
+    }
+    return true;
+}
+
+char *low_half(char *reg) {
+    for (size_t i = 0; i < NUM_REG_HALVES; i++) {
+        if (strcmp(REG_HALVES[i][0], reg) == 0) {
+            return REG_HALVES[i][1];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Returns the scratch register an operand is exactly, or NULL if it is not one.
+ */
+char *scratch_reg(char *arg) {
+    for (size_t i = 0; i < NUM_SCRATCH_REGS; i++) {
+        if (strcmp(arg, SCRATCH_REGS[i]) == 0) {
+            return SCRATCH_REGS[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Tries each rule on the lines starting at index i.
+ * Returns the rule that applied, or NUM_PEEPHOLE_RULES if none did.
+ */
+peephole_rule_t apply_rules(asm_buffer_t *buffer, size_t i) {
+    asm_line_t *line = &buffer->lines[i];
+    asm_line_t *next = i + 1 < buffer->num_lines ? &buffer->lines[i + 1] : NULL;
+    bool move = is_instr(line, "movq");
+    if (move && next != NULL && is_instr(next, "movq") &&
+        strcmp(line->args[0], next->args[1]) == 0 &&
+        strcmp(line->args[1], next->args[0]) == 0) {
+        remove_line(buffer, i + 1);
+        return PEEPHOLE_MOVE_BACK;
+    }
+    if (move && next != NULL && is_instr(next, "movq") && is_reg(line->args[0]) &&
+        is_mem(line->args[1]) && strcmp(line->args[1], next->args[0]) == 0) {
+        strcpy(next->args[0], line->args[0]);
+        return PEEPHOLE_STORE_LOAD;
+    }
+    if (move && strcmp(line->args[0], "$0") == 0 && low_half(line->args[1]) != NULL &&
+        flags_dead_after(buffer, i + 1)) {
+        char *half = low_half(line->args[1]);
+        *line = make_instr("xorl", half, half);
+        return PEEPHOLE_ZERO_XOR;
+    }
+
+    char *scratch = move ? scratch_reg(line->args[1]) : NULL;
+    if (scratch != NULL && next != NULL && !next->is_label && next->num_args == 2 &&
+        strcmp(next->args[0], scratch) == 0 && !mentions_reg(next->args[1], scratch) &&
+        (is_instr(next, "addq") || is_instr(next, "subq") || is_instr(next, "imulq") ||
+         is_instr(next, "cmpq") || is_instr(next, "movq")) &&
+        (is_reg(line->args[0]) || is_imm32(line->args[0]) ||
+         (is_mem(line->args[0]) && !is_mem(next->args[1]))) &&
+        scratch_dead_after(buffer, i + 1, scratch)) {
+        strcpy(next->args[0], line->args[0]);
+        remove_line(buffer, i);
+        return PEEPHOLE_FORWARD_SCRATCH;
+    }
+    return NUM_PEEPHOLE_RULES;
+}
+
+void optimize_buffer(asm_buffer_t *buffer, size_t *hits) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < buffer->num_lines; i++) {
+            peephole_rule_t rule = apply_rules(buffer, i);
+            if (rule != NUM_PEEPHOLE_RULES) {
+                hits[rule]++;
+                changed = true;
+                // A rewrite can enable another on the line before it, so
+                // the loop picks up again from there.
+                i = i > 1 ? i - 2 : (size_t) -1;
+            }
+        }
+    }
+}
+
+void print_buffer(asm_buffer_t *buffer, FILE *stream) {
+    for (size_t i = 0; i < buffer->num_lines; i++) {
+        asm_line_t *line = &buffer->lines[i];
+        if (line->is_label) {
+            fprintf(stream, "%s:\n", line->mnemonic);
+            continue;
+        }
+        fprintf(stream, "    %s", line->mnemonic);
+        for (uint8_t a = 0; a < line->num_args; a++) {
+            fprintf(stream, "%s%s", a == 0 ? " " : ", ", line->args[a]);
+        }
+        fprintf(stream, "\n");
+    }
+}
+
+void free_buffer(asm_buffer_t *buffer) {
+    free(buffer->lines);
+    free(buffer);
+}
@@ -150,6 +150,48 @@ void free_ast(node_t *node) {
     free(node);
 }
 
+node_t *copy_ast(node_t *node) {
+    if (node == NULL) {
+        return NULL;
+    }
+
+    if (node->type == NUM) {
+        return init_num_node(((num_node_t *) node)->value);
+    }
+    if (node->type == BINARY_OP) {
+        binary_node_t *bin = (binary_node_t *) node;
+        return init_binary_node(bin->op, copy_ast(bin->left), copy_ast(bin->right));
+    }
+    if (node->type == VAR) {
+        return init_var_node(((var_node_t *) node)->name);
+    }
+    if (node->type == SEQUENCE) {
+        sequence_node_t *sequence = (sequence_node_t *) node;
+        node_t **statements = malloc(sizeof(node_t *[sequence->statement_count]));
+        assert(statements != NULL);
+        for (size_t i = 0; i < sequence->statement_count; i++) {
+            statements[i] = copy_ast(sequence->statements[i]);
+        }
+        return init_sequence_node(sequence->statement_count, statements);
+    }
+    if (node->type == PRINT) {
+        return init_print_node(copy_ast(((print_node_t *) node)->expr));
+    }
+    if (node->type == LET) {
+        let_node_t *let = (let_node_t *) node;
+        return init_let_node(let->var, copy_ast(let->value));
+    }
+    if (node->type == IF) {
+        if_node_t *conditional = (if_node_t *) node;
+        return init_if_node(copy_ast(conditional->condition),
+                            copy_ast(conditional->if_branch),
+                            copy_ast(conditional->else_branch));
+    }
+    assert(node->type == WHILE);
+    while_node_t *loop = (while_node_t *) node;
+    return init_while_node(copy_ast(loop->condition), copy_ast(loop->body));
+}
+
 void print_indent(size_t indent) {
     while (indent > 0) {
         fprintf(stderr, "\t");
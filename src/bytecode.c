@@ -0,0 +1,351 @@
+#include "bytecode.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "ir.h"
+#include "register_need.h"
+
+// The jump index lower_branch() returns when the branch is never taken
+#define NO_JUMP SIZE_MAX
+
+// Where an expression's value is: a register or a constant
+typedef struct {
+    bool is_imm;
+    uint8_t reg;
+    value_t imm;
+} vm_operand_t;
+
+typedef struct {
+    bytecode_t *bytecode;
+    // The length of the code when a jump was last pointed at its end. The
+    // instruction before that point cannot be fused with the next one, since
+    // the jump skips it.
+    size_t label;
+    // The registers each operation in the expression being lowered needs
+    register_labels_t labels;
+} lowerer_t;
+
+bool lower_operands(lowerer_t *lowerer, binary_node_t *bin_node, size_t temp,
+                    vm_operand_t *left, vm_operand_t *right);
+
+/*
+ * Appends an instruction to the bytecode and returns its index.
+ */
+size_t emit_instr(lowerer_t *lowerer, opcode_t op, uint8_t dest, uint8_t a, uint8_t b,
+                  value_t imm) {
+    bytecode_t *bytecode = lowerer->bytecode;
+    if (bytecode->length == bytecode->capacity) {
+        bytecode->capacity = bytecode->capacity * 2 + 16;
+        bytecode->instrs =
+            realloc(bytecode->instrs, bytecode->capacity * sizeof(vm_instr_t));
+        assert(bytecode->instrs != NULL);
+    }
+    bytecode->instrs[bytecode->length] =
+        (vm_instr_t){.op = op, .dest = dest, .a = a, .b = b, .target = 0, .imm = imm};
+    return bytecode->length++;
+}
+
+/*
+ * Points a jump or branch at the end of the bytecode, where the next
+ * instruction will go.
+ */
+void patch_jump(lowerer_t *lowerer, size_t jump) {
+    if (jump == NO_JUMP) {
+        return;
+    }
+    lowerer->bytecode->instrs[jump].target = lowerer->bytecode->length;
+    lowerer->label = lowerer->bytecode->length;
+}
+
+/*
+ * Returns the operand an expression is without computing anything:
+ * a constant or a variable's register. Returns false for binary operations.
+ */
+bool simple_operand(node_t *node, vm_operand_t *operand) {
+    if (node->type == NUM) {
+        value_t value = ((num_node_t *) node)->value;
+        *operand = (vm_operand_t){.is_imm = true, .reg = 0, .imm = value};
+        return true;
+    }
+    if (node->type == VAR) {
+        uint8_t var = ((var_node_t *) node)->name - 'A';
+        *operand = (vm_operand_t){.is_imm = false, .reg = var, .imm = 0};
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Emits an arithmetic operation on two operands that writes dest.
+ * Operations on two constants are folded instead where possible.
+ */
+void emit_arithmetic(lowerer_t *lowerer, char op, uint8_t dest, vm_operand_t left,
+                     vm_operand_t right, vm_operand_t *result) {
+    if (left.is_imm && right.is_imm) {
+        value_t folded;
+        if (fold_op(ir_op(op), left.imm, right.imm, &folded)) {
+            *result = (vm_operand_t){.is_imm = true, .reg = 0, .imm = folded};
+            return;
+        }
+        // The division traps when it runs, as it would in compiled code
+        emit_instr(lowerer, OP_LOAD, dest, 0, 0, left.imm);
+        left = (vm_operand_t){.is_imm = false, .reg = dest};
+    }
+    if ((op == '+' || op == '*') && left.is_imm) {
+        vm_operand_t swap = left;
+        left = right;
+        right = swap;
+    }
+
+    opcode_t base = op == '+'   ? OP_ADD_RR
+                    : op == '-' ? OP_SUB_RR
+                    : op == '*' ? OP_MUL_RR
+                                : OP_DIV_RR;
+    // The _RC form follows the _RR form, and the _CR form follows that
+    if (left.is_imm) {
+        emit_instr(lowerer, base + 2, dest, 0, right.reg, left.imm);
+    }
+    else if (right.is_imm) {
+        emit_instr(lowerer, base + 1, dest, left.reg, 0, right.imm);
+    }
+    else {
+        emit_instr(lowerer, base, dest, left.reg, right.reg, 0);
+    }
+    *result = (vm_operand_t){.is_imm = false, .reg = dest};
+}
+
+/*
+ * Emits the instructions computing an expression. A binary operation writes
+ * its result to dest, and its operands use the registers from temp up (dest
+ * may be temp). Returns false if the expression needs more registers.
+ */
+bool lower_expr(lowerer_t *lowerer, node_t *node, size_t dest, size_t temp,
+                vm_operand_t *result) {
+    if (simple_operand(node, result)) {
+        return true;
+    }
+    if (temp >= NUM_VM_REGS) {
+        return false;
+    }
+    assert(node->type == BINARY_OP);
+    binary_node_t *bin_node = (binary_node_t *) node;
+    vm_operand_t left, right;
+    if (!lower_operands(lowerer, bin_node, temp, &left, &right)) {
+        return false;
+    }
+    emit_arithmetic(lowerer, bin_node->op, dest, left, right, result);
+    return true;
+}
+
+/*
+ * Emits the instructions computing the operands of an operation, using the
+ * registers from temp up, in the order label_registers() found needs fewer.
+ * Returns false if they need more registers than there are.
+ */
+bool lower_operands(lowerer_t *lowerer, binary_node_t *bin_node, size_t temp,
+                    vm_operand_t *left, vm_operand_t *right) {
+    bool swapped = right_first(&lowerer->labels, bin_node);
+    node_t *first = swapped ? bin_node->right : bin_node->left;
+    node_t *second = swapped ? bin_node->left : bin_node->right;
+    vm_operand_t *first_value = swapped ? right : left;
+    vm_operand_t *second_value = swapped ? left : right;
+    if (!lower_expr(lowerer, first, temp, temp, first_value)) {
+        return false;
+    }
+    // Only a value computed into temp must survive computing the other operand
+    size_t next = !first_value->is_imm && first_value->reg == temp ? temp + 1 : temp;
+    return lower_expr(lowerer, second, next, next, second_value);
+}
+
+/*
+ * Emits a branch that is taken iff a condition evaluates to `when`.
+ * Stores the index of the branch to patch, or NO_JUMP if it is never taken.
+ */
+bool lower_branch(lowerer_t *lowerer, node_t *node, bool when, size_t *jump) {
+    binary_node_t *condition = (binary_node_t *) node;
+    vm_operand_t left, right;
+    size_t fixed;
+    label_registers(&lowerer->labels, node, &fixed);
+    if (!lower_operands(lowerer, condition, NUM_VARS, &left, &right)) {
+        return false;
+    }
+    ir_cond_t cond = ir_cond(condition->op);
+    if (!when) {
+        cond = negate_cond(cond);
+    }
+    if (left.is_imm && right.is_imm) {
+        *jump = eval_cond(cond, left.imm, right.imm)
+                    ? emit_instr(lowerer, OP_JUMP, 0, 0, 0, 0)
+                    : NO_JUMP;
+        return true;
+    }
+    if (left.is_imm) {
+        vm_operand_t swap = left;
+        left = right;
+        right = swap;
+        cond = swap_cond(cond);
+    }
+    *jump = right.is_imm ? emit_instr(lowerer, OP_BRANCH_LT_RC + cond, 0, left.reg, 0,
+                                      right.imm)
+                         : emit_instr(lowerer, OP_BRANCH_LT_RR + cond, 0, left.reg,
+                                      right.reg, 0);
+    return true;
+}
+
+/*
+ * Fuses the last instruction of a loop's body with its branch back to the
+ * top, if the instruction adds a small constant to the variable the loop's
+ * condition compares with a variable or constant. Returns false if it cannot.
+ */
+bool fuse_step(lowerer_t *lowerer, binary_node_t *condition, size_t top) {
+    bytecode_t *bytecode = lowerer->bytecode;
+    if (bytecode->length == 0 || lowerer->label == bytecode->length) {
+        return false;
+    }
+    vm_instr_t *last = &bytecode->instrs[bytecode->length - 1];
+    if ((last->op != OP_ADD_RC && last->op != OP_SUB_RC) || last->dest != last->a ||
+        last->dest >= NUM_VARS) {
+        return false;
+    }
+    value_t step = last->op == OP_ADD_RC ? last->imm : (value_t) -(uint64_t) last->imm;
+    if (step < INT8_MIN || step > INT8_MAX) {
+        return false;
+    }
+
+    vm_operand_t left, right;
+    if (!simple_operand(condition->left, &left) ||
+        !simple_operand(condition->right, &right)) {
+        return false;
+    }
+    ir_cond_t cond = ir_cond(condition->op);
+    if (left.is_imm) {
+        vm_operand_t swap = left;
+        left = right;
+        right = swap;
+        cond = swap_cond(cond);
+    }
+    if (left.is_imm || left.reg != last->dest) {
+        return false;
+    }
+    *last = (vm_instr_t){
+        .op = (right.is_imm ? OP_STEP_LT_RC : OP_STEP_LT_RR) + cond,
+        .dest = last->dest,
+        .a = (uint8_t) (int8_t) step,
+        .b = right.reg,
+        .target = top,
+        .imm = right.imm,
+    };
+    return true;
+}
+
+/*
+ * Emits the instructions running a statement.
+ * Returns false if an expression needs more registers than there are.
+ */
+bool lower_statement(lowerer_t *lowerer, node_t *node) {
+    bytecode_t *bytecode = lowerer->bytecode;
+    if (node->type == SEQUENCE) {
+        sequence_node_t *sequence = (sequence_node_t *) node;
+        for (size_t i = 0; i < sequence->statement_count; i++) {
+            if (!lower_statement(lowerer, sequence->statements[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    vm_operand_t value;
+    size_t fixed;
+    if (node->type == PRINT) {
+        node_t *expr = ((print_node_t *) node)->expr;
+        label_registers(&lowerer->labels, expr, &fixed);
+        if (!lower_expr(lowerer, expr, NUM_VARS, NUM_VARS, &value)) {
+            return false;
+        }
+        if (value.is_imm) {
+            emit_instr(lowerer, OP_PRINT_C, 0, 0, 0, value.imm);
+        }
+        else {
+            emit_instr(lowerer, OP_PRINT_R, 0, value.reg, 0, 0);
+        }
+        return true;
+    }
+    if (node->type == LET) {
+        let_node_t *let_node = (let_node_t *) node;
+        uint8_t var = let_node->var - 'A';
+        label_registers(&lowerer->labels, let_node->value, &fixed);
+        // The operation computing the value writes the variable directly
+        if (!lower_expr(lowerer, let_node->value, var, NUM_VARS, &value)) {
+            return false;
+        }
+        if (value.is_imm) {
+            emit_instr(lowerer, OP_LOAD, var, 0, 0, value.imm);
+        }
+        else if (value.reg != var) {
+            emit_instr(lowerer, OP_MOVE, var, value.reg, 0, 0);
+        }
+        return true;
+    }
+    size_t skip;
+    if (node->type == IF) {
+        if_node_t *if_node = (if_node_t *) node;
+        if (!lower_branch(lowerer, if_node->condition, false, &skip) ||
+            !lower_statement(lowerer, if_node->if_branch)) {
+            return false;
+        }
+        if (if_node->else_branch == NULL) {
+            patch_jump(lowerer, skip);
+            return true;
+        }
+        size_t end = emit_instr(lowerer, OP_JUMP, 0, 0, 0, 0);
+        patch_jump(lowerer, skip);
+        if (!lower_statement(lowerer, if_node->else_branch)) {
+            return false;
+        }
+        patch_jump(lowerer, end);
+        return true;
+    }
+
+    // The condition is tested before the first iteration and after each one,
+    // so each iteration takes one branch
+    assert(node->type == WHILE);
+    while_node_t *while_node = (while_node_t *) node;
+    if (!lower_branch(lowerer, while_node->condition, false, &skip)) {
+        return false;
+    }
+    size_t top = bytecode->length;
+    if (!lower_statement(lowerer, while_node->body)) {
+        return false;
+    }
+    if (!fuse_step(lowerer, (binary_node_t *) while_node->condition, top)) {
+        size_t repeat;
+        if (!lower_branch(lowerer, while_node->condition, true, &repeat)) {
+            return false;
+        }
+        if (repeat != NO_JUMP) {
+            bytecode->instrs[repeat].target = top;
+        }
+    }
+    patch_jump(lowerer, skip);
+    return true;
+}
+
+bool lower_program(node_t *program, bytecode_t *bytecode) {
+    *bytecode = (bytecode_t){.instrs = NULL, .length = 0, .capacity = 0};
+    lowerer_t lowerer = {
+        .bytecode = bytecode,
+        .label = 0,
+        .labels = {.nodes = NULL, .needs = NULL, .allocated = 0},
+    };
+    bool lowered = lower_statement(&lowerer, program);
+    free_labels(&lowerer.labels);
+    if (!lowered) {
+        return false;
+    }
+    emit_instr(&lowerer, OP_HALT, 0, 0, 0, 0);
+    return true;
+}
+
+void free_bytecode(bytecode_t *bytecode) {
+    free(bytecode->instrs);
+}
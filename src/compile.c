@@ -1,394 +1,356 @@
 #include "compile.h"
 
 #include <assert.h>
-#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-uint16_t counter = 0;
+#include "asm.h"
+#include "emit.h"
+#include "ir.h"
+#include "passes.h"
+#include "register_need.h"
 
-typedef struct {
-    char **virtual_stack;
-    uint8_t num_stack_regs;
-    uint8_t stack_index;
-    char **var_regs;
-    char *vars;
-    uint8_t num_vars;
-} register_data;
+// The number of iterations assumed for a loop with no trip-count hint
+const uint64_t DEFAULT_TRIPS = 10;
+// The largest trip-count hint a single loop can contribute
+const uint64_t MAX_TRIPS = 1 << 20;
 
-void push_var(char name, register_data *data);
-void push_val(int64_t val, register_data *data);
-void push_reg(char *reg, register_data *data);
-void pop(char *reg, register_data *data);
-int8_t const_shift(int64_t value);
-int64_t const_operate(char operation, int64_t left, int64_t right);
-int64_t constant(node_t *node);
-bool optimize(node_t *node, register_data *data);
-void asm_operate(binary_node_t *bin_node, register_data *data, bool swap);
-bool compile_recursive(node_t *node, register_data *data);
-void count_vars(node_t *node, uint8_t *counts);
-void choose_vars(uint8_t *counts, uint8_t *top_counts, char *top_vars);
-bool compile_ast(node_t *node);
+typedef struct {
+    ir_program_t *program;
+    // The block that lowered instructions are appended to
+    ir_block_t *block;
+    // The registers each operation in the expression being lowered needs
+    register_labels_t labels;
+} lowering_data;
+
+// An optimization pass, run in the order they are listed in PASSES
+typedef struct {
+    char *name;
+    void (*run)(ir_program_t *program);
+} pass_t;
+
+const pass_t PASSES[] = {
+    {"sccp", propagate_constants},
+    {"reassoc", reassociate},
+    {"gvn", number_values},
+    {"licm", hoist_invariants},
+    {"unswitch", unswitch_loops},
+    {"sccp", propagate_constants},
+    {"licm", hoist_invariants},
+    {"dce", remove_dead_code},
+    {"scev", evaluate_loops},
+    {"strength", reduce_strength},
+    {"ranges", narrow_ranges},
+    {"dce", remove_dead_code},
+    {"split", split_loops},
+    {"layout", lay_out_blocks},
+};
+
+bool constant_value(node_t *node, value_t *value);
+uint64_t scale_weight(uint64_t weight, uint64_t factor);
+int64_t loop_step(node_t *body, char name);
+uint64_t loop_trips(while_node_t *while_node);
+void jump(ir_block_t *from, ir_block_t *to);
+ir_block_t *start_block(uint64_t weight, lowering_data *data);
+void estimate_spills_avoided(node_t *node, lowering_data *data);
+void lower_operands(binary_node_t *bin_node, ir_operand_t *a, ir_operand_t *b,
+                    lowering_data *data);
+ir_operand_t lower_expr(node_t *node, lowering_data *data);
+void lower_into(node_t *node, size_t dest, lowering_data *data);
+void lower_branch(node_t *condition, ir_block_t *if_true, ir_block_t *if_false,
+                  lowering_data *data);
+bool lower_statement(node_t *node, lowering_data *data);
+ir_program_t *lower_program(node_t *node);
+void dump_ir(char *stage, ir_program_t *program);
+void print_stats(ir_stats_t *stats, size_t *peephole_hits);
+bool compile_ast(node_t *node, compile_options_t *options, asm_buffer_t *buffer);
 
 /*
- * Helper for push_var used to get info about where a variable is stored
- * (stack or register, and index in both  cases).
+ * Computes the value of an expression of constants.
+ * Returns false if node is not one, or if evaluating it would trap.
  */
-int16_t find_var(char name, register_data *data) {
-    int16_t i;
-    for (i = 0; i < data->num_vars; i++) {
-        if (name == data->vars[i]) {
-            return i;
-        }
+bool constant_value(node_t *node, value_t *value) {
+    if (node->type == NUM) {
+        *value = ((num_node_t *) node)->value;
+        return true;
+    }
+    if (node->type != BINARY_OP) {
+        return false;
+    }
+    binary_node_t *bin_node = (binary_node_t *) node;
+    if (bin_node->op == '>' || bin_node->op == '<' || bin_node->op == '=') {
+        return false;
     }
-    i = -8 * (name - 'A' + 1);
-    return i;
+    value_t left, right;
+    return constant_value(bin_node->left, &left) &&
+           constant_value(bin_node->right, &right) &&
+           fold_op(ir_op(bin_node->op), left, right, value);
 }
 
 /*
- * Pushes a variable's value to the virtual stack.
+ * Multiplies an execution frequency estimate by factor, saturating
+ * instead of wrapping around.
  */
-void push_var(char name, register_data *data) {
-    int16_t var_index = find_var(name, data);
-    if (var_index >= 0) {
-        if (data->stack_index >= data->num_stack_regs) {
-            printf("    pushq %s\n", data->var_regs[var_index]);
-        }
-        else {
-            printf("    movq %s, %s\n", data->var_regs[var_index],
-                   data->virtual_stack[data->stack_index]);
-        }
+uint64_t scale_weight(uint64_t weight, uint64_t factor) {
+    if (factor != 0 && weight > UINT64_MAX / factor) {
+        return UINT64_MAX;
     }
-    else {
-        if (data->stack_index >= data->num_stack_regs) {
-            printf("    pushq %" PRId16 "(%%rbp)\n", var_index);
-        }
-        else {
-            printf("    movq %" PRId16 "(%%rbp), %s\n", var_index,
-                   data->virtual_stack[data->stack_index]);
-        }
-    }
-    (data->stack_index)++;
+    return weight * factor;
 }
 
 /*
- * Pushes a constant to the virtual stack.
+ * Returns the constant c if the statements directly inside body include
+ * LET name = name + c or LET name = name - (-c), or 0 if there is none.
  */
-void push_val(int64_t val, register_data *data) {
-    if (data->stack_index >= data->num_stack_regs) {
-        printf("    movq $%" PRId64 ", %%rax\n", val);
-        printf("    pushq %%rax\n");
+int64_t loop_step(node_t *body, char name) {
+    if (body->type == SEQUENCE) {
+        sequence_node_t *seq_node = (sequence_node_t *) body;
+        for (size_t i = 0; i < seq_node->statement_count; i++) {
+            int64_t step = loop_step(seq_node->statements[i], name);
+            if (step != 0) {
+                return step;
+            }
+        }
+        return 0;
     }
-    else {
-        printf("    movq $%" PRId64 ", %s\n", val,
-               data->virtual_stack[data->stack_index]);
+    if (body->type != LET || ((let_node_t *) body)->var != name ||
+        ((let_node_t *) body)->value->type != BINARY_OP) {
+        return 0;
+    }
+    binary_node_t *bin_node = (binary_node_t *) ((let_node_t *) body)->value;
+    node_t *other = NULL;
+    if (bin_node->left->type == VAR && ((var_node_t *) bin_node->left)->name == name) {
+        other = bin_node->right;
+    }
+    else if (bin_node->op == '+' && bin_node->right->type == VAR &&
+             ((var_node_t *) bin_node->right)->name == name) {
+        other = bin_node->left;
     }
-    (data->stack_index)++;
+    value_t step;
+    if (other == NULL || !constant_value(other, &step)) {
+        return 0;
+    }
+    if (bin_node->op == '+') {
+        return step;
+    }
+    if (bin_node->op == '-') {
+        return -(uint64_t) step;
+    }
+    return 0;
 }
 
 /*
- * Pushes the provided register's value to the virtual stack.
+ * Estimates the number of times the body of a WHILE loop runs per entry.
+ * A loop that compares a variable against a constant bound and steps that
+ * variable by a constant is assumed to run |bound / step| times; any other
+ * loop is assumed to run DEFAULT_TRIPS times.
  */
-void push_reg(char *reg, register_data *data) {
-    if (data->stack_index >= data->num_stack_regs) {
-        printf("    pushq %s\n", reg);
+uint64_t loop_trips(while_node_t *while_node) {
+    binary_node_t *cond = (binary_node_t *) while_node->condition;
+    var_node_t *var_node = NULL;
+    value_t bound;
+    if (cond->left->type == VAR && constant_value(cond->right, &bound)) {
+        var_node = (var_node_t *) cond->left;
     }
-    else {
-        printf("    movq %s, %s\n", reg, data->virtual_stack[data->stack_index]);
+    else if (cond->right->type == VAR && constant_value(cond->left, &bound)) {
+        var_node = (var_node_t *) cond->right;
     }
-    (data->stack_index)++;
+    if (var_node == NULL) {
+        return DEFAULT_TRIPS;
+    }
+    int64_t step = loop_step(while_node->body, var_node->name);
+    if (step == 0) {
+        return DEFAULT_TRIPS;
+    }
+    value_t trips;
+    if (!fold_op(IR_DIV, bound, step, &trips)) {
+        return MAX_TRIPS;
+    }
+    uint64_t abs_trips = trips < 0 ? -(uint64_t) trips : (uint64_t) trips;
+    if (abs_trips == 0) {
+        // Counting towards 0 says nothing about where the variable starts.
+        return DEFAULT_TRIPS;
+    }
+    if (abs_trips > MAX_TRIPS) {
+        return MAX_TRIPS;
+    }
+    return abs_trips;
 }
 
-/* 
- * Pops the virtual stack to the given register.
+/*
+ * Ends a block with an unconditional jump.
  */
-void pop(char *reg, register_data *data) {
-    if (data->stack_index > data->num_stack_regs) {
-        printf("    popq %s\n", reg);
-    }
-    else {
-        printf("    movq %s, %s\n", data->virtual_stack[data->stack_index - 1], reg);
-    }
-    (data->stack_index)--;
+void jump(ir_block_t *from, ir_block_t *to) {
+    from->term.kind = TERM_JUMP;
+    from->term.targets[0] = to;
 }
 
 /*
- * Attempts to compute k such that value = 2^k.
- * Returns k on success, or max char on fail.
+ * Appends a new block to the program and continues lowering into it.
  */
-int8_t const_shift(int64_t value) {
-    int8_t shift = 0;
-    while (value % 2 == 0) {
-        value /= 2;
-        shift++;
-    }
-    if (value == 1 || value == -1) {
-        shift *= value;
-        return shift;
-    }
-    return __SCHAR_MAX__;
+ir_block_t *start_block(uint64_t weight, lowering_data *data) {
+    ir_block_t *block = init_block(weight);
+    add_block(data->program, block);
+    data->block = block;
+    return block;
 }
 
 /*
- * Performs the provided operation on constants
+ * Labels an expression about to be lowered with the registers it needs, and
+ * adds to the program's estimated spills avoided the number of registers
+ * beyond those available that it needs only in left-to-right order. This is
+ * an estimate: it ignores the variables live around the expression, which
+ * also occupy registers.
  */
-int64_t const_operate(char operation, int64_t left, int64_t right) {
-    if (operation == '+') {
-        return left + right;
-    }
-    else if (operation == '-') {
-        return left - right;
-    }
-    else if (operation == '*') {
-        return left * right;
-    }
-    else if (operation == '/') {
-        return left / right;
-    }
-    exit(1);
+void estimate_spills_avoided(node_t *node, lowering_data *data) {
+    size_t fixed;
+    size_t reordered = label_registers(&data->labels, node, &fixed);
+    size_t fixed_spills = fixed > NUM_REGS ? fixed - NUM_REGS : 0;
+    size_t reordered_spills = reordered > NUM_REGS ? reordered - NUM_REGS : 0;
+    data->program->stats.estimated_spills_avoided += fixed_spills - reordered_spills;
 }
 
-/* 
- * Prints assembly to perform perform a binary_node operation
- * result should be on top of the virtual stack
- * 
- * Preconditions:
- * If the operation is not a shift:
- *     If swap is false:
- *         The result of the right node is on top of the virtual stack
- *         The result of the left node is immediately below
- *     If swap is true:
- *         The result of the left node is on top of the virtual stack
- *         The result of the right node is immediately below
- * If the operation is a shift:
- *     The result of the right node is in %cl
- *     The result of the left node is on top of the virtual stack
+/*
+ * Lowers the operands of an operation in the order that needs fewer registers.
  */
-void asm_operate(binary_node_t *bin_node, register_data *data, bool swap) {
-    if (bin_node->op == 's') {
-        if (data->stack_index > data->num_stack_regs) {
-            printf("    salq %%cl, (%%rsp)\n");
-        }
-        else {
-            printf("    sal %%cl, %s\n", data->virtual_stack[data->stack_index - 1]);
-        }
+void lower_operands(binary_node_t *bin_node, ir_operand_t *a, ir_operand_t *b,
+                    lowering_data *data) {
+    if (right_first(&data->labels, bin_node)) {
+        *b = lower_expr(bin_node->right, data);
+        *a = lower_expr(bin_node->left, data);
     }
     else {
-        if (swap) {
-            pop("%rax", data);
-            pop("%rcx", data);
-        }
-        else {
-            pop("%rcx", data);
-            pop("%rax", data);
-        }
-        bool cmp = false;
-        if (bin_node->op == '+') {
-            printf("    addq %%rcx, %%rax\n");
-        }
-        else if (bin_node->op == '*') {
-            printf("    imulq %%rcx, %%rax\n");
-        }
-        else if (bin_node->op == '-') {
-            printf("    subq %%rcx, %%rax\n");
-        }
-        else if (bin_node->op == '/') {
-            printf("    cqto\n");
-            printf("    idivq %%rcx\n");
-        }
-        else {
-            printf("    cmp %%rcx, %%rax\n");
-            cmp = true;
-        }
-        if (!cmp) {
-            push_reg("%rax", data);
-        }
+        *a = lower_expr(bin_node->left, data);
+        *b = lower_expr(bin_node->right, data);
     }
 }
 
-/* Computes the constant represented by node
- * Precondition: node is an expression of constants
+/*
+ * Lowers an expression, returning the operand holding its value.
+ * Arithmetic is computed into a new temporary.
  */
-int64_t constant(node_t *node) {
+ir_operand_t lower_expr(node_t *node, lowering_data *data) {
     if (node->type == NUM) {
-        num_node_t *num_node = (num_node_t *) node;
-        return num_node->value;
+        return imm_operand(((num_node_t *) node)->value);
     }
-    binary_node_t *bin_node = (binary_node_t *) node;
-    char op = bin_node->op;
-    int64_t left = constant(bin_node->left);
-    int64_t right = constant(bin_node->right);
-    return const_operate(op, left, right);
+    if (node->type == VAR) {
+        return value_operand(((var_node_t *) node)->name - 'A');
+    }
+    size_t temp = new_temp(data->program);
+    lower_into(node, temp, data);
+    return value_operand(temp);
 }
 
 /*
- * Returns true if a node represents an expression of constants,
- * Otherwise, generates the asm code required to compute and
- * push the evaluation of the input node to the top of the stack
- * and returns false.
- * 
- * Optimizations include replacing multiplication by a power of 2
- * with a bit shift, and replacing expressions of constants with
- * the value they represent.
+ * Lowers an expression, assigning its value to dest.
  */
-bool optimize(node_t *node, register_data *data) {
-    if (node->type == NUM) {
-        return true;
+void lower_into(node_t *node, size_t dest, lowering_data *data) {
+    ir_instr_t instr = {.dest = dest};
+    if (node->type == BINARY_OP) {
+        binary_node_t *bin_node = (binary_node_t *) node;
+        instr.op = ir_op(bin_node->op);
+        lower_operands(bin_node, &instr.a, &instr.b, data);
     }
-    else if (node->type == VAR) {
-        var_node_t *var_node = (var_node_t *) node;
-        push_var(var_node->name, data);
+    else {
+        instr.op = IR_MOV;
+        instr.a = lower_expr(node, data);
     }
-    else if (node->type == BINARY_OP) {
-        binary_node_t *bin_node = (binary_node_t *) node;
-        bool swap = false;
-        bool left = optimize(bin_node->left, data);
-        bool right = optimize(bin_node->right, data);
-        if (left && right) {
-            if (bin_node->op != '>' && bin_node->op != '<' && bin_node->op != '=') {
-                return true;
-            }
-            push_val(constant(bin_node->left), data);
-            push_val(constant(bin_node->right), data);
-        }
-        else if (left) {
-            push_val(constant(bin_node->left), data);
-
-            /*
-             * In general, the value of the left node is pushed to the virtual stack
-             * before the value of the right node, but if the left node is an
-             * expression of constants and the right is not, the result of evaluating
-             * the right node would have gotten pushed first. This must be taken into
-             * account when evaluating the binary operation between the left and right 
-             * nodes.
-             */
-            swap = true;
-        }
-        else if (right) {
-            int64_t val = constant(bin_node->right);
-            bool shifted = false;
-
-            // Replaces multiplication by a power of 2 with a bit shift.
-            if (val != 0 && bin_node->op == '*') {
-                int8_t shift = const_shift(val);
-                if (shift != __SCHAR_MAX__) {
-                    bin_node->op = 's';
-                    if (shift <= 0 && val < 0) {
-                        shift *= -1;
-                        if (data->stack_index > data->num_stack_regs) {
-                            printf("    neg (%%rsp)\n");
-                        }
-                        else {
-                            printf("    neg %s\n",
-                                   data->virtual_stack[data->stack_index - 1]);
-                        }
-                    }
-                    printf("    mov $%" PRId8 ", %%cl\n", shift);
-                    shifted = true;
-                }
-            }
-
-            if (!shifted) {
-                push_val(val, data);
-            }
-        }
+    add_instr(data->block, instr);
+}
 
-        // Evaluates the binary operation on the left and right nodes.
-        asm_operate(bin_node, data, swap);
-    }
-    return false;
+/*
+ * Lowers a comparison, ending the current block with a branch to if_true
+ * when it holds and to if_false otherwise.
+ */
+void lower_branch(node_t *condition, ir_block_t *if_true, ir_block_t *if_false,
+                  lowering_data *data) {
+    binary_node_t *bin_node = (binary_node_t *) condition;
+    ir_term_t *term = &data->block->term;
+    ir_operand_t a, b;
+    estimate_spills_avoided(condition, data);
+    lower_operands(bin_node, &a, &b, data);
+    term->kind = TERM_BRANCH;
+    term->cond = ir_cond(bin_node->op);
+    term->a = a;
+    term->b = b;
+    term->targets[0] = if_true;
+    term->targets[1] = if_false;
 }
 
 /*
- * Recursively traverses the parse tree and generates asm code for
- * each node, directing compilation of mathematical expressions to
- * the optimize function to enable O(n) compilation.
+ * Lowers a statement into the current block, starting new blocks as
+ * control flow requires. Blocks inside a loop are weighted by the loop's
+ * estimated trip count.
  */
-bool compile_recursive(node_t *node, register_data *data) {
-    if (node->type == NUM) {
-        num_node_t *num_node = (num_node_t *) node;
-        push_val(num_node->value, data);
-        assert(data->stack_index == 1); // should store in rdi
+bool lower_statement(node_t *node, lowering_data *data) {
+    uint64_t weight = data->block->weight;
+    if (node->type == PRINT) {
+        ir_instr_t instr = {.op = IR_PRINT};
+        estimate_spills_avoided(((print_node_t *) node)->expr, data);
+        instr.a = lower_expr(((print_node_t *) node)->expr, data);
+        add_instr(data->block, instr);
     }
-    else if (node->type == PRINT) {
-        print_node_t *print_node = (print_node_t *) node;
-        compile_recursive(print_node->expr, data);
-        printf("    call print_int\n");
-        (data->stack_index)--;
-        assert(data->stack_index == 0); // should have popped from rdi
+    else if (node->type == LET) {
+        let_node_t *let_node = (let_node_t *) node;
+        estimate_spills_avoided(let_node->value, data);
+        lower_into(let_node->value, let_node->var - 'A', data);
     }
     else if (node->type == SEQUENCE) {
         sequence_node_t *seq_node = (sequence_node_t *) node;
         for (size_t i = 0; i < seq_node->statement_count; i++) {
-            compile_recursive(seq_node->statements[i], data);
-        }
-    }
-    else if (node->type == BINARY_OP) {
-        assert(data->stack_index == 0);
-        if (optimize(node, data)) {
-            push_val(constant(node), data);
-        }
-    }
-    else if (node->type == VAR) {
-        var_node_t *var_node = (var_node_t *) node;
-        push_var(var_node->name, data);
-        // vars that are part of an expression should be handled by optimize
-        assert(data->stack_index == 1);
-    }
-    else if (node->type == LET) {
-        let_node_t *let_node = (let_node_t *) node;
-        compile_recursive(let_node->value, data); // result should be in rdi
-        int16_t var_index = find_var(let_node->var, data);
-        if (var_index >= 0) {
-            pop(data->var_regs[var_index], data);
-        }
-        else {
-            printf("    movq %%rdi, %" PRId16 "(%%rbp)\n", var_index);
-            (data->stack_index)--;
+            if (!lower_statement(seq_node->statements[i], data)) {
+                return false;
+            }
         }
-        assert(data->stack_index == 0);
     }
     else if (node->type == IF) {
         if_node_t *if_node = (if_node_t *) node;
-        compile_recursive(if_node->condition, data);
-        char op = ((binary_node_t *) (if_node->condition))->op;
-        uint16_t frame_counter = counter++;
-        if (op == '=') {
-            printf("    jne .IF%u\n", frame_counter);
-        }
-        else if (op == '>') {
-            printf("    jle .IF%u\n", frame_counter);
-        }
-        else if (op == '<') {
-            printf("    jge .IF%u\n", frame_counter);
-        }
-        compile_recursive(if_node->if_branch, data);
+        ir_block_t *if_block = init_block(weight);
+        ir_block_t *else_block = NULL;
+        ir_block_t *join = init_block(weight);
         if (if_node->else_branch != NULL) {
-            printf("    jmp .IF%u\n", counter);
-            printf(".IF%u:\n", frame_counter);
-            frame_counter = counter++;
-            compile_recursive(if_node->else_branch, data);
+            else_block = init_block(weight);
+        }
+        lower_branch(if_node->condition, if_block, else_block != NULL ? else_block : join,
+                     data);
+
+        add_block(data->program, if_block);
+        data->block = if_block;
+        if (!lower_statement(if_node->if_branch, data)) {
+            return false;
+        }
+        jump(data->block, join);
+        if (else_block != NULL) {
+            add_block(data->program, else_block);
+            data->block = else_block;
+            if (!lower_statement(if_node->else_branch, data)) {
+                return false;
+            }
+            jump(data->block, join);
         }
-        printf(".IF%u:\n", frame_counter);
+        add_block(data->program, join);
+        data->block = join;
     }
     else if (node->type == WHILE) {
         while_node_t *while_node = (while_node_t *) node;
-        uint16_t frame_counter = counter++;
-        printf("    jmp .START%u\n", frame_counter);
-        printf(".BODY%u:\n", frame_counter);
-        compile_recursive(while_node->body, data);
-        printf(".START%u:\n", frame_counter);
-        compile_recursive(while_node->condition, data);
-        char op = ((binary_node_t *) (while_node->condition))->op;
-        if (op == '=') {
-            printf("    je .BODY%u\n", frame_counter);
-        }
-        else if (op == '>') {
-            printf("    jg .BODY%u\n", frame_counter);
-        }
-        else if (op == '<') {
-            printf("    jl .BODY%u\n", frame_counter);
-        }
+
+        // The condition goes after the body so each iteration takes one branch.
+        uint64_t loop_weight = scale_weight(weight, loop_trips(while_node));
+        ir_block_t *header = init_block(loop_weight);
+        ir_block_t *body = init_block(loop_weight);
+        jump(data->block, header);
+        add_block(data->program, body);
+        data->block = body;
+        if (!lower_statement(while_node->body, data)) {
+            return false;
+        }
+        jump(data->block, header);
+        add_block(data->program, header);
+        data->block = header;
+        ir_block_t *exit = init_block(weight);
+        lower_branch(while_node->condition, body, exit, data);
+        add_block(data->program, exit);
+        data->block = exit;
     }
     else {
         return false;
@@ -397,140 +359,85 @@ bool compile_recursive(node_t *node, register_data *data) {
 }
 
 /*
- * Fills counts with the number of occurrences of each variable.
+ * Lowers a program's AST into IR.
+ * Returns NULL if the AST contains a node that is not a statement.
  */
-void count_vars(node_t *node, uint8_t *counts) {
-    if (node->type == PRINT) {
-        print_node_t *print_node = (print_node_t *) node;
-        count_vars(print_node->expr, counts);
-    }
-    else if (node->type == SEQUENCE) {
-        sequence_node_t *seq_node = (sequence_node_t *) node;
-        for (size_t i = 0; i < seq_node->statement_count; i++) {
-            count_vars(seq_node->statements[i], counts);
-        }
-    }
-    else if (node->type == BINARY_OP) {
-        binary_node_t *bin_node = (binary_node_t *) node;
-        count_vars(bin_node->left, counts);
-        count_vars(bin_node->right, counts);
-    }
-    else if (node->type == VAR) {
-        var_node_t *var_node = (var_node_t *) node;
-        uint8_t idx = var_node->name - 'A';
-        counts[idx]++;
-    }
-    else if (node->type == LET) {
-        let_node_t *let_node = (let_node_t *) node;
-        count_vars(let_node->value, counts);
-        uint8_t idx = let_node->var - 'A';
-        counts[idx]++;
-    }
-    else if (node->type == IF) {
-        if_node_t *if_node = (if_node_t *) node;
-        count_vars(if_node->condition, counts);
-        count_vars(if_node->if_branch, counts);
-        if (if_node->else_branch != NULL) {
-            count_vars(if_node->else_branch, counts);
-        }
-    }
-    else if (node->type == WHILE) {
-        while_node_t *while_node = (while_node_t *) node;
-        count_vars(while_node->body, counts);
-        count_vars(while_node->condition, counts);
-    }
+ir_program_t *lower_program(node_t *node) {
+    lowering_data data = {.labels = {.nodes = NULL, .needs = NULL, .allocated = 0}};
+    data.program = init_program();
+    start_block(1, &data);
+    bool lowered = lower_statement(node, &data);
+    free_labels(&data.labels);
+    if (!lowered) {
+        free_program(data.program);
+        return NULL;
+    }
+    remove_unreachable(data.program);
+    return data.program;
 }
 
 /*
- * Fills top_vars with the top 5 variables by frequency, padded by 0s
+ * Prints the IR after a stage of compilation.
  */
-void choose_vars(uint8_t *counts, uint8_t *top_counts, char *top_vars) {
-    for (uint8_t i = 0; i < 26; i++) {
-        uint8_t replace_idx = 0;
-        for (uint8_t j = 1; j < 5; j++) {
-            if (top_counts[j] < top_counts[replace_idx]) {
-                replace_idx = j;
-            }
-        }
-        uint8_t count = counts[i];
-        if (count > top_counts[replace_idx]) {
-            top_counts[replace_idx] = count;
-            top_vars[replace_idx] = 'A' + i;
-        }
-    }
+void dump_ir(char *stage, ir_program_t *program) {
+    compute_preds(program);
+    printf("# after %s\n", stage);
+    print_ir(program, stdout);
+    printf("\n");
 }
 
 /*
- * Initializes a register_data struct with the data needed to store variables
- * and temporary computations in registers while they are available.  
+ * Prints the counts of what the optimizations did, one per line.
  */
-bool compile_ast(node_t *node) {
-
-    /*
-     * Initializing arrays of caller-save and callee-save registers that can
-     * be used for temporary storage and variable storage respectively.
-     */ 
-    char *init_calc_regs[] = {"%rdi", "%rsi", "%r8", "%r9", "%r10", "%r11"};
-    char *init_var_regs[] = {"%rbx", "%r12", "%r13", "%r14", "%r15"};
-    uint8_t len_init_calc_regs = sizeof(init_calc_regs) / sizeof(init_calc_regs[0]);
-    uint8_t len_init_var_regs = sizeof(init_var_regs) / sizeof(init_var_regs[0]);
-
-    /*
-     * Initializing data structures used for identifying the most frequently
-     * appearing variables in the input program.
-     */
-    uint8_t *counts = (uint8_t *) calloc(26, sizeof(uint8_t));
-    uint8_t *top_counts = (uint8_t *) calloc(len_init_var_regs, sizeof(uint8_t));
-    char *top_vars = (char *) calloc(len_init_var_regs, sizeof(char));
-    count_vars(node, counts);
-    choose_vars(counts, top_counts, top_vars);
-
-    // Counts the number of variables for which to reserve registers.
-    uint8_t num_vars = 0;
-    for (; num_vars < len_init_var_regs && top_vars[num_vars] != 0; num_vars++)
-        ;
-
-    // Computes the number of registers to reserve for temporary storage.
-    uint8_t num_stack_regs = len_init_calc_regs + len_init_var_regs - num_vars;
-
-    char **virtual_stack = (char **) calloc(num_stack_regs, sizeof(char *));
-    char **var_regs = (char **) calloc(num_vars, sizeof(char *));
+void print_stats(ir_stats_t *stats, size_t *peephole_hits) {
+    fprintf(stderr, "estimated spills avoided by evaluation order: %zu\n",
+            stats->estimated_spills_avoided);
+    fprintf(stderr, "redundant operations eliminated: %zu\n", stats->redundant_ops);
+    fprintf(stderr, "loops replaced by closed forms: %zu\n", stats->closed_loops);
+    fprintf(stderr, "accumulators computed after loops: %zu\n",
+            stats->closed_accumulators);
+    fprintf(stderr, "products strength-reduced: %zu\n", stats->reduced_products);
+    fprintf(stderr, "divisions narrowed by value ranges: %zu\n",
+            stats->narrowed_divisions);
+    fprintf(stderr, "branches folded by value ranges: %zu\n", stats->folded_branches);
+    fprintf(stderr, "jumps threaded past empty blocks: %zu\n", stats->threaded_jumps);
+    fprintf(stderr, "cold blocks moved out of line: %zu\n", stats->cold_blocks);
+    fprintf(stderr, "branches converted to conditional moves: %zu\n",
+            stats->converted_branches);
+    for (size_t r = 0; r < NUM_PEEPHOLE_RULES; r++) {
+        fprintf(stderr, "peephole %s: %zu\n", PEEPHOLE_RULES[r], peephole_hits[r]);
+    }
+}
 
-    /*
-     * Fills the virtual stack with all caller-save registers and any callee-
-     * save registers that are not needed for variable storage.
-     */
-    uint8_t i = 0;
-    for (i = 0; i < len_init_calc_regs; i++) {
-        virtual_stack[i] = init_calc_regs[i];
+/*
+ * Lowers the program to IR, runs each optimization pass over it, then
+ * allocates registers, emits its assembly, and prints it after the
+ * peephole optimizer has run over it.
+ */
+bool compile_ast(node_t *node, compile_options_t *options, asm_buffer_t *buffer) {
+    ir_program_t *program = lower_program(node);
+    if (program == NULL) {
+        return false;
     }
-    for (i = 0; i < len_init_var_regs - num_vars; i++) {
-        virtual_stack[i + len_init_calc_regs] = init_var_regs[i];
+    if (options->emit_ir) {
+        dump_ir("lowering", program);
     }
-
-    /*
-     * Fills the array of variable registers with the remaining callee-save
-     * registers.
-     */
-    for (; i < len_init_var_regs; i++) {
-        var_regs[i - (len_init_var_regs - num_vars)] = init_var_regs[i];
+    for (size_t i = 0; i < sizeof(PASSES) / sizeof(PASSES[0]); i++) {
+        PASSES[i].run(program);
+        if (options->emit_ir) {
+            dump_ir(PASSES[i].name, program);
+        }
     }
-
-    register_data data;
-    data.stack_index = 0;
-    data.virtual_stack = virtual_stack;
-    data.var_regs = var_regs;
-    data.num_stack_regs = num_stack_regs;
-    data.num_vars = num_vars;
-    data.vars = top_vars;
-
-    bool result = compile_recursive(node, &data);
-
-    free(virtual_stack);
-    free(var_regs);
-    free(counts);
-    free(top_counts);
-    free(top_vars);
-
-    return result;
+    size_t peephole_hits[NUM_PEEPHOLE_RULES] = {0};
+    if (!options->emit_ir) {
+        emit_program(program, buffer);
+        if (options->peephole) {
+            optimize_buffer(buffer, peephole_hits);
+        }
+    }
+    if (options->print_stats) {
+        print_stats(&program->stats, peephole_hits);
+    }
+    free_program(program);
+    return true;
 }
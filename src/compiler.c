@@ -1,18 +1,26 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "compile.h"
+#include "jit.h"
+#include "object.h"
 #include "parser.h"
+#include "precompute.h"
 
 void usage(char *program) {
-    fprintf(stderr, "USAGE: %s <program file>\n", program);
+    fprintf(stderr,
+            "USAGE: %s [--emit-ir] [--stats] [--no-peephole] [--precompute=<steps>] "
+            "[--object | --run] <program file>\n",
+            program);
     exit(1);
 }
 
 /**
  * Prints the start of the the x86-64 assembly output.
- * The assembly code implementing the TeenyBASIC statements
- * goes between the header and the footer.
+ * The assembly code implementing the TeenyBASIC statements,
+ * including basic_main's prologue and epilogue, follows the header.
  */
 void header(void) {
     printf(
@@ -20,45 +28,56 @@ void header(void) {
         ".text\n"
         ".globl basic_main\n"
         "basic_main:\n"
-        "    # The main() function\n"
-        "    pushq %%rbp\n"
-        "    movq %%rsp, %%rbp\n"
-        "    subq $208, %%rsp\n"
-        "    push %%rbx\n"
-        "    push %%r12\n"
-        "    push %%r13\n"
-        "    push %%r14\n"
-        "    push %%r15\n");
-}
-
-/**
- * Prints the end of the x86-64 assembly output.
- * The assembly code implementing the TeenyBASIC statements
- * goes between the header and the footer.
- */
-void footer(void) {
-    printf(
-        "    pop %%r15\n"
-        "    pop %%r14\n"
-        "    pop %%r13\n"
-        "    pop %%r12\n"
-        "    pop %%rbx\n"
-        "    leaveq\n"
-        "    retq\n");
+        "    # The main() function\n");
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    compile_options_t options = {.emit_ir = false,
+                                 .print_stats = false,
+                                 .peephole = true,
+                                 .object = false,
+                                 .run = false};
+    // The step budget of each loop run at compile time, or 0 to run none
+    size_t precompute_budget = 0;
+    int arg = 1;
+    for (; arg < argc - 1; arg++) {
+        if (strcmp(argv[arg], "--emit-ir") == 0) {
+            options.emit_ir = true;
+        }
+        else if (strcmp(argv[arg], "--stats") == 0) {
+            options.print_stats = true;
+        }
+        else if (strcmp(argv[arg], "--no-peephole") == 0) {
+            options.peephole = false;
+        }
+        else if (strcmp(argv[arg], "--object") == 0) {
+            options.object = true;
+        }
+        else if (strcmp(argv[arg], "--run") == 0) {
+            options.run = true;
+        }
+        else if (strncmp(argv[arg], "--precompute=", strlen("--precompute=")) == 0) {
+            char *budget = argv[arg] + strlen("--precompute="), *end;
+            precompute_budget = strtoull(budget, &end, 10);
+            if (*budget == '\0' || *end != '\0') {
+                usage(argv[0]);
+            }
+        }
+        else {
+            usage(argv[0]);
+        }
+    }
+    if (arg != argc - 1 || (options.object && options.run)) {
         usage(argv[0]);
     }
 
-    FILE *program = fopen(argv[1], "r");
+    FILE *program = fopen(argv[arg], "r");
     if (program == NULL) {
         usage(argv[0]);
     }
 
-    header();
-
     node_t *ast = parse(program);
     fclose(program);
     if (ast == NULL) {
@@ -66,14 +85,55 @@ int main(int argc, char *argv[]) {
         return 2;
     }
 
+    // Run as much of the program as the budget allows, then compile the rest
+    output_t output = {.text = NULL, .length = 0, .capacity = 0};
+    if (precompute_budget > 0) {
+        precompute(&ast, precompute_budget, &output);
+    }
+    asm_buffer_t *code = init_buffer();
+    if (!options.emit_ir) {
+        emit_output_writer(code, &output, ast == NULL);
+    }
+
     // Compile the AST into assembly instructions
-    if (!compile_ast(ast)) {
+    bool compiled = ast == NULL || compile_ast(ast, &options, code);
+    if (ast != NULL) {
         free_ast(ast);
+    }
+    if (!compiled) {
+        free(output.text);
+        free_buffer(code);
         fprintf(stderr, "Compilation error\n");
         return 3;
     }
 
-    free_ast(ast);
-
-    footer();
+    // Print the assembly, assemble it into an object file, or run it
+    int status = 0;
+    if (options.run && !options.emit_ir) {
+        run_status_t run_status = run_code(code, &output, &start, options.print_stats);
+        if (run_status == RUN_ENCODING_ERROR) {
+            fprintf(stderr, "Encoding error\n");
+            status = 4;
+        }
+        else if (run_status == RUN_CONVENTION_VIOLATED) {
+            fprintf(stderr, "x86-64 calling convention violated\n");
+            status = 5;
+        }
+    }
+    else if (options.object && !options.emit_ir) {
+        if (!write_object(code, &output, stdout)) {
+            fprintf(stderr, "Encoding error\n");
+            status = 4;
+        }
+    }
+    else if (!options.emit_ir) {
+        if (output.length > 0) {
+            emit_output_data(&output);
+        }
+        header();
+        print_buffer(code, stdout);
+    }
+    free(output.text);
+    free_buffer(code);
+    return status;
 }
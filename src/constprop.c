@@ -0,0 +1,252 @@
+#include "passes.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * What is known about a value at a point in the program. Values start out
+ * UNDEFINED (not yet reached), and can only move down the lattice towards
+ * VARYING as more paths reach a point.
+ */
+typedef enum { UNDEFINED, CONSTANT, COPY, VARYING } lattice_kind_t;
+
+typedef struct {
+    lattice_kind_t kind;
+    // The value held, if CONSTANT
+    value_t constant;
+    // The value this one is equal to, if COPY
+    size_t copy;
+} lattice_t;
+
+typedef struct {
+    ir_program_t *program;
+    // What is known about each value on entry to each block, indexed by block id
+    lattice_t **in_states;
+    // Whether any path from the entry block can reach each block
+    bool *executable;
+    ir_block_t **worklist;
+    size_t worklist_size;
+    bool *queued;
+} propagation_data;
+
+/*
+ * Returns what is known about an operand's value in a state.
+ */
+lattice_t operand_lattice(ir_operand_t operand, lattice_t *state) {
+    if (operand.is_imm) {
+        lattice_t lattice = {.kind = CONSTANT, .constant = operand.imm};
+        return lattice;
+    }
+    return state[operand.value];
+}
+
+/*
+ * Updates a state for an instruction that assigns dest. Every value known
+ * to be a copy of dest's old value no longer is.
+ */
+void assign_lattice(size_t dest, lattice_t result, lattice_t *state, size_t num_values) {
+    for (size_t v = 0; v < num_values; v++) {
+        if (state[v].kind == COPY && state[v].copy == dest) {
+            state[v].kind = VARYING;
+        }
+    }
+    state[dest] = result;
+}
+
+/*
+ * Updates a state to reflect the effect of an instruction.
+ */
+void apply_instr(ir_instr_t *instr, lattice_t *state, size_t num_values) {
+    if (!has_dest(instr)) {
+        return;
+    }
+    lattice_t result = {.kind = VARYING};
+    if (instr->op == IR_MOV) {
+        lattice_t source = operand_lattice(instr->a, state);
+        if (source.kind == CONSTANT || source.kind == COPY) {
+            result = source;
+        }
+        else {
+            result.kind = COPY;
+            result.copy = instr->a.value;
+        }
+        if (result.kind == COPY && result.copy == instr->dest) {
+            // The instruction copies a value to itself.
+            return;
+        }
+    }
+    else {
+        lattice_t a = operand_lattice(instr->a, state);
+        lattice_t b = operand_lattice(instr->b, state);
+        if (a.kind == CONSTANT && b.kind == CONSTANT &&
+            fold_op(instr->op, a.constant, b.constant, &result.constant)) {
+            result.kind = CONSTANT;
+        }
+    }
+    assign_lattice(instr->dest, result, state, num_values);
+}
+
+/*
+ * Merges what is known along one path into a block's entry state.
+ * Returns true iff the entry state changed.
+ */
+bool meet_states(lattice_t *into, lattice_t *from, size_t num_values) {
+    bool changed = false;
+    for (size_t v = 0; v < num_values; v++) {
+        if (from[v].kind == UNDEFINED || into[v].kind == VARYING) {
+            continue;
+        }
+        if (into[v].kind == UNDEFINED) {
+            into[v] = from[v];
+            changed = true;
+        }
+        else if (into[v].kind != from[v].kind ||
+                 (into[v].kind == CONSTANT && into[v].constant != from[v].constant) ||
+                 (into[v].kind == COPY && into[v].copy != from[v].copy)) {
+            into[v].kind = VARYING;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/*
+ * Returns which successors of a block can run given the state at its end:
+ * both for an unknown branch, or only the one a constant branch takes.
+ */
+void executable_succs(ir_block_t *block, lattice_t *state, bool *succs) {
+    succs[0] = num_succs(block) > 0;
+    succs[1] = num_succs(block) > 1;
+    if (block->term.kind != TERM_BRANCH) {
+        return;
+    }
+    lattice_t a = operand_lattice(block->term.a, state);
+    lattice_t b = operand_lattice(block->term.b, state);
+    if (a.kind == CONSTANT && b.kind == CONSTANT) {
+        bool taken = eval_cond(block->term.cond, a.constant, b.constant);
+        succs[0] = taken;
+        succs[1] = !taken;
+    }
+}
+
+/*
+ * Propagates the state at the end of a block along its executable edges,
+ * queueing the successors whose entry states change.
+ */
+void propagate_block(ir_block_t *block, lattice_t *state, propagation_data *data) {
+    size_t num_values = data->program->num_values;
+    bool succs[2];
+    executable_succs(block, state, succs);
+    for (size_t s = 0; s < 2; s++) {
+        if (!succs[s]) {
+            continue;
+        }
+        ir_block_t *succ = block->term.targets[s];
+        bool changed = meet_states(data->in_states[succ->id], state, num_values);
+        if ((changed || !data->executable[succ->id]) && !data->queued[succ->id]) {
+            data->queued[succ->id] = true;
+            data->worklist[data->worklist_size++] = succ;
+        }
+        data->executable[succ->id] = true;
+    }
+}
+
+/*
+ * Replaces an operand with the constant or earlier value it is known to equal.
+ */
+void substitute_operand(ir_operand_t *operand, lattice_t *state) {
+    if (operand->is_imm) {
+        return;
+    }
+    lattice_t lattice = state[operand->value];
+    if (lattice.kind == CONSTANT) {
+        *operand = imm_operand(lattice.constant);
+    }
+    else if (lattice.kind == COPY) {
+        operand->value = lattice.copy;
+    }
+}
+
+/*
+ * Rewrites an executable block given what is known on entry to it: operands
+ * are replaced by known constants and copies, operations on constants are
+ * folded, and branches on constants become jumps.
+ */
+void rewrite_block(ir_block_t *block, lattice_t *state, size_t num_values) {
+    for (size_t j = 0; j < block->num_instrs; j++) {
+        ir_instr_t *instr = &block->instrs[j];
+        substitute_operand(&instr->a, state);
+        if (is_binary(instr->op)) {
+            substitute_operand(&instr->b, state);
+        }
+        value_t result;
+        if (is_binary(instr->op) && instr->a.is_imm && instr->b.is_imm &&
+            fold_op(instr->op, instr->a.imm, instr->b.imm, &result)) {
+            instr->op = IR_MOV;
+            instr->a = imm_operand(result);
+        }
+        apply_instr(instr, state, num_values);
+    }
+    ir_term_t *term = &block->term;
+    if (term->kind == TERM_BRANCH) {
+        substitute_operand(&term->a, state);
+        substitute_operand(&term->b, state);
+        if (term->a.is_imm && term->b.is_imm) {
+            bool taken = eval_cond(term->cond, term->a.imm, term->b.imm);
+            term->kind = TERM_JUMP;
+            term->targets[0] = term->targets[taken ? 0 : 1];
+        }
+    }
+}
+
+void propagate_constants(ir_program_t *program) {
+    compute_preds(program);
+    size_t n = program->num_blocks;
+    size_t num_values = program->num_values;
+    propagation_data data;
+    data.program = program;
+    data.in_states = malloc(n * sizeof(lattice_t *));
+    data.executable = calloc(n, sizeof(bool));
+    data.worklist = malloc(n * sizeof(ir_block_t *));
+    data.queued = calloc(n, sizeof(bool));
+    lattice_t *state = malloc(num_values * sizeof(lattice_t));
+    assert(data.in_states != NULL && data.executable != NULL && data.worklist != NULL &&
+           data.queued != NULL && state != NULL);
+    for (size_t i = 0; i < n; i++) {
+        data.in_states[i] = calloc(num_values, sizeof(lattice_t));
+        assert(data.in_states[i] != NULL);
+    }
+
+    // Nothing is known about values on entry, including uninitialized variables.
+    for (size_t v = 0; v < num_values; v++) {
+        data.in_states[0][v].kind = VARYING;
+    }
+    data.executable[0] = true;
+    data.queued[0] = true;
+    data.worklist[0] = program->blocks[0];
+    data.worklist_size = 1;
+    while (data.worklist_size > 0) {
+        ir_block_t *block = data.worklist[--data.worklist_size];
+        data.queued[block->id] = false;
+        memcpy(state, data.in_states[block->id], num_values * sizeof(lattice_t));
+        for (size_t j = 0; j < block->num_instrs; j++) {
+            apply_instr(&block->instrs[j], state, num_values);
+        }
+        propagate_block(block, state, &data);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        if (data.executable[i]) {
+            memcpy(state, data.in_states[i], num_values * sizeof(lattice_t));
+            rewrite_block(program->blocks[i], state, num_values);
+        }
+        free(data.in_states[i]);
+    }
+    free(data.in_states);
+    free(data.executable);
+    free(data.worklist);
+    free(data.queued);
+    free(state);
+    remove_unreachable(program);
+}
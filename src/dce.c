@@ -0,0 +1,62 @@
+#include "passes.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Marks an operand's value as live.
+ */
+void mark_live(ir_operand_t operand, uint64_t *live) {
+    if (!operand.is_imm) {
+        set_add(live, operand.value);
+    }
+}
+
+/*
+ * Removes the instructions in a block whose results are never read.
+ * Returns true iff any were removed.
+ */
+bool remove_dead_instrs(ir_block_t *block, uint64_t *live) {
+    bool removed = false;
+    if (block->term.kind == TERM_BRANCH) {
+        mark_live(block->term.a, live);
+        mark_live(block->term.b, live);
+    }
+    for (size_t j = block->num_instrs; j > 0; j--) {
+        ir_instr_t *instr = &block->instrs[j - 1];
+        if (has_dest(instr)) {
+            bool self_copy = instr->op == IR_MOV && !instr->a.is_imm &&
+                             instr->a.value == instr->dest;
+            if ((!set_has(live, instr->dest) && !may_trap(instr)) || self_copy) {
+                remove_instr(block, j - 1);
+                removed = true;
+                continue;
+            }
+            set_remove(live, instr->dest);
+        }
+        mark_live(instr->a, live);
+        if (is_binary(instr->op)) {
+            mark_live(instr->b, live);
+        }
+    }
+    return removed;
+}
+
+void remove_dead_code(ir_program_t *program) {
+    // Removing an instruction can make the ones feeding it dead in other blocks.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        compute_preds(program);
+        ir_liveness_t *liveness = compute_liveness(program);
+        uint64_t *live = malloc(liveness->words * sizeof(uint64_t));
+        assert(live != NULL);
+        for (size_t i = 0; i < program->num_blocks; i++) {
+            memcpy(live, liveness->live_out[i], liveness->words * sizeof(uint64_t));
+            changed |= remove_dead_instrs(program->blocks[i], live);
+        }
+        free(live);
+        free_liveness(liveness);
+    }
+}
@@ -0,0 +1,1318 @@
+#include "emit.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "asm.h"
+#include "regalloc.h"
+
+/*
+ * The registers available to values, in the order they are handed out.
+ * %rax, %rcx and %rdx are reserved as scratch registers for operations,
+ * comparisons and idivq.
+ */
+char *const REGS[NUM_REGS] = {"%rbx", "%r12", "%r13", "%r14", "%r15", "%rdi",
+                              "%rsi", "%r8",  "%r9",  "%r10", "%r11"};
+// The index in REGS of the first caller-save register
+#define FIRST_CALLER_SAVE 5
+// The index in REGS of %rdi, where print_int expects its argument
+#define RDI 5
+
+// The latency in cycles of imulq, which a replacement sequence must beat
+#define IMUL_LATENCY 3
+// The factors leaq can multiply by, computing x + x * (factor - 1)
+const uint8_t LEA_FACTORS[] = {1, 3, 5, 9};
+#define NUM_LEA_FACTORS 4
+
+// The most instructions an IF can have in its branches and still be replaced
+// by conditional moves, which run both branches' instructions every time
+#define MAX_CONVERTED_INSTRS 4
+
+// The condition code suffix for each ir_cond_t
+char *const CONDS[] = {"l", "e", "g", "le", "ne", "ge"};
+// The instruction for each arithmetic ir_op_t other than division
+char *const OPCODES[] = {"", "addq", "subq", "imulq"};
+
+// The ways a multiplication by a constant can combine its shifted operand x
+typedef enum {
+    // (x * factors[0] * factors[1]) << shift
+    MUL_SHIFT,
+    // (x << shift) + x
+    MUL_ADD,
+    // (x << shift) - x
+    MUL_SUB,
+    // x - (x << shift)
+    MUL_SUB_FROM
+} mul_combine_t;
+
+// A sequence of instructions multiplying by a constant, ending with an optional negation
+typedef struct {
+    uint8_t factors[2];
+    uint8_t shift;
+    mul_combine_t combine;
+    bool negate;
+    // The number of cycles on the sequence's critical path
+    uint8_t latency;
+} mul_plan_t;
+
+typedef struct {
+    // The register holding each value, or NULL if the value is in its stack slot
+    char **regs;
+    // The offset from %rsp of the stack slot of each value not in a register
+    int32_t *offsets;
+    // Whether each callee-save register is assigned to a value, and so must be saved
+    bool saved[FIRST_CALLER_SAVE];
+    // The number of bytes reserved below the saved registers for stack slots
+    uint32_t frame_size;
+    // The buffer the instructions are emitted into
+    asm_buffer_t *buffer;
+} location_data;
+
+/*
+ * Replaces the value an operand reads with its renamed value.
+ */
+void rename_operand(ir_operand_t *operand, size_t *renamed) {
+    if (!operand->is_imm) {
+        operand->value = renamed[operand->value];
+    }
+}
+
+/*
+ * Finds a block outside loop that can be reached both from inside and from
+ * outside the loop, and routes the edges from inside the loop through a new
+ * block placed after the loop, where copies out of the loop can go.
+ * Returns false if every exit is already reached only from inside the loop.
+ */
+bool add_exit_block(ir_program_t *program, ir_loop_t *loop) {
+    size_t last = 0;
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        if (loop->in_loop[i]) {
+            last = i;
+        }
+    }
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        if (loop->in_loop[i]) {
+            continue;
+        }
+        bool exited = false;
+        bool entered = false;
+        for (size_t p = 0; p < block->num_preds; p++) {
+            if (loop->in_loop[block->preds[p]->id]) {
+                exited = true;
+            }
+            else {
+                entered = true;
+            }
+        }
+        if (!exited || !entered) {
+            continue;
+        }
+
+        ir_block_t *landing = init_block(block->weight);
+        landing->term.kind = TERM_JUMP;
+        landing->term.targets[0] = block;
+        for (size_t p = 0; p < block->num_preds; p++) {
+            ir_block_t *pred = block->preds[p];
+            for (size_t s = 0; loop->in_loop[pred->id] && s < num_succs(pred); s++) {
+                if (pred->term.targets[s] == block) {
+                    pred->term.targets[s] = landing;
+                }
+            }
+        }
+        insert_block(program, last + 1, landing);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Marks the value an operand reads, if any.
+ */
+void mark_operand(ir_operand_t operand, bool *used) {
+    if (!operand.is_imm) {
+        used[operand.value] = true;
+    }
+}
+
+/*
+ * Marks the values a block assigns or reads.
+ */
+void mark_block(ir_block_t *block, bool *used) {
+    for (size_t j = 0; j < block->num_instrs; j++) {
+        ir_instr_t *instr = &block->instrs[j];
+        if (has_dest(instr)) {
+            used[instr->dest] = true;
+        }
+        mark_operand(instr->a, used);
+        if (is_binary(instr->op)) {
+            mark_operand(instr->b, used);
+        }
+    }
+    if (block->term.kind == TERM_BRANCH) {
+        mark_operand(block->term.a, used);
+        mark_operand(block->term.b, used);
+    }
+}
+
+/*
+ * Gives the variables in a loop their own values, copied from the values
+ * outside the loop in the preheader and back at the start of each exit.
+ */
+void split_loop(ir_program_t *program, ir_loop_t *loop) {
+    ir_liveness_t *liveness = compute_liveness(program);
+    size_t num_values = program->num_values;
+    uint64_t *header_live = liveness->live_in[loop->header->id];
+    bool *used = calloc(num_values, sizeof(bool));
+    size_t *renamed = malloc(num_values * sizeof(size_t));
+    assert(used != NULL && renamed != NULL);
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        if (loop->in_loop[i]) {
+            mark_block(program->blocks[i], used);
+        }
+    }
+    for (size_t v = 0; v < num_values; v++) {
+        renamed[v] = v;
+        if (program->names[v] != '\0' && (used[v] || set_has(header_live, v))) {
+            renamed[v] = new_var_value(program, program->names[v]);
+        }
+    }
+
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        if (!loop->in_loop[i]) {
+            continue;
+        }
+        for (size_t j = 0; j < block->num_instrs; j++) {
+            ir_instr_t *instr = &block->instrs[j];
+            if (has_dest(instr)) {
+                instr->dest = renamed[instr->dest];
+            }
+            rename_operand(&instr->a, renamed);
+            if (is_binary(instr->op)) {
+                rename_operand(&instr->b, renamed);
+            }
+        }
+        if (block->term.kind == TERM_BRANCH) {
+            rename_operand(&block->term.a, renamed);
+            rename_operand(&block->term.b, renamed);
+        }
+    }
+
+    for (size_t v = 0; v < num_values; v++) {
+        if (renamed[v] != v && set_has(header_live, v)) {
+            ir_instr_t copy = {.op = IR_MOV, .dest = renamed[v], .a = value_operand(v)};
+            add_instr(loop->preheader, copy);
+        }
+    }
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        if (loop->in_loop[i] || block->num_preds == 0 ||
+            !loop->in_loop[block->preds[0]->id]) {
+            continue;
+        }
+        uint64_t *exit_live = liveness->live_in[i];
+        for (size_t v = 0; v < num_values; v++) {
+            if (renamed[v] != v && set_has(exit_live, v)) {
+                ir_instr_t copy = {
+                    .op = IR_MOV, .dest = v, .a = value_operand(renamed[v])};
+                insert_instr(block, 0, copy);
+            }
+        }
+    }
+
+    free(used);
+    free(renamed);
+    free_liveness(liveness);
+}
+
+void split_loops(ir_program_t *program) {
+    size_t num_loops;
+    ir_loop_t *loops;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        compute_preds(program);
+        loops = find_loops(program, &num_loops);
+        for (size_t l = 0; l < num_loops && !changed; l++) {
+            changed = loops[l].preheader != NULL && add_exit_block(program, &loops[l]);
+        }
+        free_loops(loops, num_loops);
+    }
+
+    compute_preds(program);
+    loops = find_loops(program, &num_loops);
+    for (size_t l = 0; l < num_loops; l++) {
+        if (loops[l].preheader != NULL) {
+            split_loop(program, &loops[l]);
+        }
+    }
+    free_loops(loops, num_loops);
+}
+
+/*
+ * Records that a value interferes with every value in live, except skip.
+ */
+void interfere_live(graph_t *graph, size_t value, uint64_t *live, size_t words,
+                    size_t skip) {
+    for (size_t w = 0; w < words; w++) {
+        uint64_t bits = live[w];
+        while (bits != 0) {
+            size_t other = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            if (other != value && other != skip) {
+                add_interference(graph, NUM_REGS + value, NUM_REGS + other);
+            }
+        }
+    }
+}
+
+/*
+ * Charges a read of an operand to its value's spill cost and marks it live.
+ */
+void read_operand(graph_t *graph, ir_operand_t operand, uint64_t *live, uint64_t weight) {
+    if (!operand.is_imm) {
+        add_cost(graph, NUM_REGS + operand.value, weight);
+        set_add(live, operand.value);
+    }
+}
+
+/*
+ * Builds the interference graph of a program's values, following Chaitin:
+ * a value interferes with everything live where it is assigned, except the
+ * value it is copied from. Values live across a PRINT interfere with the
+ * caller-save registers, which print_int may clobber.
+ */
+graph_t *build_graph(ir_program_t *program) {
+    compute_preds(program);
+    ir_liveness_t *liveness = compute_liveness(program);
+    size_t words = liveness->words;
+    graph_t *graph = init_graph(NUM_REGS + program->num_values, NUM_REGS);
+    uint64_t *live = malloc(words * sizeof(uint64_t));
+    assert(live != NULL);
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        uint64_t weight = block->weight;
+        memcpy(live, liveness->live_out[i], words * sizeof(uint64_t));
+        if (block->term.kind == TERM_BRANCH) {
+            read_operand(graph, block->term.a, live, weight);
+            read_operand(graph, block->term.b, live, weight);
+        }
+        for (size_t j = block->num_instrs; j > 0; j--) {
+            ir_instr_t *instr = &block->instrs[j - 1];
+            if (instr->op == IR_PRINT) {
+                for (size_t w = 0; w < words; w++) {
+                    uint64_t bits = live[w];
+                    while (bits != 0) {
+                        size_t value = w * 64 + __builtin_ctzll(bits);
+                        bits &= bits - 1;
+                        for (uint8_t r = FIRST_CALLER_SAVE; r < NUM_REGS; r++) {
+                            add_interference(graph, NUM_REGS + value, r);
+                        }
+                    }
+                }
+                if (!instr->a.is_imm) {
+                    add_move(graph, NUM_REGS + instr->a.value, RDI, weight, false);
+                }
+            }
+            else {
+                size_t source = SIZE_MAX;
+                if (instr->op == IR_MOV && !instr->a.is_imm) {
+                    source = instr->a.value;
+                    add_move(graph, NUM_REGS + instr->dest, NUM_REGS + source, weight,
+                             true);
+                }
+                interfere_live(graph, instr->dest, live, words, source);
+                add_cost(graph, NUM_REGS + instr->dest, weight);
+                set_remove(live, instr->dest);
+            }
+            read_operand(graph, instr->a, live, weight);
+            if (is_binary(instr->op)) {
+                read_operand(graph, instr->b, live, weight);
+            }
+        }
+    }
+
+    // Values read before they are assigned start out distinct.
+    uint64_t *entry_live = liveness->live_in[0];
+    for (size_t w = 0; w < words; w++) {
+        uint64_t bits = entry_live[w];
+        while (bits != 0) {
+            size_t value = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            interfere_live(graph, value, entry_live, words, SIZE_MAX);
+        }
+    }
+
+    free(live);
+    free_liveness(liveness);
+    return graph;
+}
+
+/*
+ * Colors the interference graph and decides where each value lives.
+ * Spilled copies of a variable share its home slot unless they interfere
+ * with a copy already there; every other spilled value gets a slot of its
+ * own. Slots are laid out from the most to the least frequently accessed, so
+ * the values a hot loop spills are packed into as few cache lines as possible.
+ */
+void assign_locations(ir_program_t *program, location_data *locs) {
+    graph_t *graph = build_graph(program);
+    color_graph(graph);
+
+    size_t n = program->num_values;
+    locs->regs = calloc(n, sizeof(char *));
+    locs->offsets = calloc(n, sizeof(int32_t));
+    size_t *slots = malloc(n * sizeof(size_t));
+    size_t *home_owners = malloc(n * sizeof(size_t));
+    uint64_t *slot_weights = calloc(n, sizeof(uint64_t));
+    bool *used = calloc(n, sizeof(bool));
+    assert(locs->regs != NULL && locs->offsets != NULL && slots != NULL &&
+           home_owners != NULL && slot_weights != NULL && used != NULL);
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        mark_block(program->blocks[i], used);
+    }
+    memset(locs->saved, false, sizeof(locs->saved));
+    size_t num_owners = 0;
+    size_t num_slots = 0;
+    // The slot each variable's spilled copies share, or SIZE_MAX if none is spilled yet
+    size_t home_slots[NUM_VARS];
+    for (size_t i = 0; i < NUM_VARS; i++) {
+        home_slots[i] = SIZE_MAX;
+    }
+    for (size_t v = 0; v < n; v++) {
+        int8_t color = graph->colors[NUM_REGS + v];
+        if (!used[v]) {
+            continue;
+        }
+        if (color != SPILLED) {
+            locs->regs[v] = REGS[color];
+            if (color < FIRST_CALLER_SAVE) {
+                locs->saved[color] = true;
+            }
+            continue;
+        }
+        var_name_t name = program->names[v];
+        bool home = name != '\0';
+        for (size_t o = 0; home && o < num_owners; o++) {
+            size_t owner = home_owners[o];
+            home = program->names[owner] != name ||
+                   !interferes(graph, NUM_REGS + owner, NUM_REGS + v);
+        }
+        size_t slot = num_slots;
+        if (home && home_slots[name - 'A'] != SIZE_MAX) {
+            slot = home_slots[name - 'A'];
+        }
+        else {
+            num_slots++;
+        }
+        if (home) {
+            home_slots[name - 'A'] = slot;
+            home_owners[num_owners++] = v;
+        }
+        slots[v] = slot;
+        slot_weights[slot] += graph->costs[NUM_REGS + v];
+    }
+
+    // Ranks each slot by weight, breaking ties by the order the slots were made.
+    size_t *ranks = malloc(num_slots * sizeof(size_t));
+    assert(num_slots == 0 || ranks != NULL);
+    for (size_t i = 0; i < num_slots; i++) {
+        ranks[i] = 0;
+        for (size_t j = 0; j < num_slots; j++) {
+            ranks[i] += slot_weights[j] > slot_weights[i] ||
+                        (slot_weights[j] == slot_weights[i] && j < i);
+        }
+    }
+    for (size_t v = 0; v < n; v++) {
+        if (used[v] && locs->regs[v] == NULL) {
+            locs->offsets[v] = 8 * (int32_t) ranks[slots[v]];
+        }
+    }
+
+    // Keeps %rsp 16-byte aligned at each call, counting the return address
+    // and the saved registers pushed above the slots.
+    size_t pushed = 1;
+    for (uint8_t r = 0; r < FIRST_CALLER_SAVE; r++) {
+        pushed += locs->saved[r];
+    }
+    locs->frame_size = (uint32_t) (num_slots + (num_slots + pushed) % 2) * 8;
+
+    free(slots);
+    free(home_owners);
+    free(slot_weights);
+    free(used);
+    free(ranks);
+    free_graph(graph);
+}
+
+/*
+ * Formats an operand as an AT&T assembly operand: an immediate,
+ * a register, or a stack slot.
+ */
+void format_operand(ir_operand_t operand, location_data *locs, char *buffer,
+                    size_t size) {
+    if (operand.is_imm) {
+        snprintf(buffer, size, "$%" PRId64, operand.imm);
+    }
+    else if (locs->regs[operand.value] != NULL) {
+        snprintf(buffer, size, "%s", locs->regs[operand.value]);
+    }
+    else {
+        snprintf(buffer, size, "%" PRId32 "(%%rsp)", locs->offsets[operand.value]);
+    }
+}
+
+/*
+ * Returns true iff an operand lives in a stack slot.
+ */
+bool in_memory(ir_operand_t operand, location_data *locs) {
+    return !operand.is_imm && locs->regs[operand.value] == NULL;
+}
+
+/*
+ * Returns true iff a constant fits in a sign-extended 32-bit immediate.
+ */
+bool fits_imm32(value_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+/*
+ * Prints a copy of source into dest, going through %rax when x86-64 cannot
+ * copy directly between them.
+ */
+void emit_move(ir_operand_t source, ir_operand_t dest, location_data *locs) {
+    char from[32];
+    char to[32];
+    format_operand(source, locs, from, sizeof(from));
+    format_operand(dest, locs, to, sizeof(to));
+    if (strcmp(from, to) == 0) {
+        return;
+    }
+    if (in_memory(dest, locs) &&
+        (in_memory(source, locs) || (source.is_imm && !fits_imm32(source.imm)))) {
+        emit(locs->buffer, "movq %s, %%rax", from);
+        emit(locs->buffer, "movq %%rax, %s", to);
+    }
+    else {
+        emit(locs->buffer, "movq %s, %s", from, to);
+    }
+}
+
+/*
+ * Prints a copy of an operand into a register.
+ */
+void emit_load(ir_operand_t source, char *reg, location_data *locs) {
+    char from[32];
+    format_operand(source, locs, from, sizeof(from));
+    if (strcmp(from, reg) != 0) {
+        emit(locs->buffer, "movq %s, %s", from, reg);
+    }
+}
+
+/*
+ * Prints a copy of a register into the location of a value.
+ */
+void emit_store(char *reg, size_t dest, location_data *locs) {
+    char to[32];
+    format_operand(value_operand(dest), locs, to, sizeof(to));
+    if (strcmp(reg, to) != 0) {
+        emit(locs->buffer, "movq %s, %s", reg, to);
+    }
+}
+
+/*
+ * Plans a multiplication by a constant's magnitude m as a chain of leaq,
+ * shift, add and subtract instructions, and returns true iff its latency
+ * beats imulq. Tries m = f * g * 2^k for leaq factors f and g (a leaq computes
+ * x + x * (f - 1) in one cycle), and m = 2^k + 1 or 2^k - 1 as a shift
+ * combined with the original operand.
+ */
+bool plan_multiply(uint64_t m, bool negate, mul_plan_t *plan) {
+    memset(plan, 0, sizeof(*plan));
+    plan->latency = UINT8_MAX;
+    if (m == 0) {
+        plan->latency = 1;
+        return true;
+    }
+
+    uint8_t k = __builtin_ctzll(m);
+    uint64_t odd = m >> k;
+    for (uint8_t i = 0; i < NUM_LEA_FACTORS; i++) {
+        for (uint8_t j = i; j < NUM_LEA_FACTORS; j++) {
+            if ((uint64_t) LEA_FACTORS[i] * LEA_FACTORS[j] != odd) {
+                continue;
+            }
+            uint8_t latency = (i > 0) + (j > 0) + (k > 0) + negate;
+            if (latency < plan->latency) {
+                plan->factors[0] = LEA_FACTORS[i];
+                plan->factors[1] = LEA_FACTORS[j];
+                plan->shift = k;
+                plan->combine = MUL_SHIFT;
+                plan->negate = negate;
+                plan->latency = latency;
+            }
+        }
+    }
+
+    // Multiplying by -(2^k - 1) is x - (x << k), which needs no negation.
+    uint64_t below = m - 1;
+    uint64_t above = m + 1;
+    if (m > 2 && (below & (below - 1)) == 0 && 2 + negate < plan->latency) {
+        plan->shift = __builtin_ctzll(below);
+        plan->combine = MUL_ADD;
+        plan->negate = negate;
+        plan->latency = 2 + negate;
+    }
+    if (above != 0 && (above & (above - 1)) == 0 && 2 < plan->latency) {
+        plan->shift = __builtin_ctzll(above);
+        plan->combine = negate ? MUL_SUB_FROM : MUL_SUB;
+        plan->negate = false;
+        plan->latency = 2;
+    }
+    return plan->latency < IMUL_LATENCY;
+}
+
+/*
+ * Prints assembly computing a * factor into a register other than %rcx.
+ * Uses a chain of cheaper instructions when the cost model favors it,
+ * and imulq with an immediate operand otherwise.
+ */
+void emit_multiply_by_constant(ir_operand_t a, value_t factor, char *reg,
+                               location_data *locs) {
+    uint64_t m = factor < 0 ? -(uint64_t) factor : (uint64_t) factor;
+    mul_plan_t plan;
+    if (!plan_multiply(m, factor < 0, &plan)) {
+        if (!fits_imm32(factor)) {
+            emit_load(a, reg, locs);
+            emit(locs->buffer, "movq $%" PRId64 ", %%rcx", factor);
+            emit(locs->buffer, "imulq %%rcx, %s", reg);
+            return;
+        }
+        char source[32];
+        format_operand(a, locs, source, sizeof(source));
+        if (a.is_imm) {
+            emit_load(a, reg, locs);
+            strcpy(source, reg);
+        }
+        emit(locs->buffer, "imulq $%" PRId64 ", %s, %s", factor, source, reg);
+        return;
+    }
+
+    if (m == 0) {
+        emit(locs->buffer, "movq $0, %s", reg);
+        return;
+    }
+    emit_load(a, reg, locs);
+    if (plan.combine == MUL_SHIFT) {
+        for (uint8_t i = 0; i < 2; i++) {
+            if (plan.factors[i] > 1) {
+                emit(locs->buffer, "leaq (%s,%s,%" PRIu8 "), %s", reg, reg,
+                       (uint8_t) (plan.factors[i] - 1), reg);
+            }
+        }
+        if (plan.shift > 0) {
+            emit(locs->buffer, "salq $%" PRIu8 ", %s", plan.shift, reg);
+        }
+    }
+    else {
+        emit(locs->buffer, "movq %s, %%rcx", reg);
+        if (plan.combine == MUL_SUB_FROM) {
+            emit(locs->buffer, "salq $%" PRIu8 ", %%rcx", plan.shift);
+            emit(locs->buffer, "subq %%rcx, %s", reg);
+        }
+        else {
+            emit(locs->buffer, "salq $%" PRIu8 ", %s", plan.shift, reg);
+            emit(locs->buffer, "%s %%rcx, %s", plan.combine == MUL_ADD ? "addq" : "subq",
+                 reg);
+        }
+    }
+    if (plan.negate) {
+        emit(locs->buffer, "negq %s", reg);
+    }
+}
+
+/*
+ * Computes the multiplier and shift for dividing by a constant with a
+ * multiply-high, following Hacker's Delight (figure 10-1): for divisors other
+ * than 0, 1 and -1, the quotient n / divisor is the high 64 bits of
+ * n * multiplier, corrected by adding n when the divisor is positive and the
+ * multiplier negative (or subtracting n in the opposite case), shifted right
+ * by shift, then incremented if negative.
+ */
+void magic_division(value_t divisor, value_t *multiplier, uint8_t *shift) {
+    const uint64_t two63 = (uint64_t) 1 << 63;
+    uint64_t abs_divisor = divisor < 0 ? -(uint64_t) divisor : (uint64_t) divisor;
+    uint64_t t = two63 + ((uint64_t) divisor >> 63);
+    // The largest dividend whose remainder is abs_divisor - 1
+    uint64_t abs_nc = t - 1 - t % abs_divisor;
+    uint8_t p = 63;
+    uint64_t q1 = two63 / abs_nc;
+    uint64_t r1 = two63 - q1 * abs_nc;
+    uint64_t q2 = two63 / abs_divisor;
+    uint64_t r2 = two63 - q2 * abs_divisor;
+    uint64_t delta;
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= abs_nc) {
+            q1++;
+            r1 -= abs_nc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= abs_divisor) {
+            q2++;
+            r2 -= abs_divisor;
+        }
+        delta = abs_divisor - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    uint64_t magic = q2 + 1;
+    *multiplier = (value_t) (divisor < 0 ? -magic : magic);
+    *shift = p - 64;
+}
+
+/*
+ * Prints assembly computing a / divisor into %rax without idivq, for a
+ * divisor other than 0 and -1. Truncates towards 0 like idivq: dividing by
+ * 2^k adds 2^k - 1 to negative dividends before shifting, and other divisors
+ * use a multiply-high by a magic number, incremented if negative. Neither
+ * correction is needed when the dividend is known to be non-negative and the
+ * quotient cannot be negative.
+ */
+void emit_divide_by_constant(ir_operand_t a, value_t divisor, bool non_negative,
+                             location_data *locs) {
+    uint64_t abs_divisor = divisor < 0 ? -(uint64_t) divisor : (uint64_t) divisor;
+    if ((abs_divisor & (abs_divisor - 1)) == 0) {
+        uint8_t k = __builtin_ctzll(abs_divisor);
+        emit_load(a, "%rax", locs);
+        if (k > 0 && non_negative) {
+            emit(locs->buffer, "sarq $%" PRIu8 ", %%rax", k);
+        }
+        else if (k > 0) {
+            emit(locs->buffer, "movq %%rax, %%rcx");
+            if (k > 1) {
+                emit(locs->buffer, "sarq $63, %%rcx");
+            }
+            emit(locs->buffer, "shrq $%" PRIu8 ", %%rcx", (uint8_t) (64 - k));
+            emit(locs->buffer, "addq %%rcx, %%rax");
+            emit(locs->buffer, "sarq $%" PRIu8 ", %%rax", k);
+        }
+        if (divisor < 0) {
+            emit(locs->buffer, "negq %%rax");
+        }
+        return;
+    }
+
+    value_t multiplier;
+    uint8_t shift;
+    magic_division(divisor, &multiplier, &shift);
+    emit_load(a, "%rcx", locs);
+    emit(locs->buffer, "movq $%" PRId64 ", %%rax", multiplier);
+    emit(locs->buffer, "imulq %%rcx");
+    if (divisor > 0 && multiplier < 0) {
+        emit(locs->buffer, "addq %%rcx, %%rdx");
+    }
+    else if (divisor < 0 && multiplier > 0) {
+        emit(locs->buffer, "subq %%rcx, %%rdx");
+    }
+    if (shift > 0) {
+        emit(locs->buffer, "sarq $%" PRIu8 ", %%rdx", shift);
+    }
+    emit(locs->buffer, "movq %%rdx, %%rax");
+    if (!non_negative || divisor < 0) {
+        emit(locs->buffer, "shrq $63, %%rax");
+        emit(locs->buffer, "addq %%rdx, %%rax");
+    }
+}
+
+/*
+ * Formats an operand for use as the source of a two-operand instruction,
+ * first loading it into scratch if it is a constant too wide for an immediate.
+ */
+void format_source(ir_operand_t operand, char *scratch, location_data *locs,
+                   char *buffer, size_t size) {
+    if (operand.is_imm && !fits_imm32(operand.imm)) {
+        emit_load(operand, scratch, locs);
+        snprintf(buffer, size, "%s", scratch);
+    }
+    else {
+        format_operand(operand, locs, buffer, size);
+    }
+}
+
+/*
+ * Prints assembly for an addition, subtraction or multiplication of two
+ * operands that are not both constants, operating directly on the dest's
+ * register where possible. A sum into a register that neither operand is in
+ * becomes a single leaq. An operand in the dest's register is used in place,
+ * and a dest in a stack slot is updated in place when it is also the first
+ * operand; otherwise the result is computed in %rax and stored.
+ */
+void emit_two_operand(ir_instr_t *instr, location_data *locs) {
+    char *opcode = OPCODES[instr->op];
+    char dest[32], a[32], b[32];
+    format_operand(value_operand(instr->dest), locs, dest, sizeof(dest));
+    format_operand(instr->a, locs, a, sizeof(a));
+    format_operand(instr->b, locs, b, sizeof(b));
+
+    if (!in_memory(value_operand(instr->dest), locs)) {
+        bool a_in_reg = !instr->a.is_imm && !in_memory(instr->a, locs);
+        if (instr->op == IR_ADD && a_in_reg && strcmp(a, dest) != 0 &&
+            strcmp(b, dest) != 0 && !in_memory(instr->b, locs) &&
+            (!instr->b.is_imm || fits_imm32(instr->b.imm))) {
+            if (instr->b.is_imm) {
+                emit(locs->buffer, "leaq %" PRId64 "(%s), %s", instr->b.imm, a, dest);
+            }
+            else {
+                emit(locs->buffer, "leaq (%s,%s), %s", a, b, dest);
+            }
+            return;
+        }
+        if (strcmp(b, dest) == 0 && strcmp(a, dest) != 0) {
+            format_source(instr->a, "%rcx", locs, a, sizeof(a));
+            if (instr->op == IR_SUB) {
+                emit(locs->buffer, "negq %s", dest);
+                emit(locs->buffer, "addq %s, %s", a, dest);
+            }
+            else {
+                emit(locs->buffer, "%s %s, %s", opcode, a, dest);
+            }
+            return;
+        }
+        emit_load(instr->a, dest, locs);
+        format_source(instr->b, "%rcx", locs, b, sizeof(b));
+        emit(locs->buffer, "%s %s, %s", opcode, b, dest);
+        return;
+    }
+
+    if (strcmp(a, dest) == 0 && instr->op != IR_MUL) {
+        if (in_memory(instr->b, locs) || (instr->b.is_imm && !fits_imm32(instr->b.imm))) {
+            emit_load(instr->b, "%rcx", locs);
+            strcpy(b, "%rcx");
+        }
+        emit(locs->buffer, "%s %s, %s", opcode, b, dest);
+        return;
+    }
+    emit_load(instr->a, "%rax", locs);
+    format_source(instr->b, "%rcx", locs, b, sizeof(b));
+    emit(locs->buffer, "%s %s, %%rax", opcode, b);
+    emit_store("%rax", instr->dest, locs);
+}
+
+/*
+ * Returns true iff a division or remainder is computed with a divide
+ * instruction, leaving the quotient in %rax and the remainder in %rdx.
+ */
+bool uses_divider(ir_instr_t *instr) {
+    return (instr->op == IR_DIV || instr->op == IR_MOD) &&
+           (!instr->b.is_imm || may_trap(instr));
+}
+
+/*
+ * Formats the low 32 bits of an operand: the low half of its register, or
+ * its stack slot or constant unchanged.
+ */
+void format_low_half(ir_operand_t operand, location_data *locs, char *buffer,
+                     size_t size) {
+    format_operand(operand, locs, buffer, size);
+    if (!operand.is_imm && !in_memory(operand, locs)) {
+        snprintf(buffer, size, "%s", low_half(locs->regs[operand.value]));
+    }
+}
+
+/*
+ * Prints assembly dividing an instruction's operands. Operands known to fit
+ * in 32 bits use the much faster unsigned divl, which zeroes the upper halves
+ * of %rax and %rdx; others need the full signed idivq.
+ */
+void emit_divider(ir_instr_t *instr, location_data *locs) {
+    char b[32];
+    bool narrow = instr->range == RANGE_32_BIT;
+    if (narrow) {
+        char a[32];
+        format_low_half(instr->a, locs, a, sizeof(a));
+        emit(locs->buffer, "movl %s, %%eax", a);
+    }
+    else {
+        emit_load(instr->a, "%rax", locs);
+    }
+    if (instr->b.is_imm) {
+        emit_load(instr->b, "%rcx", locs);
+        strcpy(b, narrow ? "%ecx" : "%rcx");
+    }
+    else if (narrow) {
+        format_low_half(instr->b, locs, b, sizeof(b));
+    }
+    else {
+        format_operand(instr->b, locs, b, sizeof(b));
+    }
+    if (narrow) {
+        emit(locs->buffer, "xorl %%edx, %%edx");
+        emit(locs->buffer, "divl %s", b);
+    }
+    else {
+        emit(locs->buffer, "cqto");
+        emit(locs->buffer, "idivq %s", b);
+    }
+}
+
+/*
+ * Prints assembly for a division and a remainder of the same operands with a
+ * single divide instruction, if the second instruction is the other half of
+ * the first and the first does not overwrite the operands. Returns true iff
+ * it did.
+ */
+bool emit_division_pair(ir_instr_t *first, ir_instr_t *second, location_data *locs) {
+    if (!uses_divider(first) || !uses_divider(second) || first->op == second->op ||
+        first->range != second->range || !same_operand(first->a, second->a) ||
+        !same_operand(first->b, second->b) ||
+        same_operand(value_operand(first->dest), first->a) ||
+        same_operand(value_operand(first->dest), first->b)) {
+        return false;
+    }
+    emit_divider(first, locs);
+    ir_instr_t *quotient = first->op == IR_DIV ? first : second;
+    ir_instr_t *remainder = first->op == IR_MOD ? first : second;
+    emit_store("%rax", quotient->dest, locs);
+    emit_store("%rdx", remainder->dest, locs);
+    return true;
+}
+
+/*
+ * Prints assembly for a binary operation, storing the result in its dest.
+ * Multiplication and division by constants are replaced with cheaper
+ * instructions where possible.
+ */
+void emit_binary(ir_instr_t *instr, location_data *locs) {
+    char *dest_reg = locs->regs[instr->dest];
+    if (instr->op == IR_MUL && (instr->a.is_imm || instr->b.is_imm)) {
+        bool left = instr->a.is_imm && !instr->b.is_imm;
+        char *reg = dest_reg != NULL ? dest_reg : "%rax";
+        emit_multiply_by_constant(left ? instr->b : instr->a,
+                                  left ? instr->a.imm : instr->b.imm, reg, locs);
+        emit_store(reg, instr->dest, locs);
+        return;
+    }
+    if (instr->op != IR_DIV && instr->op != IR_MOD) {
+        emit_two_operand(instr, locs);
+        return;
+    }
+    if (uses_divider(instr)) {
+        emit_divider(instr, locs);
+        emit_store(instr->op == IR_DIV ? "%rax" : "%rdx", instr->dest, locs);
+        return;
+    }
+
+    emit_divide_by_constant(instr->a, instr->b.imm, instr->range != RANGE_ANY, locs);
+    if (instr->op == IR_MOD) {
+        // a % b = a - a / b * b
+        if (fits_imm32(instr->b.imm)) {
+            emit(locs->buffer, "imulq $%" PRId64 ", %%rax", instr->b.imm);
+        }
+        else {
+            emit_load(instr->b, "%rcx", locs);
+            emit(locs->buffer, "imulq %%rcx, %%rax");
+        }
+        emit_load(instr->a, "%rdx", locs);
+        emit(locs->buffer, "subq %%rax, %%rdx");
+        emit_store("%rdx", instr->dest, locs);
+        return;
+    }
+    emit_store("%rax", instr->dest, locs);
+}
+
+/*
+ * Prints assembly for an instruction.
+ */
+void emit_instr(ir_instr_t *instr, location_data *locs) {
+    if (instr->op == IR_MOV) {
+        emit_move(instr->a, value_operand(instr->dest), locs);
+    }
+    else if (instr->op == IR_PRINT) {
+        emit_load(instr->a, "%rdi", locs);
+        emit(locs->buffer, "call print_int");
+    }
+    else {
+        emit_binary(instr, locs);
+    }
+}
+
+/*
+ * Prints a comparison of a branch's operands, with a constant operand as an
+ * immediate and a comparison with 0 as a testq. Returns the condition to test
+ * on the flags, which is swapped if the operands had to be swapped.
+ */
+ir_cond_t emit_compare(ir_term_t *term, location_data *locs) {
+    ir_operand_t a = term->a;
+    ir_operand_t b = term->b;
+    ir_cond_t cond = term->cond;
+    if (a.is_imm && !b.is_imm) {
+        a = term->b;
+        b = term->a;
+        cond = swap_cond(cond);
+    }
+    char left[32], right[32];
+    format_operand(a, locs, left, sizeof(left));
+    if (a.is_imm || (in_memory(a, locs) && in_memory(b, locs))) {
+        emit_load(a, "%rax", locs);
+        strcpy(left, "%rax");
+    }
+    else if (b.is_imm && b.imm == 0 && !in_memory(a, locs)) {
+        emit(locs->buffer, "testq %s, %s", left, left);
+        return cond;
+    }
+    format_source(b, "%rcx", locs, right, sizeof(right));
+    emit(locs->buffer, "cmpq %s, %s", right, left);
+    return cond;
+}
+
+/*
+ * Prints assembly for a block's terminator. Jumps to the next block in the
+ * layout fall through, and branches test whichever condition lets one of
+ * their targets fall through.
+ * Returns true iff it jumps to the shared return sequence.
+ */
+bool emit_term(ir_block_t *block, ir_block_t *next, location_data *locs) {
+    ir_term_t *term = &block->term;
+    if (term->kind == TERM_RETURN) {
+        if (next == NULL) {
+            return false;
+        }
+        emit(locs->buffer, "jmp .RETURN");
+        return true;
+    }
+    if (term->kind == TERM_JUMP) {
+        if (term->targets[0] != next) {
+            emit(locs->buffer, "jmp .B%zu", term->targets[0]->id);
+        }
+        return false;
+    }
+
+    ir_cond_t cond = emit_compare(term, locs);
+    if (term->targets[0] == next) {
+        emit(locs->buffer, "j%s .B%zu", CONDS[negate_cond(cond)], term->targets[1]->id);
+    }
+    else {
+        emit(locs->buffer, "j%s .B%zu", CONDS[cond], term->targets[0]->id);
+        if (term->targets[1] != next) {
+            emit(locs->buffer, "jmp .B%zu", term->targets[1]->id);
+        }
+    }
+    return false;
+}
+
+/*
+ * Returns true iff a block can run as conditional moves in place of being
+ * branched to: the block is only reached from branch, continues at join, and
+ * has no instructions that print or divide, which must not run
+ * unconditionally.
+ */
+bool convertible_arm(ir_block_t *arm, ir_block_t *branch, ir_block_t *join) {
+    if (arm->num_preds != 1 || arm->preds[0] != branch || arm->term.kind != TERM_JUMP ||
+        arm->term.targets[0] != join) {
+        return false;
+    }
+    for (size_t j = 0; j < arm->num_instrs; j++) {
+        ir_op_t op = arm->instrs[j].op;
+        if (op != IR_MOV && op != IR_ADD && op != IR_SUB && op != IR_MUL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Returns true iff a branch's condition can be tested again after any of the
+ * instructions in an arm: none of them writes the location of an operand of
+ * the comparison.
+ */
+bool keeps_condition(ir_block_t *arm, ir_term_t *term, location_data *locs) {
+    ir_operand_t operands[2] = {term->a, term->b};
+    for (size_t j = 0; arm != NULL && j < arm->num_instrs; j++) {
+        char dest[32];
+        format_operand(value_operand(arm->instrs[j].dest), locs, dest, sizeof(dest));
+        for (size_t o = 0; o < 2; o++) {
+            char operand[32];
+            format_operand(operands[o], locs, operand, sizeof(operand));
+            if (strcmp(dest, operand) == 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * Returns true iff a branch tests the result of a divide instruction in its
+ * own block. Conditional moves would wait for the slow division, where a
+ * predicted branch lets the code after it start right away.
+ */
+bool tests_division(ir_block_t *block) {
+    for (size_t j = 0; j < block->num_instrs; j++) {
+        ir_instr_t *instr = &block->instrs[j];
+        ir_operand_t result = value_operand(instr->dest);
+        ir_term_t *term = &block->term;
+        if (uses_divider(instr) &&
+            (same_operand(term->a, result) || same_operand(term->b, result))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Returns true iff an arm assigns a value that the first branch after join
+ * tests, as when an IF sets the flag a WHILE loop tests. That branch would
+ * have to wait for the conditional moves, where it could otherwise be
+ * predicted along with the branch they replace.
+ */
+bool feeds_next_branch(ir_block_t *arm, ir_block_t *join) {
+    ir_block_t *decider = join;
+    for (size_t steps = 0; decider->term.kind == TERM_JUMP && steps < 8; steps++) {
+        decider = decider->term.targets[0];
+    }
+    if (arm == NULL || decider->term.kind != TERM_BRANCH) {
+        return false;
+    }
+    for (size_t j = 0; j < arm->num_instrs; j++) {
+        ir_operand_t dest = value_operand(arm->instrs[j].dest);
+        if (same_operand(decider->term.a, dest) || same_operand(decider->term.b, dest)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Decides whether to replace a block's branch by conditional moves. This
+ * applies when the branch's targets are a diamond (two small arms that both
+ * continue at the same block) or a triangle (one small arm that continues at
+ * the other target), as in an IF with short LETs. arms[0] runs when the
+ * branch's condition holds and arms[1] when it does not; either can be NULL.
+ * Returns true iff the branch should be converted, setting the arms and the
+ * block where both paths continue.
+ */
+bool find_conversion(ir_block_t *block, ir_block_t **arms, ir_block_t **join,
+                     location_data *locs) {
+    if (block->term.kind != TERM_BRANCH || tests_division(block)) {
+        return false;
+    }
+    ir_block_t *if_true = block->term.targets[0];
+    ir_block_t *if_false = block->term.targets[1];
+    arms[0] = NULL;
+    arms[1] = NULL;
+    if (if_true->term.kind == TERM_JUMP &&
+        convertible_arm(if_true, block, if_true->term.targets[0]) &&
+        (if_true->term.targets[0] == if_false ||
+         convertible_arm(if_false, block, if_true->term.targets[0]))) {
+        arms[0] = if_true;
+        *join = if_true->term.targets[0];
+        arms[1] = if_false != *join ? if_false : NULL;
+    }
+    else if (if_false->term.kind == TERM_JUMP &&
+             convertible_arm(if_false, block, if_true)) {
+        arms[1] = if_false;
+        *join = if_true;
+    }
+    else {
+        return false;
+    }
+
+    size_t instrs = 0;
+    bool computes = false;
+    for (size_t a = 0; a < 2; a++) {
+        for (size_t j = 0; arms[a] != NULL && j < arms[a]->num_instrs; j++) {
+            // Arithmetic overwrites the flags, so the comparison is repeated
+            // after it, except for the first instruction, computed before it.
+            computes |= instrs > 0 && arms[a]->instrs[j].op != IR_MOV;
+            instrs++;
+        }
+    }
+    return instrs <= MAX_CONVERTED_INSTRS && !feeds_next_branch(arms[0], *join) &&
+           !feeds_next_branch(arms[1], *join) &&
+           (!computes || (keeps_condition(arms[0], &block->term, locs) &&
+                          keeps_condition(arms[1], &block->term, locs)));
+}
+
+/*
+ * Prints assembly computing an addition, subtraction or multiplication in %rdx.
+ */
+void emit_into_rdx(ir_instr_t *instr, location_data *locs) {
+    char b[32];
+    emit_load(instr->a, "%rdx", locs);
+    format_source(instr->b, "%rcx", locs, b, sizeof(b));
+    emit(locs->buffer, "%s %s, %%rdx", OPCODES[instr->op], b);
+}
+
+/*
+ * Prints assembly performing an instruction only if the flags satisfy cond,
+ * which emit_compare() returned for term. The result is computed in %rdx if
+ * the instruction is not a copy (unless it already is) and the comparison
+ * repeated, then it is conditionally moved into place; a dest in a stack slot
+ * is rewritten with either the result or its own contents.
+ */
+void emit_conditional(ir_instr_t *instr, ir_term_t *term, ir_cond_t cond,
+                      bool computed, location_data *locs) {
+    ir_operand_t dest = value_operand(instr->dest);
+    char source[32], to[32];
+    format_operand(instr->a, locs, source, sizeof(source));
+    format_operand(dest, locs, to, sizeof(to));
+    if (instr->op != IR_MOV) {
+        if (!computed) {
+            emit_into_rdx(instr, locs);
+            emit_compare(term, locs);
+        }
+        strcpy(source, "%rdx");
+    }
+    else if (strcmp(source, to) == 0) {
+        return;
+    }
+
+    if (!in_memory(dest, locs)) {
+        if (instr->op == IR_MOV && instr->a.is_imm) {
+            emit_load(instr->a, "%rdx", locs);
+            strcpy(source, "%rdx");
+        }
+        emit(locs->buffer, "cmov%s %s, %s", CONDS[cond], source, to);
+        return;
+    }
+    if (strcmp(source, "%rdx") != 0) {
+        emit(locs->buffer, "movq %s, %%rdx", source);
+    }
+    emit(locs->buffer, "cmov%s %s, %%rdx", CONDS[negate_cond(cond)], to);
+    emit(locs->buffer, "movq %%rdx, %s", to);
+}
+
+/*
+ * Prints the conditional moves replacing a branch to the given arms.
+ */
+void emit_conversion(ir_block_t *block, ir_block_t **arms, location_data *locs) {
+    // The first instruction is computed before the comparison, so the flags
+    // are not overwritten between them.
+    ir_instr_t *first = NULL;
+    for (size_t a = 0; a < 2 && first == NULL; a++) {
+        if (arms[a] != NULL && arms[a]->num_instrs > 0) {
+            first = &arms[a]->instrs[0];
+        }
+    }
+    if (first != NULL && first->op != IR_MOV) {
+        emit_into_rdx(first, locs);
+    }
+    ir_cond_t cond = emit_compare(&block->term, locs);
+    for (size_t a = 0; a < 2; a++) {
+        for (size_t j = 0; arms[a] != NULL && j < arms[a]->num_instrs; j++) {
+            ir_instr_t *instr = &arms[a]->instrs[j];
+            emit_conditional(instr, &block->term, a == 0 ? cond : negate_cond(cond),
+                             instr == first, locs);
+        }
+    }
+}
+
+/*
+ * Returns true iff a block is the target of a jump back from itself or a
+ * block after it in the layout, which makes it the top of a loop.
+ */
+bool is_loop_top(ir_block_t *block) {
+    for (size_t p = 0; p < block->num_preds; p++) {
+        if (block->preds[p]->id >= block->id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void emit_program(ir_program_t *program, asm_buffer_t *buffer) {
+    location_data locs;
+    assign_locations(program, &locs);
+    locs.buffer = buffer;
+    for (uint8_t r = 0; r < FIRST_CALLER_SAVE; r++) {
+        if (locs.saved[r]) {
+            emit(buffer, "pushq %s", REGS[r]);
+        }
+    }
+    if (locs.frame_size > 0) {
+        emit(buffer, "subq $%" PRIu32 ", %%rsp", locs.frame_size);
+    }
+
+    // The arms of converted branches are emitted with the branch instead
+    size_t n = program->num_blocks;
+    bool *skipped = calloc(n, sizeof(bool));
+    assert(skipped != NULL);
+    for (size_t i = 0; i < n; i++) {
+        ir_block_t *arms[2], *join;
+        if (find_conversion(program->blocks[i], arms, &join, &locs)) {
+            for (size_t a = 0; a < 2; a++) {
+                if (arms[a] != NULL) {
+                    skipped[arms[a]->id] = true;
+                }
+            }
+        }
+    }
+
+    bool returns = false;
+    // The block the code emitted so far can continue into without a jump
+    ir_block_t *fallthrough = program->blocks[0];
+    for (size_t i = 0; i < n; i++) {
+        ir_block_t *block = program->blocks[i];
+        if (skipped[i]) {
+            continue;
+        }
+        size_t following = i + 1;
+        while (following < n && skipped[following]) {
+            following++;
+        }
+        ir_block_t *next = following < n ? program->blocks[following] : NULL;
+        // Loop tops are aligned to 16 bytes so each iteration fetches fewer
+        // cache lines, unless the padding would be run on the way in.
+        if (is_loop_top(block) && block != fallthrough) {
+            emit(buffer, ".p2align 4");
+        }
+        if (block->num_preds > 0) {
+            emit(buffer, ".B%zu:", block->id);
+        }
+        for (size_t j = 0; j < block->num_instrs; j++) {
+            if (j + 1 < block->num_instrs &&
+                emit_division_pair(&block->instrs[j], &block->instrs[j + 1], &locs)) {
+                j++;
+                continue;
+            }
+            emit_instr(&block->instrs[j], &locs);
+        }
+        ir_block_t *arms[2], *join;
+        if (find_conversion(block, arms, &join, &locs)) {
+            emit_conversion(block, arms, &locs);
+            if (join != next) {
+                emit(buffer, "jmp .B%zu", join->id);
+            }
+            program->stats.converted_branches++;
+            fallthrough = join == next ? next : NULL;
+            continue;
+        }
+        returns |= emit_term(block, next, &locs);
+        bool continues = false;
+        for (size_t s = 0; s < num_succs(block); s++) {
+            continues |= block->term.targets[s] == next;
+        }
+        fallthrough = continues ? next : NULL;
+    }
+    free(skipped);
+    if (returns) {
+        emit(buffer, ".RETURN:");
+    }
+    if (locs.frame_size > 0) {
+        emit(buffer, "addq $%" PRIu32 ", %%rsp", locs.frame_size);
+    }
+    for (uint8_t r = FIRST_CALLER_SAVE; r > 0; r--) {
+        if (locs.saved[r - 1]) {
+            emit(buffer, "popq %s", REGS[r - 1]);
+        }
+    }
+    emit(buffer, "retq");
+
+    free(locs.regs);
+    free(locs.offsets);
+}
@@ -0,0 +1,506 @@
+#include "passes.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+// The most times the operands of a loop's exit test may wrap around before
+// the search for the loop's trip count gives up
+#define MAX_WRAPS 64
+
+// The length of a stretch of iterations in which a value never wraps around
+#define NEVER_WRAPS ((__int128) 1 << 100)
+
+// A value the loop adds the same amount to once per iteration
+typedef struct {
+    ir_block_t *block;
+    size_t index;
+    // The amount added: a constant or a loop-invariant value
+    ir_operand_t step;
+} recurrence_t;
+
+typedef struct {
+    ir_program_t *program;
+    ir_loop_t *loop;
+    ir_block_t **idom;
+    // The only block in the loop that jumps back to the header
+    ir_block_t *latch;
+    // The block the loop exits to, which only the header jumps to
+    ir_block_t *exit;
+    // Whether each block is part of a loop nested in this one
+    bool *in_inner;
+    // The number of instructions in the loop assigning each value
+    size_t *defs;
+    // The number of times the loop reads each value
+    size_t *uses;
+    // Whether each value is a recurrence, and if so, how it is updated
+    bool *is_recurrence;
+    recurrence_t *recurrences;
+} evolution_data;
+
+/*
+ * Counts a read of an operand if it is a value.
+ */
+void count_loop_use(ir_operand_t operand, evolution_data *data) {
+    if (!operand.is_imm) {
+        data->uses[operand.value]++;
+    }
+}
+
+/*
+ * Counts the assignments and reads of each value in the loop.
+ */
+void count_loop_refs(evolution_data *data) {
+    ir_program_t *program = data->program;
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        if (!data->loop->in_loop[i]) {
+            continue;
+        }
+        for (size_t j = 0; j < block->num_instrs; j++) {
+            ir_instr_t *instr = &block->instrs[j];
+            count_loop_use(instr->a, data);
+            if (is_binary(instr->op)) {
+                count_loop_use(instr->b, data);
+            }
+            if (has_dest(instr)) {
+                data->defs[instr->dest]++;
+            }
+        }
+        if (block->term.kind == TERM_BRANCH) {
+            count_loop_use(block->term.a, data);
+            count_loop_use(block->term.b, data);
+        }
+    }
+}
+
+/*
+ * Returns true iff an operand has the same value on every iteration.
+ */
+bool invariant_operand(ir_operand_t operand, evolution_data *data) {
+    return operand.is_imm || data->defs[operand.value] == 0;
+}
+
+/*
+ * Finds the loop's latch and exit. Returns false unless the loop has a
+ * preheader and a single latch, and can only be left through the header's
+ * branch, to a block that nothing else jumps to.
+ */
+bool find_loop_shape(evolution_data *data) {
+    ir_loop_t *loop = data->loop;
+    ir_block_t *header = loop->header;
+    if (loop->preheader == NULL || header->term.kind != TERM_BRANCH ||
+        loop->in_loop[header->term.targets[0]->id] ==
+            loop->in_loop[header->term.targets[1]->id]) {
+        return false;
+    }
+    bool exits_first = !loop->in_loop[header->term.targets[0]->id];
+    data->exit = header->term.targets[exits_first ? 0 : 1];
+    if (data->exit->num_preds != 1) {
+        return false;
+    }
+    data->latch = NULL;
+    for (size_t p = 0; p < header->num_preds; p++) {
+        if (!loop->in_loop[header->preds[p]->id]) {
+            continue;
+        }
+        if (data->latch != NULL) {
+            return false;
+        }
+        data->latch = header->preds[p];
+    }
+    for (size_t i = 0; i < data->program->num_blocks; i++) {
+        ir_block_t *block = data->program->blocks[i];
+        if (!loop->in_loop[i] || block == header) {
+            continue;
+        }
+        for (size_t s = 0; s < num_succs(block); s++) {
+            if (!loop->in_loop[block->term.targets[s]->id]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * Records the instruction at index in block as a recurrence if it adds a
+ * loop-invariant step to its dest, is the loop's only assignment to it, and
+ * runs exactly once per iteration: after the header's test, in a block every
+ * iteration passes through and outside any inner loop.
+ */
+void find_recurrence(ir_block_t *block, size_t index, evolution_data *data) {
+    ir_instr_t *instr = &block->instrs[index];
+    if (!has_dest(instr) || data->defs[instr->dest] != 1 || block == data->loop->header ||
+        data->in_inner[block->id] || !dominates(data->idom, block, data->latch)) {
+        return;
+    }
+    ir_operand_t self = value_operand(instr->dest);
+    recurrence_t recurrence = {.block = block, .index = index};
+    if (instr->op == IR_ADD && same_operand(instr->a, self) &&
+        invariant_operand(instr->b, data)) {
+        recurrence.step = instr->b;
+    }
+    else if (instr->op == IR_ADD && same_operand(instr->b, self) &&
+             invariant_operand(instr->a, data)) {
+        recurrence.step = instr->a;
+    }
+    else if (instr->op == IR_SUB && same_operand(instr->a, self) && instr->b.is_imm) {
+        recurrence.step = imm_operand((value_t) -(uint64_t) instr->b.imm);
+    }
+    else {
+        return;
+    }
+    data->is_recurrence[instr->dest] = true;
+    data->recurrences[instr->dest] = recurrence;
+}
+
+/*
+ * Finds the constant a value holds on entry to the loop, looking back from
+ * the preheader through blocks with a single predecessor. Returns false if
+ * it is not a known constant.
+ */
+bool entry_constant(size_t value, evolution_data *data, value_t *constant) {
+    ir_block_t *block = data->loop->preheader;
+    for (size_t steps = 0; steps < data->program->num_blocks; steps++) {
+        for (size_t j = block->num_instrs; j > 0; j--) {
+            ir_instr_t *instr = &block->instrs[j - 1];
+            if (!has_dest(instr) || instr->dest != value) {
+                continue;
+            }
+            if (instr->op == IR_MOV && instr->a.is_imm) {
+                *constant = instr->a.imm;
+                return true;
+            }
+            return false;
+        }
+        if (block->num_preds != 1) {
+            return false;
+        }
+        block = block->preds[0];
+    }
+    return false;
+}
+
+/*
+ * Finds the value an operand of the exit test has the first time it is
+ * tested (start) and the constant added to it each iteration (step).
+ * Returns false unless both are known.
+ */
+bool test_evolution(ir_operand_t operand, evolution_data *data, value_t *start,
+                    value_t *step) {
+    *step = 0;
+    if (operand.is_imm) {
+        *start = operand.imm;
+        return true;
+    }
+    size_t value = operand.value;
+    if (data->defs[value] > 0) {
+        if (!data->is_recurrence[value] || !data->recurrences[value].step.is_imm) {
+            return false;
+        }
+        *step = data->recurrences[value].step.imm;
+    }
+    return entry_constant(value, data, start);
+}
+
+/*
+ * Returns the number of iterations before a value starting at start and
+ * growing by step wraps around, or NEVER_WRAPS if the step is 0.
+ */
+__int128 steps_to_wrap(value_t start, value_t step) {
+    if (step > 0) {
+        return ((__int128) INT64_MAX - start) / step + 1;
+    }
+    if (step < 0) {
+        return ((__int128) start - INT64_MIN) / -(__int128) step + 1;
+    }
+    return NEVER_WRAPS;
+}
+
+/*
+ * Returns the inverse of an odd number modulo 2^64. Each Newton step
+ * doubles the number of correct low bits, starting from the 3 that an odd
+ * number is its own inverse in.
+ */
+uint64_t odd_inverse(uint64_t odd) {
+    uint64_t inverse = odd;
+    for (int i = 0; i < 5; i++) {
+        inverse *= 2 - odd * inverse;
+    }
+    return inverse;
+}
+
+/*
+ * Finds the number of times a loop's body runs, given that the loop
+ * continues while `a cond b`, where on the nth test a is a0 + n * sa and b is
+ * b0 + n * sb with wrapping arithmetic. Equality holds exactly when a
+ * congruence modulo 2^64 does. Orderings are decided one stretch of
+ * iterations at a time, in which neither operand wraps around, so their
+ * difference grows linearly. Returns false if the loop never exits or its
+ * operands wrap around too often to tell.
+ */
+bool trip_count(ir_cond_t cond, value_t a0, value_t sa, value_t b0, value_t sb,
+                uint64_t *trips) {
+    uint64_t difference = (uint64_t) a0 - (uint64_t) b0;
+    uint64_t slope = (uint64_t) sa - (uint64_t) sb;
+    if (cond == COND_EQ) {
+        *trips = difference != 0 ? 0 : 1;
+        return difference != 0 || slope != 0;
+    }
+    if (cond == COND_NE) {
+        // Solves difference + n * slope = 0 modulo 2^64 for the least n.
+        if (difference == 0) {
+            *trips = 0;
+            return true;
+        }
+        if (slope == 0 || __builtin_ctzll(difference) < __builtin_ctzll(slope)) {
+            return false;
+        }
+        int shift = __builtin_ctzll(slope);
+        uint64_t n = ((0 - difference) >> shift) * odd_inverse(slope >> shift);
+        *trips = shift == 0 ? n : n & (((uint64_t) 1 << (64 - shift)) - 1);
+        return true;
+    }
+    if (cond == COND_GT || cond == COND_GE) {
+        return trip_count(swap_cond(cond), b0, sb, a0, sa, trips);
+    }
+
+    // a < b is a - b < 0, and a <= b is a - b - 1 < 0.
+    __int128 done = 0;
+    for (size_t wraps = 0; wraps <= MAX_WRAPS; wraps++) {
+        __int128 length = steps_to_wrap(a0, sa);
+        __int128 b_length = steps_to_wrap(b0, sb);
+        length = b_length < length ? b_length : length;
+        __int128 gap = (__int128) a0 - b0 - (cond == COND_LE ? 1 : 0);
+        __int128 growth = (__int128) sa - sb;
+        __int128 exit = -1;
+        if (gap >= 0) {
+            exit = 0;
+        }
+        else if (growth > 0 && (-gap + growth - 1) / growth < length) {
+            exit = (-gap + growth - 1) / growth;
+        }
+        if (exit >= 0) {
+            if (done + exit > UINT64_MAX) {
+                return false;
+            }
+            *trips = (uint64_t) (done + exit);
+            return true;
+        }
+        done += length;
+        if (length == NEVER_WRAPS || done > UINT64_MAX) {
+            return false;
+        }
+        a0 = (value_t) ((uint64_t) a0 + (uint64_t) length * (uint64_t) sa);
+        b0 = (value_t) ((uint64_t) b0 + (uint64_t) length * (uint64_t) sb);
+    }
+    return false;
+}
+
+/*
+ * Inserts `dest = a op b` into a block before the instruction at *index,
+ * advancing *index past it.
+ */
+void insert_evolution(ir_block_t *block, size_t *index, ir_op_t op, size_t dest,
+                      ir_operand_t a, ir_operand_t b) {
+    ir_instr_t instr = {.op = op, .dest = dest, .a = a, .b = b};
+    insert_instr(block, (*index)++, instr);
+}
+
+/*
+ * Replaces a loop whose every instruction is a recurrence, and whose exit
+ * test compares recurrences or invariants with known values, by the final
+ * value of each recurrence, assigned where the loop exits. Returns true iff
+ * it did.
+ */
+bool close_loop(evolution_data *data) {
+    ir_program_t *program = data->program;
+    ir_loop_t *loop = data->loop;
+    ir_block_t *header = loop->header;
+    if (header->num_instrs > 0) {
+        return false;
+    }
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        if (loop->in_loop[i] && data->in_inner[i]) {
+            return false;
+        }
+        for (size_t j = 0; loop->in_loop[i] && j < block->num_instrs; j++) {
+            size_t dest = block->instrs[j].dest;
+            if (!has_dest(&block->instrs[j]) || !data->is_recurrence[dest] ||
+                data->recurrences[dest].block != block ||
+                data->recurrences[dest].index != j) {
+                return false;
+            }
+        }
+    }
+
+    value_t a0, sa, b0, sb;
+    uint64_t trips;
+    bool continues_first = loop->in_loop[header->term.targets[0]->id];
+    ir_cond_t cond = continues_first ? header->term.cond : negate_cond(header->term.cond);
+    if (!test_evolution(header->term.a, data, &a0, &sa) ||
+        !test_evolution(header->term.b, data, &b0, &sb) ||
+        !trip_count(cond, a0, sa, b0, sb, &trips)) {
+        return false;
+    }
+
+    // The temporaries added below are not recurrences
+    size_t num_values = program->num_values;
+    size_t index = 0;
+    for (size_t v = 0; v < num_values; v++) {
+        if (!data->is_recurrence[v] || trips == 0) {
+            continue;
+        }
+        ir_operand_t step = data->recurrences[v].step;
+        value_t start;
+        if (step.is_imm && entry_constant(v, data, &start)) {
+            value_t final = (value_t) ((uint64_t) start + trips * (uint64_t) step.imm);
+            insert_evolution(data->exit, &index, IR_MOV, v, imm_operand(final),
+                             imm_operand(0));
+        }
+        else if (step.is_imm) {
+            value_t total = (value_t) (trips * (uint64_t) step.imm);
+            insert_evolution(data->exit, &index, IR_ADD, v, value_operand(v),
+                             imm_operand(total));
+        }
+        else {
+            size_t total = new_temp(program);
+            insert_evolution(data->exit, &index, IR_MUL, total, step,
+                             imm_operand((value_t) trips));
+            insert_evolution(data->exit, &index, IR_ADD, v, value_operand(v),
+                             value_operand(total));
+        }
+    }
+    loop->preheader->term.targets[0] = data->exit;
+    program->stats.closed_loops++;
+    return true;
+}
+
+/*
+ * Moves a recurrence the loop never reads out of the loop, if another
+ * recurrence the loop keeps, counter, has a constant step that can recover
+ * the number of iterations: after the loop, the recurrence is increased by
+ * (counter - its value on entry) * step / counter's step. The division is
+ * exact modulo 2^64 when counter's step has no more factors of 2 than
+ * the recurrence's. Returns true iff it did.
+ */
+bool close_accumulator(size_t value, evolution_data *data) {
+    ir_program_t *program = data->program;
+    recurrence_t *recurrence = &data->recurrences[value];
+    ir_operand_t step = recurrence->step;
+    for (size_t counter = 0; counter < program->num_values; counter++) {
+        ir_operand_t counter_step = data->recurrences[counter].step;
+        if (counter == value || !data->is_recurrence[counter] ||
+            data->uses[counter] < 2 || !counter_step.is_imm || counter_step.imm == 0) {
+            continue;
+        }
+        int shift = __builtin_ctzll((uint64_t) counter_step.imm);
+        uint64_t inverse = odd_inverse((uint64_t) counter_step.imm >> shift);
+        if ((step.is_imm && (step.imm == 0 || __builtin_ctzll(step.imm) < shift)) ||
+            (!step.is_imm && shift > 0)) {
+            continue;
+        }
+
+        remove_instr(recurrence->block, recurrence->index);
+        size_t start = new_temp(program);
+        ir_block_t *preheader = data->loop->preheader;
+        size_t end = preheader->num_instrs;
+        insert_evolution(preheader, &end, IR_MOV, start, value_operand(counter),
+                         imm_operand(0));
+
+        size_t index = 0;
+        size_t distance = new_temp(program);
+        size_t total = new_temp(program);
+        insert_evolution(data->exit, &index, IR_SUB, distance, value_operand(counter),
+                         value_operand(start));
+        ir_operand_t factor = imm_operand((value_t) ((step.imm >> shift) * inverse));
+        if (!step.is_imm && inverse == 1) {
+            factor = step;
+        }
+        else if (!step.is_imm) {
+            factor = value_operand(new_temp(program));
+            insert_evolution(data->exit, &index, IR_MUL, factor.value, step,
+                             imm_operand((value_t) inverse));
+        }
+        insert_evolution(data->exit, &index, IR_MUL, total, value_operand(distance),
+                         factor);
+        insert_evolution(data->exit, &index, IR_ADD, value, value_operand(value),
+                         value_operand(total));
+        program->stats.closed_accumulators++;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Replaces a loop by the final values of its recurrences if possible, and
+ * otherwise moves the recurrences it never reads out of it. Returns true iff
+ * the program changed.
+ */
+bool evaluate_loop(ir_program_t *program, ir_loop_t *loops, size_t num_loops,
+                   ir_loop_t *loop, ir_block_t **idom) {
+    size_t n = program->num_values;
+    evolution_data data = {.program = program, .loop = loop, .idom = idom};
+    if (!find_loop_shape(&data)) {
+        return false;
+    }
+    data.in_inner = calloc(program->num_blocks, sizeof(bool));
+    data.defs = calloc(n, sizeof(size_t));
+    data.uses = calloc(n, sizeof(size_t));
+    data.is_recurrence = calloc(n, sizeof(bool));
+    data.recurrences = calloc(n, sizeof(recurrence_t));
+    assert(data.in_inner != NULL && data.defs != NULL && data.uses != NULL &&
+           data.is_recurrence != NULL && data.recurrences != NULL);
+    for (size_t l = 0; l < num_loops; l++) {
+        if (&loops[l] == loop || !loop->in_loop[loops[l].header->id]) {
+            continue;
+        }
+        for (size_t i = 0; i < program->num_blocks; i++) {
+            data.in_inner[i] |= loops[l].in_loop[i];
+        }
+    }
+    count_loop_refs(&data);
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        for (size_t j = 0; loop->in_loop[i] && j < block->num_instrs; j++) {
+            find_recurrence(block, j, &data);
+        }
+    }
+
+    bool changed = close_loop(&data);
+    for (size_t v = 0; v < n && !changed; v++) {
+        // A recurrence's own update is its only read in the loop.
+        if (data.is_recurrence[v] && data.uses[v] == 1) {
+            changed = close_accumulator(v, &data);
+        }
+    }
+    free(data.in_inner);
+    free(data.defs);
+    free(data.uses);
+    free(data.is_recurrence);
+    free(data.recurrences);
+    return changed;
+}
+
+void evaluate_loops(ir_program_t *program) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        compute_preds(program);
+        ir_block_t **idom = compute_dominators(program);
+        size_t num_loops;
+        ir_loop_t *loops = find_loops(program, &num_loops);
+
+        // Inner loops go first, so an outer loop can be closed once its inner
+        // loops are gone.
+        for (size_t l = num_loops; l > 0 && !changed; l--) {
+            changed = evaluate_loop(program, loops, num_loops, &loops[l - 1], idom);
+        }
+        free_loops(loops, num_loops);
+        free(idom);
+        if (changed) {
+            remove_unreachable(program);
+        }
+    }
+}
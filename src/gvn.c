@@ -0,0 +1,342 @@
+#include "passes.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    ir_program_t *program;
+    // The number of 64-bit words in each bit vector of values
+    size_t words;
+    // The temporaries whose operation is equal to the current value of its
+    // expression on every path into each block, indexed by block id
+    uint64_t **valid_in;
+    // kills[v] is the set of temporaries whose operation reads the variable
+    // value v, or NULL if there are none
+    uint64_t **kills;
+    // The temporaries assigned by each operation, chained by the hash of the
+    // operation: buckets[hash] is the first, next[temp] the one after it
+    size_t *buckets;
+    size_t num_buckets;
+    size_t *next;
+    // The binary operation assigning each temporary, or NULL
+    ir_instr_t **defs;
+} numbering_data;
+
+// Marks the end of a chain of temporaries
+const size_t NO_TEMP = SIZE_MAX;
+
+/*
+ * Orders the operands of commutative operations, so a + b and b + a are
+ * recognized as the same operation. Immediates go second.
+ */
+void canonicalize(ir_instr_t *instr) {
+    if (instr->op != IR_ADD && instr->op != IR_MUL) {
+        return;
+    }
+    ir_operand_t a = instr->a, b = instr->b;
+    bool swap = a.is_imm ? !b.is_imm || a.imm > b.imm
+                         : !b.is_imm && a.value > b.value;
+    if (swap) {
+        instr->a = b;
+        instr->b = a;
+    }
+}
+
+/*
+ * Hashes an operand into a running hash.
+ */
+size_t hash_operand(size_t hash, ir_operand_t operand) {
+    uint64_t bits = operand.is_imm ? (uint64_t) operand.imm : operand.value;
+    hash = (hash ^ operand.is_imm) * 0x100000001b3;
+    return (hash ^ bits) * 0x100000001b3;
+}
+
+/*
+ * Returns the bucket of the chain holding the operations equal to instr.
+ */
+size_t hash_operation(ir_instr_t *instr, size_t num_buckets) {
+    size_t hash = hash_operand(0xcbf29ce484222325 ^ instr->op, instr->a);
+    return hash_operand(hash, instr->b) % num_buckets;
+}
+
+/*
+ * Returns true iff two operations compute the same function of the same operands.
+ */
+bool same_operation(ir_instr_t *a, ir_instr_t *b) {
+    return a->op == b->op && same_operand(a->a, b->a) && same_operand(a->b, b->b);
+}
+
+/*
+ * Gives every operation assigning a variable a temporary of its own, so an
+ * operation's result survives later assignments to the variable:
+ * V = a op b becomes t = a op b; V = t. Marks the temporaries added in split.
+ */
+void split_operations(ir_program_t *program, bool **split) {
+    size_t num_values = program->num_values;
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        for (size_t j = 0; j < block->num_instrs; j++) {
+            ir_instr_t *instr = &block->instrs[j];
+            if (!is_binary(instr->op) || program->names[instr->dest] == '\0') {
+                continue;
+            }
+            ir_instr_t copy = {.op = IR_MOV, .dest = instr->dest};
+            instr->dest = new_temp(program);
+            copy.a = value_operand(instr->dest);
+            insert_instr(block, j + 1, copy);
+            j++;
+        }
+    }
+    *split = calloc(program->num_values, sizeof(bool));
+    assert(*split != NULL);
+    for (size_t v = num_values; v < program->num_values; v++) {
+        (*split)[v] = true;
+    }
+}
+
+/*
+ * Undoes split_operations() for the operations whose temporary is only read
+ * by the copy into the variable.
+ */
+void join_operations(ir_program_t *program, bool *split) {
+    size_t *uses = calloc(program->num_values, sizeof(size_t));
+    assert(uses != NULL);
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        for (size_t j = 0; j < block->num_instrs; j++) {
+            ir_instr_t *instr = &block->instrs[j];
+            uses[instr->a.value] += !instr->a.is_imm;
+            if (is_binary(instr->op)) {
+                uses[instr->b.value] += !instr->b.is_imm;
+            }
+        }
+        if (block->term.kind == TERM_BRANCH) {
+            uses[block->term.a.value] += !block->term.a.is_imm;
+            uses[block->term.b.value] += !block->term.b.is_imm;
+        }
+    }
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        for (size_t j = block->num_instrs; j > 1; j--) {
+            ir_instr_t *instr = &block->instrs[j - 2];
+            ir_instr_t *copy = &block->instrs[j - 1];
+            if (is_binary(instr->op) && split[instr->dest] && uses[instr->dest] == 1 &&
+                copy->op == IR_MOV && !copy->a.is_imm && copy->a.value == instr->dest) {
+                instr->dest = copy->dest;
+                remove_instr(block, j - 1);
+            }
+        }
+    }
+    free(uses);
+}
+
+/*
+ * Updates the set of valid temporaries across an instruction. An operation's
+ * temporary becomes valid, and assigning a variable invalidates the
+ * temporaries of the operations that read it.
+ */
+void update_valid(ir_instr_t *instr, uint64_t *valid, numbering_data *data) {
+    if (!has_dest(instr)) {
+        return;
+    }
+    uint64_t *kill = data->kills[instr->dest];
+    for (size_t w = 0; kill != NULL && w < data->words; w++) {
+        valid[w] &= ~kill[w];
+    }
+    if (data->defs[instr->dest] != NULL) {
+        set_add(valid, instr->dest);
+    }
+}
+
+/*
+ * Records the operation assigning each temporary and which variables
+ * invalidate it. Every binary operation assigns a temporary after
+ * split_operations().
+ */
+void find_kills(numbering_data *data) {
+    ir_program_t *program = data->program;
+    size_t n = program->num_values;
+    data->defs = calloc(n, sizeof(ir_instr_t *));
+    data->kills = calloc(n, sizeof(uint64_t *));
+    assert(data->defs != NULL && data->kills != NULL);
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        for (size_t j = 0; j < block->num_instrs; j++) {
+            ir_instr_t *instr = &block->instrs[j];
+            if (!is_binary(instr->op)) {
+                continue;
+            }
+            data->defs[instr->dest] = instr;
+            ir_operand_t operands[] = {instr->a, instr->b};
+            for (size_t o = 0; o < 2; o++) {
+                size_t value = operands[o].value;
+                if (operands[o].is_imm || program->names[value] == '\0') {
+                    continue;
+                }
+                if (data->kills[value] == NULL) {
+                    data->kills[value] = calloc(data->words, sizeof(uint64_t));
+                    assert(data->kills[value] != NULL);
+                }
+                set_add(data->kills[value], instr->dest);
+            }
+        }
+    }
+}
+
+/*
+ * Finds the temporaries valid on entry to each block: those assigned on
+ * every path to it with no assignment to their operands since. Since each
+ * temporary is assigned once, a valid temporary's operation dominates the block.
+ */
+void find_valid(numbering_data *data) {
+    ir_program_t *program = data->program;
+    size_t n = program->num_blocks;
+    size_t words = data->words;
+    data->valid_in = malloc(n * sizeof(uint64_t *));
+    assert(data->valid_in != NULL);
+    for (size_t i = 0; i < n; i++) {
+        data->valid_in[i] = malloc(words * sizeof(uint64_t));
+        assert(data->valid_in[i] != NULL);
+        memset(data->valid_in[i], i == 0 ? 0 : 0xff, words * sizeof(uint64_t));
+    }
+
+    // Iterates forwards over the layout until no valid set shrinks.
+    uint64_t *valid = malloc(words * sizeof(uint64_t));
+    assert(valid != NULL);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < n; i++) {
+            ir_block_t *block = program->blocks[i];
+            memcpy(valid, data->valid_in[i], words * sizeof(uint64_t));
+            for (size_t j = 0; j < block->num_instrs; j++) {
+                update_valid(&block->instrs[j], valid, data);
+            }
+            for (size_t s = 0; s < num_succs(block); s++) {
+                uint64_t *succ_in = data->valid_in[block->term.targets[s]->id];
+                for (size_t w = 0; w < words; w++) {
+                    changed |= (succ_in[w] & ~valid[w]) != 0;
+                    succ_in[w] &= valid[w];
+                }
+            }
+        }
+    }
+    free(valid);
+}
+
+/*
+ * Returns a valid temporary holding the same operation as instr,
+ * or NO_TEMP if there is none.
+ */
+size_t find_equal(ir_instr_t *instr, uint64_t *valid, numbering_data *data) {
+    size_t bucket = hash_operation(instr, data->num_buckets);
+    for (size_t t = data->buckets[bucket]; t != NO_TEMP; t = data->next[t]) {
+        if (set_has(valid, t) && same_operation(data->defs[t], instr)) {
+            return t;
+        }
+    }
+    return NO_TEMP;
+}
+
+/*
+ * Replaces an operand reading a temporary that copies an earlier one
+ * with the earlier temporary, so operations on either match.
+ */
+void substitute_leader(ir_operand_t *operand, size_t *leaders) {
+    if (!operand->is_imm) {
+        operand->value = leaders[operand->value];
+    }
+}
+
+/*
+ * Replaces the operations in a block that are equal to a valid temporary with
+ * copies of it, and adds the others to the hash chains.
+ */
+void number_block(ir_block_t *block, size_t *leaders, uint64_t *valid,
+                  numbering_data *data) {
+    memcpy(valid, data->valid_in[block->id], data->words * sizeof(uint64_t));
+    for (size_t j = 0; j < block->num_instrs; j++) {
+        ir_instr_t *instr = &block->instrs[j];
+        if (!is_binary(instr->op)) {
+            update_valid(instr, valid, data);
+            continue;
+        }
+        substitute_leader(&instr->a, leaders);
+        substitute_leader(&instr->b, leaders);
+        canonicalize(instr);
+        size_t equal = find_equal(instr, valid, data);
+        update_valid(instr, valid, data);
+        if (equal != NO_TEMP) {
+            instr->op = IR_MOV;
+            instr->a = value_operand(equal);
+            leaders[instr->dest] = equal;
+            data->program->stats.redundant_ops++;
+        }
+        else {
+            size_t bucket = hash_operation(instr, data->num_buckets);
+            data->next[instr->dest] = data->buckets[bucket];
+            data->buckets[bucket] = instr->dest;
+        }
+    }
+}
+
+void number_values(ir_program_t *program) {
+    compute_preds(program);
+    bool *split;
+    split_operations(program, &split);
+
+    numbering_data data = {.program = program};
+    size_t n = program->num_values;
+    data.words = set_words(n);
+    find_kills(&data);
+    find_valid(&data);
+
+    // Visiting the blocks in reverse postorder sees each temporary's
+    // operation before the operations reading it.
+    size_t num_blocks = program->num_blocks;
+    bool *visited = calloc(num_blocks, sizeof(bool));
+    size_t *order = malloc(num_blocks * sizeof(size_t));
+    size_t count = 0;
+    assert(visited != NULL && order != NULL);
+    postorder(program->blocks[0], visited, order, &count);
+    ir_block_t **blocks = malloc(num_blocks * sizeof(ir_block_t *));
+    data.num_buckets = 2 * n + 1;
+    data.buckets = malloc(data.num_buckets * sizeof(size_t));
+    data.next = malloc(n * sizeof(size_t));
+    size_t *leaders = malloc(n * sizeof(size_t));
+    uint64_t *valid = malloc(data.words * sizeof(uint64_t));
+    assert(blocks != NULL && data.buckets != NULL && data.next != NULL &&
+           leaders != NULL && valid != NULL);
+    for (size_t i = 0; i < num_blocks; i++) {
+        blocks[count - 1 - order[i]] = program->blocks[i];
+    }
+    for (size_t b = 0; b < data.num_buckets; b++) {
+        data.buckets[b] = NO_TEMP;
+    }
+    for (size_t v = 0; v < n; v++) {
+        leaders[v] = v;
+    }
+    for (size_t i = 0; i < count; i++) {
+        number_block(blocks[i], leaders, valid, &data);
+    }
+
+    for (size_t i = 0; i < num_blocks; i++) {
+        free(data.valid_in[i]);
+    }
+    for (size_t v = 0; v < n; v++) {
+        free(data.kills[v]);
+    }
+    free(data.valid_in);
+    free(data.kills);
+    free(data.defs);
+    free(data.buckets);
+    free(data.next);
+    free(visited);
+    free(order);
+    free(blocks);
+    free(leaders);
+    free(valid);
+    join_operations(program, split);
+    free(split);
+}
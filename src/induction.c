@@ -0,0 +1,402 @@
+#include "passes.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The most instructions that may be added to update a reduced product each
+ * time its induction variable is incremented, since they replace one imulq
+ */
+#define MAX_UPDATE_OPS 4
+
+typedef struct {
+    ir_program_t *program;
+    ir_loop_t *loop;
+    // Whether the loop assigns each value
+    bool *defined;
+    // Whether each value is incremented by a constant somewhere in the loop
+    bool *incremented;
+} induction_data;
+
+// A multiplication that depends on the loop only through an induction variable
+typedef struct {
+    ir_block_t *block;
+    size_t index;
+    // The basic induction variable the product depends on
+    size_t iv;
+    // The product is (iv + offsets[0]) * (iv + offsets[1]) if square,
+    // otherwise (iv + offsets[0]) * factor, where factor is loop-invariant
+    bool square;
+    value_t offsets[2];
+    ir_operand_t factor;
+} product_t;
+
+/*
+ * Returns true iff an instruction increments its destination by a constant,
+ * storing the constant in step.
+ */
+bool increment_step(ir_instr_t *instr, value_t *step) {
+    ir_operand_t self = value_operand(instr->dest);
+    if (instr->op == IR_ADD && same_operand(instr->a, self) && instr->b.is_imm) {
+        *step = instr->b.imm;
+        return true;
+    }
+    if (instr->op == IR_ADD && instr->a.is_imm && same_operand(instr->b, self)) {
+        *step = instr->a.imm;
+        return true;
+    }
+    if (instr->op == IR_SUB && same_operand(instr->a, self) && instr->b.is_imm) {
+        *step = (value_t) -(uint64_t) instr->b.imm;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Finds the values the loop assigns, and which of them are basic induction
+ * variables: variables incremented by a constant somewhere in the loop.
+ */
+void find_induction_defs(induction_data *data) {
+    ir_program_t *program = data->program;
+    size_t n = program->num_values;
+    data->defined = calloc(n, sizeof(bool));
+    data->incremented = calloc(n, sizeof(bool));
+    assert(data->defined != NULL && data->incremented != NULL);
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        for (size_t j = 0; data->loop->in_loop[i] && j < block->num_instrs; j++) {
+            ir_instr_t *instr = &block->instrs[j];
+            value_t step;
+            if (!has_dest(instr)) {
+                continue;
+            }
+            data->defined[instr->dest] = true;
+            if (program->names[instr->dest] != '\0' && increment_step(instr, &step)) {
+                data->incremented[instr->dest] = true;
+            }
+        }
+    }
+}
+
+/*
+ * Returns true iff an operand has the same value on every iteration of the loop.
+ */
+bool loop_invariant(ir_operand_t operand, induction_data *data) {
+    return operand.is_imm || !data->defined[operand.value];
+}
+
+/*
+ * Returns true iff an operand read by the instruction at index in a block of
+ * the loop is an induction variable plus a constant: either the variable
+ * itself, or a temporary assigned `iv + c` earlier in the block with no
+ * assignment to iv in between.
+ */
+bool find_affine(ir_operand_t operand, ir_block_t *block, size_t index,
+                 induction_data *data, size_t *iv, value_t *offset) {
+    if (operand.is_imm) {
+        return false;
+    }
+    if (data->incremented[operand.value]) {
+        *iv = operand.value;
+        *offset = 0;
+        return true;
+    }
+    if (data->program->names[operand.value] != '\0') {
+        return false;
+    }
+    size_t def = index;
+    while (def > 0 && block->instrs[def - 1].dest != operand.value) {
+        def--;
+    }
+    if (def == 0) {
+        return false;
+    }
+    ir_instr_t *instr = &block->instrs[def - 1];
+    if (instr->op == IR_ADD && !instr->a.is_imm && instr->b.is_imm) {
+        *offset = instr->b.imm;
+    }
+    else if (instr->op == IR_SUB && !instr->a.is_imm && instr->b.is_imm) {
+        *offset = (value_t) -(uint64_t) instr->b.imm;
+    }
+    else {
+        return false;
+    }
+    *iv = instr->a.value;
+    for (size_t j = def; j < index; j++) {
+        if (has_dest(&block->instrs[j]) && block->instrs[j].dest == *iv) {
+            return false;
+        }
+    }
+    return data->incremented[*iv];
+}
+
+/*
+ * Returns true iff the instruction at index in a block of the loop multiplies
+ * affine functions of an induction variable, or one by a loop-invariant
+ * factor, describing the multiplication in product.
+ */
+bool find_product(ir_block_t *block, size_t index, induction_data *data,
+                  product_t *product) {
+    ir_instr_t *instr = &block->instrs[index];
+    if (instr->op != IR_MUL) {
+        return false;
+    }
+    size_t ivs[2];
+    bool affine[2] = {
+        find_affine(instr->a, block, index, data, &ivs[0], &product->offsets[0]),
+        find_affine(instr->b, block, index, data, &ivs[1], &product->offsets[1]),
+    };
+    product->block = block;
+    product->index = index;
+    product->square = affine[0] && affine[1];
+    if (product->square) {
+        product->iv = ivs[0];
+        return ivs[0] == ivs[1] && instr->dest != ivs[0];
+    }
+    if (affine[0] && loop_invariant(instr->b, data)) {
+        product->iv = ivs[0];
+        product->factor = instr->b;
+    }
+    else if (affine[1] && loop_invariant(instr->a, data)) {
+        product->iv = ivs[1];
+        product->offsets[0] = product->offsets[1];
+        product->factor = instr->a;
+    }
+    else {
+        return false;
+    }
+    return instr->dest != product->iv;
+}
+
+/*
+ * Returns the number of instructions that update a product when its induction
+ * variable is incremented by step.
+ */
+size_t update_ops(product_t *product, value_t step) {
+    if (step == 0) {
+        return 0;
+    }
+    if (!product->square) {
+        return 1;
+    }
+    value_t offsets = (value_t) ((uint64_t) product->offsets[0] + product->offsets[1]);
+    if (step == 1 || step == -1) {
+        // j += step * (iv before + iv after + offsets)
+        return 2 + (offsets != 0);
+    }
+    // j += step * (2 * iv after + offsets - step)
+    return 3 + (offsets != (value_t) step);
+}
+
+/*
+ * Returns true iff maintaining a product alongside its induction variable is
+ * cheaper than computing it. Each increment must run no more often than the
+ * multiplication and add few instructions. Any other assignment to the
+ * induction variable recomputes the product, so it must also run no more
+ * often, and be in a block that neither increments the variable nor
+ * multiplies, like the break out of a loop that resets its counter.
+ */
+bool worth_reducing(product_t *product, induction_data *data) {
+    ir_program_t *program = data->program;
+    bool *increments = calloc(program->num_blocks, sizeof(bool));
+    bool *resets = calloc(program->num_blocks, sizeof(bool));
+    assert(increments != NULL && resets != NULL);
+    bool worth = true;
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        for (size_t j = 0; data->loop->in_loop[i] && j < block->num_instrs; j++) {
+            ir_instr_t *instr = &block->instrs[j];
+            value_t step;
+            if (!has_dest(instr) || instr->dest != product->iv) {
+                continue;
+            }
+            if (increment_step(instr, &step)) {
+                increments[i] = true;
+                worth &= block->weight <= product->block->weight &&
+                         update_ops(product, step) <= MAX_UPDATE_OPS;
+            }
+            else {
+                resets[i] = true;
+                worth &= block->weight <= product->block->weight;
+            }
+        }
+    }
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        worth &= !resets[i] || (!increments[i] && program->blocks[i] != product->block);
+    }
+    free(increments);
+    free(resets);
+    return worth;
+}
+
+/*
+ * Inserts an instruction into a block at index, advancing index past it.
+ */
+void insert_at(ir_block_t *block, size_t *index, ir_instr_t instr) {
+    insert_instr(block, *index, instr);
+    (*index)++;
+}
+
+/*
+ * Inserts `t = value + offset` at index, returning the operand holding the sum.
+ */
+ir_operand_t insert_offset(ir_program_t *program, ir_block_t *block, size_t *index,
+                           size_t value, value_t offset) {
+    if (offset == 0) {
+        return value_operand(value);
+    }
+    ir_instr_t add = {.op = IR_ADD, .dest = new_temp(program)};
+    add.a = value_operand(value);
+    add.b = imm_operand(offset);
+    insert_at(block, index, add);
+    return value_operand(add.dest);
+}
+
+/*
+ * Inserts instructions assigning a product to dest at index.
+ */
+void insert_product(ir_program_t *program, ir_block_t *block, size_t *index,
+                    size_t dest, product_t *product) {
+    ir_instr_t mul = {.op = IR_MUL, .dest = dest};
+    mul.a = insert_offset(program, block, index, product->iv, product->offsets[0]);
+    mul.b = product->square ? insert_offset(program, block, index, product->iv,
+                                            product->offsets[1])
+                            : product->factor;
+    insert_at(block, index, mul);
+}
+
+/*
+ * Updates the product j around the increment of its induction variable by
+ * step at index, leaving index just past the instructions after it. A linear
+ * product grows by step * factor, computed once in the preheader unless it is
+ * constant. A square grows by step * (iv before + iv after + offsets).
+ */
+void insert_update(induction_data *data, ir_block_t *block, size_t *index, value_t step,
+                   size_t j, product_t *product) {
+    ir_program_t *program = data->program;
+    ir_instr_t update = {.op = IR_ADD, .dest = j, .a = value_operand(j)};
+    (*index)++;
+    if (step == 0) {
+        return;
+    }
+    if (!product->square) {
+        if (product->factor.is_imm) {
+            uint64_t delta = (uint64_t) step * product->factor.imm;
+            update.b = imm_operand((value_t) delta);
+        }
+        else {
+            ir_instr_t mul = {.op = IR_MUL, .dest = new_temp(program)};
+            mul.a = product->factor;
+            mul.b = imm_operand(step);
+            add_instr(data->loop->preheader, mul);
+            update.b = value_operand(mul.dest);
+        }
+        insert_at(block, index, update);
+        return;
+    }
+
+    uint64_t offsets = (uint64_t) product->offsets[0] + product->offsets[1];
+    if (step == 1 || step == -1) {
+        update.op = step == 1 ? IR_ADD : IR_SUB;
+        update.b = value_operand(product->iv);
+        insert_instr(block, *index - 1, update);
+        (*index)++;
+        insert_at(block, index, update);
+        if (offsets != 0) {
+            update.op = IR_ADD;
+            update.b = imm_operand((value_t) (step * offsets));
+            insert_at(block, index, update);
+        }
+        return;
+    }
+    ir_instr_t twice = {.op = IR_ADD, .dest = new_temp(program)};
+    twice.a = value_operand(product->iv);
+    twice.b = twice.a;
+    insert_at(block, index, twice);
+    ir_operand_t sum = insert_offset(program, block, index, twice.dest,
+                                     (value_t) (offsets - (uint64_t) step));
+    ir_instr_t scale = {.op = IR_MUL, .dest = new_temp(program)};
+    scale.a = sum;
+    scale.b = imm_operand(step);
+    insert_at(block, index, scale);
+    update.b = value_operand(scale.dest);
+    insert_at(block, index, update);
+}
+
+/*
+ * Replaces a multiplication with a new value j holding the product
+ * throughout the loop: j is computed in the preheader, updated after each
+ * increment of the induction variable, and recomputed after each other
+ * assignment to it.
+ */
+void reduce_product(product_t *product, induction_data *data) {
+    ir_program_t *program = data->program;
+    size_t j = new_var_value(program, program->names[product->iv]);
+    ir_instr_t *instr = &product->block->instrs[product->index];
+    instr->op = IR_MOV;
+    instr->a = value_operand(j);
+
+    ir_block_t *preheader = data->loop->preheader;
+    size_t end = preheader->num_instrs;
+    insert_product(program, preheader, &end, j, product);
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        size_t k = 0;
+        while (data->loop->in_loop[i] && k < block->num_instrs) {
+            ir_instr_t *def = &block->instrs[k];
+            value_t step;
+            if (!has_dest(def) || def->dest != product->iv) {
+                k++;
+            }
+            else if (increment_step(def, &step)) {
+                insert_update(data, block, &k, step, j, product);
+            }
+            else {
+                k++;
+                insert_product(program, block, &k, j, product);
+            }
+        }
+    }
+    program->stats.reduced_products++;
+}
+
+/*
+ * Reduces the products in a loop one at a time, since each adds values.
+ */
+void reduce_loop(ir_program_t *program, ir_loop_t *loop) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        induction_data data = {.program = program, .loop = loop};
+        find_induction_defs(&data);
+        for (size_t i = 0; i < program->num_blocks && !changed; i++) {
+            ir_block_t *block = program->blocks[i];
+            for (size_t j = 0; loop->in_loop[i] && j < block->num_instrs; j++) {
+                product_t product;
+                if (find_product(block, j, &data, &product) &&
+                    worth_reducing(&product, &data)) {
+                    reduce_product(&product, &data);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+        free(data.defined);
+        free(data.incremented);
+    }
+}
+
+void reduce_strength(ir_program_t *program) {
+    compute_preds(program);
+    size_t num_loops;
+    ir_loop_t *loops = find_loops(program, &num_loops);
+
+    // Inner loops go first, so the outer loops see the updates they add.
+    for (size_t l = num_loops; l > 0; l--) {
+        if (loops[l - 1].preheader != NULL) {
+            reduce_loop(program, &loops[l - 1]);
+        }
+    }
+    free_loops(loops, num_loops);
+}
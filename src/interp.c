@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytecode.h"
+#include "parser.h"
+#include "timing.h"
+
+void usage(char *program) {
+    fprintf(stderr, "USAGE: %s [--time] <program file>\n", program);
+    exit(1);
+}
+
+/*
+ * Runs bytecode once with its output discarded.
+ */
+bool run_quietly(void *bytecode) {
+    return run_bytecode(bytecode, false);
+}
+
+/*
+ * Times bytecode with the statistics of runtime/timing.c, so compiled and
+ * interpreted programs can be compared. Returns false if a run traps.
+ */
+bool time_bytecode(bytecode_t *bytecode, char *path) {
+    // The test is named after the program file, without its directory or .bas
+    char *test_name = strrchr(path, '/') == NULL ? path : strrchr(path, '/') + 1;
+    return print_times(test_name, strcspn(test_name, "."), "interpreted duration",
+                       run_quietly, bytecode);
+}
+
+int main(int argc, char *argv[]) {
+    bool time = false;
+    int arg = 1;
+    for (; arg < argc - 1; arg++) {
+        if (strcmp(argv[arg], "--time") == 0) {
+            time = true;
+        }
+        else {
+            usage(argv[0]);
+        }
+    }
+    if (arg != argc - 1) {
+        usage(argv[0]);
+    }
+
+    FILE *program = fopen(argv[arg], "r");
+    if (program == NULL) {
+        usage(argv[0]);
+    }
+
+    node_t *ast = parse(program);
+    fclose(program);
+    if (ast == NULL) {
+        fprintf(stderr, "Parse error\n");
+        return 2;
+    }
+
+    // Translate the AST into bytecode, then run it
+    bytecode_t bytecode;
+    bool lowered = lower_program(ast, &bytecode);
+    free_ast(ast);
+    if (!lowered) {
+        free_bytecode(&bytecode);
+        fprintf(stderr, "Compilation error\n");
+        return 3;
+    }
+    bool ran = time ? time_bytecode(&bytecode, argv[arg]) : run_bytecode(&bytecode, true);
+    free_bytecode(&bytecode);
+    if (!ran) {
+        fprintf(stderr, "Division error\n");
+        return 4;
+    }
+    return 0;
+}
@@ -0,0 +1,653 @@
+#include "ir.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+ir_program_t *init_program(void) {
+    ir_program_t *program = malloc(sizeof(ir_program_t));
+    assert(program != NULL);
+    program->blocks = NULL;
+    program->num_blocks = 0;
+    program->blocks_capacity = 0;
+    program->names = NULL;
+    program->num_values = 0;
+    program->values_capacity = 0;
+    program->stats = (ir_stats_t){0};
+    for (var_name_t name = 'A'; name < 'A' + NUM_VARS; name++) {
+        new_var_value(program, name);
+    }
+    return program;
+}
+
+size_t new_var_value(ir_program_t *program, var_name_t name) {
+    if (program->num_values == program->values_capacity) {
+        program->values_capacity =
+            program->values_capacity == 0 ? 64 : program->values_capacity * 2;
+        program->names =
+            realloc(program->names, program->values_capacity * sizeof(var_name_t));
+        assert(program->names != NULL);
+    }
+    program->names[program->num_values] = name;
+    return program->num_values++;
+}
+
+size_t new_temp(ir_program_t *program) {
+    return new_var_value(program, '\0');
+}
+
+ir_block_t *init_block(uint64_t weight) {
+    ir_block_t *block = malloc(sizeof(ir_block_t));
+    assert(block != NULL);
+    block->id = 0;
+    block->instrs = NULL;
+    block->num_instrs = 0;
+    block->instrs_capacity = 0;
+    block->term.kind = TERM_RETURN;
+    block->term.targets[0] = NULL;
+    block->term.targets[1] = NULL;
+    block->weight = weight;
+    block->preds = NULL;
+    block->num_preds = 0;
+    return block;
+}
+
+void insert_block(ir_program_t *program, size_t index, ir_block_t *block) {
+    assert(index <= program->num_blocks);
+    if (program->num_blocks == program->blocks_capacity) {
+        program->blocks_capacity =
+            program->blocks_capacity == 0 ? 16 : program->blocks_capacity * 2;
+        program->blocks =
+            realloc(program->blocks, program->blocks_capacity * sizeof(ir_block_t *));
+        assert(program->blocks != NULL);
+    }
+    memmove(&program->blocks[index + 1], &program->blocks[index],
+            (program->num_blocks - index) * sizeof(ir_block_t *));
+    program->blocks[index] = block;
+    program->num_blocks++;
+    for (size_t i = index; i < program->num_blocks; i++) {
+        program->blocks[i]->id = i;
+    }
+}
+
+void add_block(ir_program_t *program, ir_block_t *block) {
+    insert_block(program, program->num_blocks, block);
+}
+
+void insert_instr(ir_block_t *block, size_t index, ir_instr_t instr) {
+    assert(index <= block->num_instrs);
+    if (block->num_instrs == block->instrs_capacity) {
+        block->instrs_capacity =
+            block->instrs_capacity == 0 ? 8 : block->instrs_capacity * 2;
+        block->instrs =
+            realloc(block->instrs, block->instrs_capacity * sizeof(ir_instr_t));
+        assert(block->instrs != NULL);
+    }
+    memmove(&block->instrs[index + 1], &block->instrs[index],
+            (block->num_instrs - index) * sizeof(ir_instr_t));
+    block->instrs[index] = instr;
+    block->num_instrs++;
+}
+
+void add_instr(ir_block_t *block, ir_instr_t instr) {
+    insert_instr(block, block->num_instrs, instr);
+}
+
+void remove_instr(ir_block_t *block, size_t index) {
+    assert(index < block->num_instrs);
+    memmove(&block->instrs[index], &block->instrs[index + 1],
+            (block->num_instrs - index - 1) * sizeof(ir_instr_t));
+    block->num_instrs--;
+}
+
+ir_operand_t value_operand(size_t value) {
+    ir_operand_t operand = {.is_imm = false, .value = value, .imm = 0};
+    return operand;
+}
+
+ir_operand_t imm_operand(value_t imm) {
+    ir_operand_t operand = {.is_imm = true, .value = 0, .imm = imm};
+    return operand;
+}
+
+bool same_operand(ir_operand_t a, ir_operand_t b) {
+    if (a.is_imm != b.is_imm) {
+        return false;
+    }
+    return a.is_imm ? a.imm == b.imm : a.value == b.value;
+}
+
+bool has_dest(ir_instr_t *instr) {
+    return instr->op != IR_PRINT;
+}
+
+bool is_binary(ir_op_t op) {
+    return op == IR_ADD || op == IR_SUB || op == IR_MUL || op == IR_DIV || op == IR_MOD;
+}
+
+bool may_trap(ir_instr_t *instr) {
+    if (instr->op != IR_DIV && instr->op != IR_MOD) {
+        return false;
+    }
+    // Only division by 0 and INT64_MIN / -1 trap.
+    return !instr->b.is_imm || instr->b.imm == 0 || instr->b.imm == -1;
+}
+
+size_t num_succs(ir_block_t *block) {
+    if (block->term.kind == TERM_JUMP) {
+        return 1;
+    }
+    if (block->term.kind == TERM_BRANCH) {
+        return 2;
+    }
+    return 0;
+}
+
+bool fold_op(ir_op_t op, value_t a, value_t b, value_t *result) {
+    // Unsigned arithmetic wraps around instead of overflowing.
+    if (op == IR_ADD) {
+        *result = (value_t) ((uint64_t) a + (uint64_t) b);
+    }
+    else if (op == IR_SUB) {
+        *result = (value_t) ((uint64_t) a - (uint64_t) b);
+    }
+    else if (op == IR_MUL) {
+        *result = (value_t) ((uint64_t) a * (uint64_t) b);
+    }
+    else if (op == IR_DIV || op == IR_MOD) {
+        if (b == 0 || (a == INT64_MIN && b == -1)) {
+            return false;
+        }
+        *result = op == IR_DIV ? a / b : a % b;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+ir_op_t ir_op(char op) {
+    if (op == '+') {
+        return IR_ADD;
+    }
+    else if (op == '-') {
+        return IR_SUB;
+    }
+    else if (op == '*') {
+        return IR_MUL;
+    }
+    assert(op == '/');
+    return IR_DIV;
+}
+
+ir_cond_t ir_cond(char op) {
+    if (op == '<') {
+        return COND_LT;
+    }
+    else if (op == '=') {
+        return COND_EQ;
+    }
+    assert(op == '>');
+    return COND_GT;
+}
+
+bool eval_cond(ir_cond_t cond, value_t a, value_t b) {
+    switch (cond) {
+        case COND_LT:
+            return a < b;
+        case COND_EQ:
+            return a == b;
+        case COND_GT:
+            return a > b;
+        case COND_LE:
+            return a <= b;
+        case COND_NE:
+            return a != b;
+        case COND_GE:
+            return a >= b;
+    }
+    assert(false);
+    return false;
+}
+
+ir_cond_t negate_cond(ir_cond_t cond) {
+    return COND_GE - cond;
+}
+
+ir_cond_t swap_cond(ir_cond_t cond) {
+    switch (cond) {
+        case COND_LT:
+            return COND_GT;
+        case COND_GT:
+            return COND_LT;
+        case COND_LE:
+            return COND_GE;
+        case COND_GE:
+            return COND_LE;
+        default:
+            return cond;
+    }
+}
+
+void compute_preds(ir_program_t *program) {
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        block->id = i;
+        block->num_preds = 0;
+    }
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        for (size_t s = 0; s < num_succs(block); s++) {
+            ir_block_t *succ = block->term.targets[s];
+            if (s == 1 && succ == block->term.targets[0]) {
+                continue;
+            }
+            succ->preds =
+                realloc(succ->preds, (succ->num_preds + 1) * sizeof(ir_block_t *));
+            assert(succ->preds != NULL);
+            succ->preds[succ->num_preds++] = block;
+        }
+    }
+}
+
+/*
+ * Marks every block reachable from block.
+ */
+void mark_reachable(ir_block_t *block, bool *reachable) {
+    if (reachable[block->id]) {
+        return;
+    }
+    reachable[block->id] = true;
+    for (size_t s = 0; s < num_succs(block); s++) {
+        mark_reachable(block->term.targets[s], reachable);
+    }
+}
+
+/*
+ * Frees a block.
+ */
+void free_block(ir_block_t *block) {
+    free(block->instrs);
+    free(block->preds);
+    free(block);
+}
+
+void remove_unreachable(ir_program_t *program) {
+    compute_preds(program);
+    bool *reachable = calloc(program->num_blocks, sizeof(bool));
+    assert(reachable != NULL);
+    mark_reachable(program->blocks[0], reachable);
+    size_t kept = 0;
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        if (reachable[i]) {
+            program->blocks[kept++] = program->blocks[i];
+        }
+        else {
+            free_block(program->blocks[i]);
+        }
+    }
+    program->num_blocks = kept;
+    free(reachable);
+    compute_preds(program);
+}
+
+/*
+ * Numbers the blocks reachable from block in postorder.
+ */
+void postorder(ir_block_t *block, bool *visited, size_t *order, size_t *count) {
+    visited[block->id] = true;
+    for (size_t s = num_succs(block); s > 0; s--) {
+        ir_block_t *succ = block->term.targets[s - 1];
+        if (!visited[succ->id]) {
+            postorder(succ, visited, order, count);
+        }
+    }
+    order[block->id] = (*count)++;
+}
+
+/*
+ * Finds the closest common dominator of two blocks, given the dominators
+ * found so far and the postorder numbering.
+ */
+ir_block_t *intersect(ir_block_t **idom, size_t *order, ir_block_t *a, ir_block_t *b) {
+    while (a != b) {
+        while (order[a->id] < order[b->id]) {
+            a = idom[a->id];
+        }
+        while (order[b->id] < order[a->id]) {
+            b = idom[b->id];
+        }
+    }
+    return a;
+}
+
+/*
+ * Uses the iterative algorithm of Cooper, Harvey and Kennedy, which visits
+ * the blocks in reverse postorder until no dominator changes.
+ */
+ir_block_t **compute_dominators(ir_program_t *program) {
+    size_t n = program->num_blocks;
+    ir_block_t **idom = calloc(n, sizeof(ir_block_t *));
+    bool *visited = calloc(n, sizeof(bool));
+    size_t *order = calloc(n, sizeof(size_t));
+    ir_block_t **by_order = calloc(n, sizeof(ir_block_t *));
+    assert(idom != NULL && visited != NULL && order != NULL && by_order != NULL);
+    size_t count = 0;
+    postorder(program->blocks[0], visited, order, &count);
+    for (size_t i = 0; i < n; i++) {
+        if (visited[i]) {
+            by_order[order[i]] = program->blocks[i];
+        }
+    }
+
+    ir_block_t *entry = program->blocks[0];
+    idom[entry->id] = entry;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = count - 1; i-- > 0;) {
+            ir_block_t *block = by_order[i];
+            ir_block_t *new_idom = NULL;
+            for (size_t p = 0; p < block->num_preds; p++) {
+                ir_block_t *pred = block->preds[p];
+                if (idom[pred->id] == NULL) {
+                    continue;
+                }
+                new_idom =
+                    new_idom == NULL ? pred : intersect(idom, order, pred, new_idom);
+            }
+            if (idom[block->id] != new_idom) {
+                idom[block->id] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    free(visited);
+    free(order);
+    free(by_order);
+    return idom;
+}
+
+bool dominates(ir_block_t **idom, ir_block_t *a, ir_block_t *b) {
+    while (true) {
+        if (a == b) {
+            return true;
+        }
+        if (idom[b->id] == NULL || idom[b->id] == b) {
+            return false;
+        }
+        b = idom[b->id];
+    }
+}
+
+/*
+ * Adds block and, transitively, its predecessors to a loop, stopping at
+ * blocks already in the loop (including its header).
+ */
+void add_to_loop(ir_block_t *block, bool *in_loop) {
+    if (in_loop[block->id]) {
+        return;
+    }
+    in_loop[block->id] = true;
+    for (size_t p = 0; p < block->num_preds; p++) {
+        add_to_loop(block->preds[p], in_loop);
+    }
+}
+
+/*
+ * Sorts loops from outermost to innermost.
+ */
+int compare_loops(const void *a, const void *b) {
+    size_t depth_a = ((ir_loop_t *) a)->depth;
+    size_t depth_b = ((ir_loop_t *) b)->depth;
+    return depth_a < depth_b ? -1 : depth_a > depth_b ? 1 : 0;
+}
+
+ir_loop_t *find_loops(ir_program_t *program, size_t *num_loops) {
+    size_t n = program->num_blocks;
+    ir_block_t **idom = compute_dominators(program);
+    ir_loop_t *loops = NULL;
+    *num_loops = 0;
+
+    // Each header of a back edge, an edge to a dominating block, starts a loop.
+    for (size_t h = 0; h < n; h++) {
+        ir_block_t *header = program->blocks[h];
+        bool *in_loop = NULL;
+        for (size_t p = 0; p < header->num_preds; p++) {
+            ir_block_t *latch = header->preds[p];
+            if (idom[latch->id] == NULL || !dominates(idom, header, latch)) {
+                continue;
+            }
+            if (in_loop == NULL) {
+                in_loop = calloc(n, sizeof(bool));
+                assert(in_loop != NULL);
+                in_loop[header->id] = true;
+            }
+            add_to_loop(latch, in_loop);
+        }
+        if (in_loop == NULL) {
+            continue;
+        }
+
+        ir_block_t *preheader = NULL;
+        size_t outside_preds = 0;
+        for (size_t p = 0; p < header->num_preds; p++) {
+            if (!in_loop[header->preds[p]->id]) {
+                preheader = header->preds[p];
+                outside_preds++;
+            }
+        }
+        if (outside_preds != 1 || num_succs(preheader) != 1) {
+            preheader = NULL;
+        }
+
+        loops = realloc(loops, (*num_loops + 1) * sizeof(ir_loop_t));
+        assert(loops != NULL);
+        loops[*num_loops].header = header;
+        loops[*num_loops].preheader = preheader;
+        loops[*num_loops].in_loop = in_loop;
+        loops[*num_loops].depth = 0;
+        (*num_loops)++;
+    }
+
+    for (size_t i = 0; i < *num_loops; i++) {
+        for (size_t j = 0; j < *num_loops; j++) {
+            if (i != j && loops[j].in_loop[loops[i].header->id]) {
+                loops[i].depth++;
+            }
+        }
+    }
+    qsort(loops, *num_loops, sizeof(ir_loop_t), compare_loops);
+    free(idom);
+    return loops;
+}
+
+void free_loops(ir_loop_t *loops, size_t num_loops) {
+    for (size_t i = 0; i < num_loops; i++) {
+        free(loops[i].in_loop);
+    }
+    free(loops);
+}
+
+size_t set_words(size_t n) {
+    return (n + 63) / 64;
+}
+
+bool set_has(uint64_t *set, size_t value) {
+    return (set[value / 64] >> (value % 64)) & 1;
+}
+
+void set_add(uint64_t *set, size_t value) {
+    set[value / 64] |= (uint64_t) 1 << (value % 64);
+}
+
+void set_remove(uint64_t *set, size_t value) {
+    set[value / 64] &= ~((uint64_t) 1 << (value % 64));
+}
+
+/*
+ * Updates a live set for an operand being read.
+ */
+void use_operand(ir_operand_t operand, uint64_t *live) {
+    if (!operand.is_imm) {
+        set_add(live, operand.value);
+    }
+}
+
+/*
+ * Computes the values live on entry to a block from those live on exit,
+ * walking its instructions backwards.
+ */
+void live_through_block(ir_block_t *block, uint64_t *live) {
+    if (block->term.kind == TERM_BRANCH) {
+        use_operand(block->term.a, live);
+        use_operand(block->term.b, live);
+    }
+    for (size_t i = block->num_instrs; i > 0; i--) {
+        ir_instr_t *instr = &block->instrs[i - 1];
+        if (has_dest(instr)) {
+            set_remove(live, instr->dest);
+        }
+        use_operand(instr->a, live);
+        if (is_binary(instr->op)) {
+            use_operand(instr->b, live);
+        }
+    }
+}
+
+ir_liveness_t *compute_liveness(ir_program_t *program) {
+    ir_liveness_t *liveness = malloc(sizeof(ir_liveness_t));
+    assert(liveness != NULL);
+    size_t words = set_words(program->num_values);
+    size_t n = program->num_blocks;
+    liveness->words = words;
+    liveness->num_blocks = n;
+    liveness->live_in = malloc(n * sizeof(uint64_t *));
+    liveness->live_out = malloc(n * sizeof(uint64_t *));
+    assert(liveness->live_in != NULL && liveness->live_out != NULL);
+    for (size_t i = 0; i < n; i++) {
+        liveness->live_in[i] = calloc(words, sizeof(uint64_t));
+        liveness->live_out[i] = calloc(words, sizeof(uint64_t));
+        assert(liveness->live_in[i] != NULL && liveness->live_out[i] != NULL);
+    }
+
+    // Iterates backwards over the layout until no live set grows.
+    uint64_t *live = malloc(words * sizeof(uint64_t));
+    assert(live != NULL);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = n; i > 0; i--) {
+            ir_block_t *block = program->blocks[i - 1];
+            uint64_t *live_out = liveness->live_out[block->id];
+            for (size_t s = 0; s < num_succs(block); s++) {
+                uint64_t *succ_in = liveness->live_in[block->term.targets[s]->id];
+                for (size_t w = 0; w < words; w++) {
+                    live_out[w] |= succ_in[w];
+                }
+            }
+            memcpy(live, live_out, words * sizeof(uint64_t));
+            live_through_block(block, live);
+            uint64_t *live_in = liveness->live_in[block->id];
+            if (memcmp(live, live_in, words * sizeof(uint64_t)) != 0) {
+                memcpy(live_in, live, words * sizeof(uint64_t));
+                changed = true;
+            }
+        }
+    }
+    free(live);
+    return liveness;
+}
+
+void free_liveness(ir_liveness_t *liveness) {
+    for (size_t i = 0; i < liveness->num_blocks; i++) {
+        free(liveness->live_in[i]);
+        free(liveness->live_out[i]);
+    }
+    free(liveness->live_in);
+    free(liveness->live_out);
+    free(liveness);
+}
+
+/*
+ * Prints an operand: a constant, a variable, or a temporary.
+ * Copies of a variable other than the original are suffixed with their number.
+ */
+void print_operand(ir_program_t *program, ir_operand_t operand, FILE *stream) {
+    if (operand.is_imm) {
+        fprintf(stream, "%" PRId64, operand.imm);
+    }
+    else if (operand.value < NUM_VARS) {
+        fprintf(stream, "%c", program->names[operand.value]);
+    }
+    else if (program->names[operand.value] != '\0') {
+        fprintf(stream, "%c.%zu", program->names[operand.value], operand.value);
+    }
+    else {
+        fprintf(stream, "t%zu", operand.value);
+    }
+}
+
+void print_ir(ir_program_t *program, FILE *stream) {
+    static const char *const OPS[] = {"", "+", "-", "*", "/", "%", ""};
+    static const char *const CONDS[] = {"<", "=", ">", "<=", "<>", ">="};
+    static const char *const RANGES[] = {"", " # non-negative", " # 32-bit"};
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        fprintf(stream, "B%zu:", block->id);
+        fprintf(stream, " # weight %" PRIu64, block->weight);
+        if (block->num_preds > 0) {
+            fprintf(stream, ", preds");
+            for (size_t p = 0; p < block->num_preds; p++) {
+                fprintf(stream, " B%zu", block->preds[p]->id);
+            }
+        }
+        fprintf(stream, "\n");
+
+        for (size_t j = 0; j < block->num_instrs; j++) {
+            ir_instr_t *instr = &block->instrs[j];
+            fprintf(stream, "    ");
+            if (instr->op == IR_PRINT) {
+                fprintf(stream, "print ");
+                print_operand(program, instr->a, stream);
+                fprintf(stream, "\n");
+                continue;
+            }
+            print_operand(program, value_operand(instr->dest), stream);
+            fprintf(stream, " = ");
+            print_operand(program, instr->a, stream);
+            if (is_binary(instr->op)) {
+                fprintf(stream, " %s ", OPS[instr->op]);
+                print_operand(program, instr->b, stream);
+            }
+            fprintf(stream, "%s\n", RANGES[instr->range]);
+        }
+
+        ir_term_t *term = &block->term;
+        if (term->kind == TERM_JUMP) {
+            fprintf(stream, "    jump B%zu\n", term->targets[0]->id);
+        }
+        else if (term->kind == TERM_BRANCH) {
+            fprintf(stream, "    if ");
+            print_operand(program, term->a, stream);
+            fprintf(stream, " %s ", CONDS[term->cond]);
+            print_operand(program, term->b, stream);
+            fprintf(stream, " then B%zu else B%zu\n", term->targets[0]->id,
+                    term->targets[1]->id);
+        }
+        else {
+            fprintf(stream, "    return\n");
+        }
+    }
+}
+
+void free_program(ir_program_t *program) {
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        free_block(program->blocks[i]);
+    }
+    free(program->blocks);
+    free(program->names);
+    free(program);
+}
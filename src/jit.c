@@ -0,0 +1,196 @@
+#include "jit.h"
+
+#include <inttypes.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../runtime/print_format.h"
+#include "object.h"
+#include "timing.h"
+
+// jmp *0(%rip): jumps to the 64-bit address stored right after the instruction.
+// Calls to the runtime go through one of these, since the executable memory
+// may be too far from the compiler's code for a 32-bit displacement.
+const uint8_t ABSOLUTE_JUMP[] = {0xFF, 0x25, 0x00, 0x00, 0x00, 0x00};
+// The size of a jump to a runtime function together with its address
+#define STUB_SIZE (sizeof(ABSOLUTE_JUMP) + sizeof(uint64_t))
+
+// When the program first printed, if it has
+struct timespec first_output_time;
+bool has_printed = false;
+
+/*
+ * Notes the time of the program's first output.
+ */
+void note_output(void) {
+    if (!has_printed) {
+        clock_gettime(CLOCK_MONOTONIC, &first_output_time);
+        has_printed = true;
+    }
+}
+
+/*
+ * The print_int that compiled code running in the compiler calls.
+ * Like the runtimes', it overwrites the caller-save registers.
+ */
+void run_print_int(value_t value) {
+    note_output();
+    printf("%" PRId64 "\n", value);
+    clobber_caller_saves();
+}
+
+/*
+ * The print_output that compiled code running in the compiler calls.
+ */
+void run_print_output(const char *text, size_t length) {
+    note_output();
+    fwrite(text, 1, length, stdout);
+}
+
+// A function compiled code can call, and the name it calls it by
+typedef struct {
+    char *name;
+    void *address;
+} runtime_function_t;
+
+const runtime_function_t RUNTIME_FUNCTIONS[] = {
+    {"print_int", (void *) run_print_int},
+    {"print_output", (void *) run_print_output},
+};
+#define NUM_RUNTIME_FUNCTIONS (sizeof(RUNTIME_FUNCTIONS) / sizeof(RUNTIME_FUNCTIONS[0]))
+
+/*
+ * Calls basic_main with canary values in the callee-save registers, as
+ * runtime/call_check.inc does, and returns whether they are unchanged after.
+ */
+bool call_checked(void (*basic_main)(void));
+asm(".text\n"
+    ".globl call_checked\n"
+    "call_checked:\n"
+    "    pushq %rbx\n"
+    "    pushq %rbp\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    // Keep the stack 16-byte aligned at the call
+    "    subq $8, %rsp\n"
+    "    movq $0xB42607DE9FA358C1, %rbx\n"
+    "    movq $0x412087E6FAB9C53D, %rbp\n"
+    "    movq $0x514D387C6AE02B9F, %r12\n"
+    "    movq $0xE5BF4238C1DA9760, %r13\n"
+    "    movq $0xCB9FD8524A630E71, %r14\n"
+    "    movq $0xD0B5F947CEA23618, %r15\n"
+    "    call *%rdi\n"
+    "    xorl %eax, %eax\n"
+    "    movq $0xB42607DE9FA358C1, %rcx\n"
+    "    cmpq %rcx, %rbx\n"
+    "    jne 1f\n"
+    "    movq $0x412087E6FAB9C53D, %rcx\n"
+    "    cmpq %rcx, %rbp\n"
+    "    jne 1f\n"
+    "    movq $0x514D387C6AE02B9F, %rcx\n"
+    "    cmpq %rcx, %r12\n"
+    "    jne 1f\n"
+    "    movq $0xE5BF4238C1DA9760, %rcx\n"
+    "    cmpq %rcx, %r13\n"
+    "    jne 1f\n"
+    "    movq $0xCB9FD8524A630E71, %rcx\n"
+    "    cmpq %rcx, %r14\n"
+    "    jne 1f\n"
+    "    movq $0xD0B5F947CEA23618, %rcx\n"
+    "    cmpq %rcx, %r15\n"
+    "    jne 1f\n"
+    "    movl $1, %eax\n"
+    "1:\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbp\n"
+    "    popq %rbx\n"
+    "    ret\n");
+
+/*
+ * Copies machine code into memory at base, followed by a jump to each runtime
+ * function and the precomputed output, and fills in the code's relocations.
+ * Returns false if the code refers to a symbol that is not among them.
+ */
+bool link_code(uint8_t *base, machine_code_t *code, output_t *output) {
+    memcpy(base, code->bytes, code->length);
+    uint8_t *stubs = base + code->length;
+    for (size_t f = 0; f < NUM_RUNTIME_FUNCTIONS; f++) {
+        uint64_t address = (uint64_t) RUNTIME_FUNCTIONS[f].address;
+        memcpy(stubs + f * STUB_SIZE, ABSOLUTE_JUMP, sizeof(ABSOLUTE_JUMP));
+        memcpy(stubs + f * STUB_SIZE + sizeof(ABSOLUTE_JUMP), &address, sizeof(address));
+    }
+    uint8_t *data = stubs + NUM_RUNTIME_FUNCTIONS * STUB_SIZE;
+    if (output->length > 0) {
+        memcpy(data, output->text, output->length);
+    }
+
+    for (size_t r = 0; r < code->num_relocs; r++) {
+        reloc_t *reloc = &code->relocs[r];
+        uint8_t *target = NULL;
+        if (strcmp(reloc->name, OUTPUT_LABEL) == 0) {
+            target = data;
+        }
+        for (size_t f = 0; f < NUM_RUNTIME_FUNCTIONS && target == NULL; f++) {
+            if (strcmp(reloc->name, RUNTIME_FUNCTIONS[f].name) == 0) {
+                target = stubs + f * STUB_SIZE;
+            }
+        }
+        if (target == NULL) {
+            return false;
+        }
+        // Everything is within one mapping, so the displacement fits in 32 bits
+        int32_t displacement = target + reloc->addend - (base + reloc->offset);
+        memcpy(base + reloc->offset, &displacement, sizeof(displacement));
+    }
+    return true;
+}
+
+run_status_t run_code(asm_buffer_t *code, output_t *output, struct timespec *start,
+                      bool print_stats) {
+    machine_code_t machine_code;
+    if (!assemble_buffer(code, &machine_code)) {
+        free_machine_code(&machine_code);
+        return RUN_ENCODING_ERROR;
+    }
+
+    // The memory is writable while the code is linked into it, then executable
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t size =
+        machine_code.length + NUM_RUNTIME_FUNCTIONS * STUB_SIZE + output->length;
+    size = (size + page_size - 1) / page_size * page_size;
+    uint8_t *memory =
+        mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        free_machine_code(&machine_code);
+        return RUN_ENCODING_ERROR;
+    }
+    bool linked = link_code(memory, &machine_code, output);
+    free_machine_code(&machine_code);
+    if (!linked || mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return RUN_ENCODING_ERROR;
+    }
+
+    struct timespec ready;
+    clock_gettime(CLOCK_MONOTONIC, &ready);
+    bool preserved = call_checked((void (*)(void)) memory);
+    fflush(stdout);
+    munmap(memory, size);
+
+    if (print_stats) {
+        fprintf(stderr, "seconds from start to running machine code: %e\n",
+                seconds_between(start, &ready));
+        if (has_printed) {
+            fprintf(stderr, "seconds from start to first output: %e\n",
+                    seconds_between(start, &first_output_time));
+        }
+    }
+    return preserved ? RUN_OK : RUN_CONVENTION_VIOLATED;
+}
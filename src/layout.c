@@ -0,0 +1,174 @@
+#include "passes.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+/*
+ * Returns the block that control reaching block continues to after passing
+ * through any empty blocks that only jump onward. A cycle of empty blocks
+ * is left alone.
+ */
+ir_block_t *thread_target(ir_block_t *block, size_t num_blocks) {
+    ir_block_t *target = block;
+    for (size_t steps = 0; steps < num_blocks; steps++) {
+        if (target->num_instrs > 0 || target->term.kind != TERM_JUMP) {
+            return target;
+        }
+        target = target->term.targets[0];
+    }
+    return block;
+}
+
+/*
+ * Replaces a branch by a jump if it continues at the same block either way or
+ * compares two constants. Returns true iff it did.
+ */
+bool fold_branch(ir_block_t *block) {
+    ir_term_t *term = &block->term;
+    if (term->kind != TERM_BRANCH) {
+        return false;
+    }
+    if (term->targets[0] != term->targets[1] && !(term->a.is_imm && term->b.is_imm)) {
+        return false;
+    }
+    if (term->targets[0] != term->targets[1] &&
+        !eval_cond(term->cond, term->a.imm, term->b.imm)) {
+        term->targets[0] = term->targets[1];
+    }
+    term->kind = TERM_JUMP;
+    return true;
+}
+
+/*
+ * Retargets every jump and branch to an empty block at the block it leads
+ * to, and folds branches whose outcome is known.
+ * Returns true iff anything changed.
+ */
+bool thread_jumps(ir_program_t *program) {
+    bool changed = false;
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        for (size_t s = 0; s < num_succs(block); s++) {
+            ir_block_t **target = &block->term.targets[s];
+            ir_block_t *threaded = thread_target(*target, program->num_blocks);
+            if (threaded != *target) {
+                *target = threaded;
+                program->stats.threaded_jumps++;
+                changed = true;
+            }
+        }
+        changed |= fold_branch(block);
+    }
+    return changed;
+}
+
+/*
+ * Appends each block that is only reached by a jump from the block before it
+ * in the control flow to that block. Returns true iff any blocks merged.
+ */
+bool merge_blocks(ir_program_t *program) {
+    bool changed = false;
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        if (i > 0 && block->num_preds == 0) {
+            continue;
+        }
+        while (block->term.kind == TERM_JUMP) {
+            ir_block_t *succ = block->term.targets[0];
+            if (succ == block || succ == program->blocks[0] || succ->num_preds != 1) {
+                break;
+            }
+            for (size_t j = 0; j < succ->num_instrs; j++) {
+                add_instr(block, succ->instrs[j]);
+            }
+            block->term = succ->term;
+            // The merged block is now unreachable, but must not be merged
+            // into another one before it is removed.
+            succ->num_preds = 0;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/*
+ * Returns true iff a block prints.
+ */
+bool block_prints(ir_block_t *block) {
+    for (size_t j = 0; j < block->num_instrs; j++) {
+        if (block->instrs[j].op == IR_PRINT) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Returns true iff a block is unlikely to run each time the branch before it
+ * does, so it belongs out of line: it is a loop's IF branch that prints,
+ * where the other way does not. Printing is rare in a hot loop and costs far
+ * more than the jumps to and from the block.
+ */
+bool is_cold(ir_block_t *block, bool *in_loop) {
+    if (block->num_preds != 1 || block->term.kind != TERM_JUMP || !block_prints(block)) {
+        return false;
+    }
+    ir_block_t *branch = block->preds[0];
+    if (!in_loop[branch->id] || branch->term.kind != TERM_BRANCH) {
+        return false;
+    }
+    ir_block_t **targets = branch->term.targets;
+    return !block_prints(targets[0] == block ? targets[1] : targets[0]);
+}
+
+/*
+ * Moves the cold blocks to the end of the layout, keeping the others in
+ * order, so the code of a loop's common path is contiguous.
+ */
+void move_cold_blocks(ir_program_t *program) {
+    size_t n = program->num_blocks;
+    size_t num_loops;
+    ir_loop_t *loops = find_loops(program, &num_loops);
+    bool *in_loop = calloc(n, sizeof(bool));
+    bool *cold = calloc(n, sizeof(bool));
+    ir_block_t **layout = malloc(n * sizeof(ir_block_t *));
+    assert(in_loop != NULL && cold != NULL && layout != NULL);
+    for (size_t l = 0; l < num_loops; l++) {
+        for (size_t i = 0; i < n; i++) {
+            in_loop[i] |= loops[l].in_loop[i];
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        cold[i] = is_cold(program->blocks[i], in_loop);
+    }
+
+    size_t placed = 0;
+    for (size_t pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < n; i++) {
+            if (cold[i] == (pass == 1)) {
+                layout[placed++] = program->blocks[i];
+            }
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        program->stats.cold_blocks += cold[i];
+        program->blocks[i] = layout[i];
+    }
+    compute_preds(program);
+    free(layout);
+    free(cold);
+    free(in_loop);
+    free_loops(loops, num_loops);
+}
+
+void lay_out_blocks(ir_program_t *program) {
+    bool changed = true;
+    while (changed) {
+        compute_preds(program);
+        changed = thread_jumps(program);
+        remove_unreachable(program);
+        changed |= merge_blocks(program);
+        remove_unreachable(program);
+    }
+    move_cold_blocks(program);
+}
@@ -0,0 +1,252 @@
+#include "passes.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The number of instructions unswitching may add to a program in total,
+ * since each unswitched loop is duplicated.
+ */
+#define UNSWITCH_BUDGET 256
+
+/*
+ * Marks the values assigned by instructions inside a loop.
+ */
+void find_loop_defs(ir_program_t *program, ir_loop_t *loop, bool *defined) {
+    memset(defined, false, program->num_values * sizeof(bool));
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        for (size_t j = 0; loop->in_loop[i] && j < block->num_instrs; j++) {
+            if (has_dest(&block->instrs[j])) {
+                defined[block->instrs[j].dest] = true;
+            }
+        }
+    }
+}
+
+/*
+ * Returns true iff an operand has the same value on every iteration of a loop,
+ * given the values the loop assigns.
+ */
+bool is_invariant(ir_operand_t operand, bool *defined) {
+    return operand.is_imm || !defined[operand.value];
+}
+
+/*
+ * Moves the invariant operations in a loop to the end of its preheader.
+ * Operations that can trap stay put, since the loop might not run them.
+ * An invariant operation assigning a variable leaves behind a copy of the
+ * hoisted result, since the variable may be read before it in the loop.
+ */
+void hoist_loop(ir_program_t *program, ir_loop_t *loop, bool *defined) {
+    find_loop_defs(program, loop, defined);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < program->num_blocks; i++) {
+            ir_block_t *block = program->blocks[i];
+            for (size_t j = 0; loop->in_loop[i] && j < block->num_instrs; j++) {
+                // Only operations are tested for invariance, since the copies
+                // left behind read temporaries newer than defined
+                ir_instr_t *instr = &block->instrs[j];
+                if (!is_binary(instr->op) || may_trap(instr) ||
+                    !is_invariant(instr->a, defined) ||
+                    !is_invariant(instr->b, defined)) {
+                    continue;
+                }
+                ir_instr_t hoist = *instr;
+                if (program->names[instr->dest] == '\0') {
+                    remove_instr(block, j);
+                    j--;
+                    defined[hoist.dest] = false;
+                }
+                else {
+                    hoist.dest = new_temp(program);
+                    instr->op = IR_MOV;
+                    instr->a = value_operand(hoist.dest);
+                }
+                add_instr(loop->preheader, hoist);
+                changed = true;
+            }
+        }
+    }
+}
+
+void hoist_invariants(ir_program_t *program) {
+    compute_preds(program);
+    size_t num_loops;
+    ir_loop_t *loops = find_loops(program, &num_loops);
+
+    // Inner loops go first, so their invariants can keep moving outwards.
+    for (size_t l = num_loops; l > 0; l--) {
+        if (loops[l - 1].preheader == NULL) {
+            continue;
+        }
+        bool *defined = malloc(program->num_values * sizeof(bool));
+        assert(defined != NULL);
+        hoist_loop(program, &loops[l - 1], defined);
+        free(defined);
+    }
+    free_loops(loops, num_loops);
+}
+
+/*
+ * Returns the number of instructions in a loop.
+ */
+size_t loop_size(ir_program_t *program, ir_loop_t *loop) {
+    size_t size = 0;
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        if (loop->in_loop[i]) {
+            size += program->blocks[i]->num_instrs + 1;
+        }
+    }
+    return size;
+}
+
+/*
+ * Finds a block in a loop ending with a branch between two blocks of the loop
+ * whose condition has the same value on every iteration, or returns NULL.
+ */
+ir_block_t *find_invariant_branch(ir_program_t *program, ir_loop_t *loop,
+                                  bool *defined) {
+    find_loop_defs(program, loop, defined);
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        ir_term_t *term = &block->term;
+        if (loop->in_loop[i] && term->kind == TERM_BRANCH &&
+            loop->in_loop[term->targets[0]->id] && loop->in_loop[term->targets[1]->id] &&
+            is_invariant(term->a, defined) && is_invariant(term->b, defined)) {
+            return block;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Returns the value a cloned operand reads.
+ */
+ir_operand_t clone_operand(ir_operand_t operand, size_t *renamed) {
+    if (!operand.is_imm) {
+        operand.value = renamed[operand.value];
+    }
+    return operand;
+}
+
+/*
+ * Duplicates a loop so the copy runs when a branch's invariant condition is
+ * false and the original runs when it is true. The preheader tests the
+ * condition once, and each copy's branch becomes a jump to the side it takes.
+ * The temporaries assigned in the copy are renamed to keep them single-assignment.
+ */
+void unswitch_loop(ir_program_t *program, ir_loop_t *loop, ir_block_t *branch) {
+    size_t n = program->num_blocks;
+    size_t num_values = program->num_values;
+    ir_block_t **clones = calloc(n, sizeof(ir_block_t *));
+    size_t *renamed = malloc(num_values * sizeof(size_t));
+    assert(clones != NULL && renamed != NULL);
+    for (size_t v = 0; v < num_values; v++) {
+        renamed[v] = v;
+    }
+
+    size_t first = n;
+    for (size_t i = 0; i < n; i++) {
+        ir_block_t *block = program->blocks[i];
+        if (!loop->in_loop[i]) {
+            continue;
+        }
+        first = first < i ? first : i;
+        clones[i] = init_block(block->weight);
+        for (size_t j = 0; j < block->num_instrs; j++) {
+            ir_instr_t *instr = &block->instrs[j];
+            if (has_dest(instr) && program->names[instr->dest] == '\0') {
+                renamed[instr->dest] = new_temp(program);
+            }
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        ir_block_t *block = program->blocks[i];
+        ir_block_t *clone = clones[i];
+        if (clone == NULL) {
+            continue;
+        }
+        for (size_t j = 0; j < block->num_instrs; j++) {
+            ir_instr_t instr = block->instrs[j];
+            if (has_dest(&instr)) {
+                instr.dest = renamed[instr.dest];
+            }
+            instr.a = clone_operand(instr.a, renamed);
+            if (is_binary(instr.op)) {
+                instr.b = clone_operand(instr.b, renamed);
+            }
+            add_instr(clone, instr);
+        }
+        clone->term = block->term;
+        if (block->term.kind == TERM_BRANCH) {
+            clone->term.a = clone_operand(block->term.a, renamed);
+            clone->term.b = clone_operand(block->term.b, renamed);
+        }
+        for (size_t s = 0; s < num_succs(block); s++) {
+            ir_block_t *target = block->term.targets[s];
+            if (loop->in_loop[target->id]) {
+                clone->term.targets[s] = clones[target->id];
+            }
+        }
+    }
+
+    // Each copy gets a preheader of its own, entered from the old one.
+    ir_block_t *preheader = loop->preheader;
+    ir_block_t *if_true = init_block(preheader->weight);
+    ir_block_t *if_false = init_block(preheader->weight);
+    if_true->term.kind = TERM_JUMP;
+    if_true->term.targets[0] = loop->header;
+    if_false->term.kind = TERM_JUMP;
+    if_false->term.targets[0] = clones[loop->header->id];
+    preheader->term = branch->term;
+    preheader->term.targets[0] = if_true;
+    preheader->term.targets[1] = if_false;
+    ir_block_t *branch_clone = clones[branch->id];
+    branch->term.kind = TERM_JUMP;
+    branch_clone->term.kind = TERM_JUMP;
+    branch_clone->term.targets[0] = branch_clone->term.targets[1];
+
+    // The copy goes before the original, so the original still falls into its exit.
+    insert_block(program, first, if_true);
+    for (size_t i = n; i > 0; i--) {
+        if (clones[i - 1] != NULL) {
+            insert_block(program, first, clones[i - 1]);
+        }
+    }
+    insert_block(program, first, if_false);
+    free(clones);
+    free(renamed);
+    remove_unreachable(program);
+}
+
+void unswitch_loops(ir_program_t *program) {
+    size_t budget = UNSWITCH_BUDGET;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        compute_preds(program);
+        size_t num_loops;
+        ir_loop_t *loops = find_loops(program, &num_loops);
+        bool *defined = malloc(program->num_values * sizeof(bool));
+        assert(defined != NULL);
+        for (size_t l = 0; l < num_loops && !changed; l++) {
+            ir_loop_t *loop = &loops[l];
+            size_t size = loop_size(program, loop);
+            if (loop->preheader == NULL || size > budget) {
+                continue;
+            }
+            ir_block_t *branch = find_invariant_branch(program, loop, defined);
+            if (branch != NULL) {
+                unswitch_loop(program, loop, branch);
+                budget -= size;
+                changed = true;
+            }
+        }
+        free(defined);
+        free_loops(loops, num_loops);
+    }
+}
@@ -0,0 +1,1001 @@
+#include "object.h"
+
+#include <assert.h>
+#include <elf.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A register field value meaning there is no register
+#define NO_REG 0xFF
+// The number of general purpose registers
+#define NUM_ENCODED_REGS 16
+
+// Each register's name, in the order of the numbers instructions encode them by
+char *const ENCODED_REGS[NUM_ENCODED_REGS] = {
+    "%rax", "%rcx", "%rdx", "%rbx", "%rsp", "%rbp", "%rsi", "%rdi",
+    "%r8",  "%r9",  "%r10", "%r11", "%r12", "%r13", "%r14", "%r15",
+};
+// The low 32 bits of each register, in the same order
+char *const ENCODED_REGS_32[NUM_ENCODED_REGS] = {
+    "%eax", "%ecx", "%edx",  "%ebx",  "%esp",  "%ebp",  "%esi",  "%edi",
+    "%r8d", "%r9d", "%r10d", "%r11d", "%r12d", "%r13d", "%r14d", "%r15d",
+};
+
+// A condition code suffix and the number jcc and cmovcc opcodes encode it by
+typedef struct {
+    char *suffix;
+    uint8_t code;
+} cond_code_t;
+
+const cond_code_t COND_CODES[] = {
+    {"b", 0x2}, {"ae", 0x3}, {"e", 0x4},  {"ne", 0x5}, {"be", 0x6}, {"a", 0x7},
+    {"s", 0x8}, {"ns", 0x9}, {"l", 0xC},  {"ge", 0xD}, {"le", 0xE}, {"g", 0xF},
+};
+#define NUM_COND_CODES (sizeof(COND_CODES) / sizeof(COND_CODES[0]))
+
+// How an instruction is encoded: whether it operates on 64 bits, its opcodes
+// storing a register into its r/m operand and loading its r/m operand into a
+// register (if it has those forms), and the ModRM reg field selecting it
+// among the instructions sharing an opcode
+typedef struct {
+    char *mnemonic;
+    bool wide;
+    uint8_t store;
+    uint8_t load;
+    uint8_t extension;
+} encoding_t;
+
+// Two-operand arithmetic, whose immediate forms are opcodes 0x83 and 0x81
+const encoding_t ALU_INSTRS[] = {
+    {"addq", true, 0x01, 0x03, 0},
+    {"subq", true, 0x29, 0x2B, 5},
+    {"cmpq", true, 0x39, 0x3B, 7},
+    {"xorl", false, 0x31, 0x33, 6},
+};
+#define NUM_ALU_INSTRS (sizeof(ALU_INSTRS) / sizeof(ALU_INSTRS[0]))
+
+// Single-operand instructions in the group of opcode 0xF7
+const encoding_t UNARY_INSTRS[] = {
+    {"negq", true, 0, 0, 3},
+    {"imulq", true, 0, 0, 5},
+    {"divl", false, 0, 0, 6},
+    {"idivq", true, 0, 0, 7},
+};
+#define NUM_UNARY_INSTRS (sizeof(UNARY_INSTRS) / sizeof(UNARY_INSTRS[0]))
+
+// Shifts by an immediate, in the groups of opcodes 0xC1 and 0xD1 (shifts by 1)
+const encoding_t SHIFT_INSTRS[] = {
+    {"salq", true, 0, 0, 4},
+    {"shrq", true, 0, 0, 5},
+    {"sarq", true, 0, 0, 7},
+};
+#define NUM_SHIFT_INSTRS (sizeof(SHIFT_INSTRS) / sizeof(SHIFT_INSTRS[0]))
+
+// The recommended multi-byte NOP of each length up to MAX_NOP_LENGTH
+#define MAX_NOP_LENGTH 9
+const uint8_t NOPS[MAX_NOP_LENGTH][MAX_NOP_LENGTH] = {
+    {0x90},
+    {0x66, 0x90},
+    {0x0F, 0x1F, 0x00},
+    {0x0F, 0x1F, 0x40, 0x00},
+    {0x0F, 0x1F, 0x44, 0x00, 0x00},
+    {0x66, 0x0F, 0x1F, 0x44, 0x00, 0x00},
+    {0x0F, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x00},
+    {0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x66, 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},
+};
+
+// The ways an operand can be written
+typedef enum { OPERAND_REG, OPERAND_IMM, OPERAND_MEM, OPERAND_NAME } operand_kind_t;
+
+// An instruction operand, decoded from its text
+typedef struct {
+    operand_kind_t kind;
+    // The register of a register operand, or the base register of a memory
+    // operand (NO_REG if it has none)
+    uint8_t reg;
+    // Whether a register operand names the low 32 bits of the register
+    bool is_32;
+    // The index register of a memory operand (NO_REG if it has none)
+    uint8_t index;
+    uint8_t scale;
+    // The value of an immediate operand, or the displacement of a memory one
+    int64_t imm;
+    // The label or symbol an operand names, or that a memory operand is
+    // relative to %rip from, or NULL
+    char *name;
+} operand_t;
+
+// The state of encoding a buffer of assembly
+typedef struct {
+    asm_buffer_t *buffer;
+    machine_code_t code;
+    // The offset in the code of each line, as of the last pass
+    size_t *offsets;
+    // The line of the label each jump or call targets, or SIZE_MAX if its
+    // target is not a label in the code
+    size_t *targets;
+    // Whether each jump to a label needs a 32-bit displacement
+    bool *long_jumps;
+} encoder_t;
+
+/*
+ * Appends bytes to the machine code.
+ */
+void put_bytes(machine_code_t *code, const uint8_t *bytes, size_t length) {
+    if (code->capacity - code->length < length) {
+        code->capacity = code->capacity * 2 + length;
+        code->bytes = realloc(code->bytes, code->capacity);
+        assert(code->bytes != NULL);
+    }
+    memcpy(code->bytes + code->length, bytes, length);
+    code->length += length;
+}
+
+/*
+ * Appends the low size bytes of a value to the machine code, little-endian.
+ */
+void put_value(machine_code_t *code, uint64_t value, size_t size) {
+    uint8_t bytes[sizeof(uint64_t)];
+    for (size_t i = 0; i < size; i++) {
+        bytes[i] = value >> (8 * i);
+    }
+    put_bytes(code, bytes, size);
+}
+
+/*
+ * Appends a 32-bit placeholder the linker fills in with the address of a
+ * symbol relative to the end of the instruction, trailing bytes later.
+ */
+void put_reloc(machine_code_t *code, char *name, uint32_t type, size_t trailing) {
+    if (code->num_relocs == code->relocs_capacity) {
+        code->relocs_capacity = code->relocs_capacity * 2 + 4;
+        code->relocs = realloc(code->relocs, code->relocs_capacity * sizeof(reloc_t));
+        assert(code->relocs != NULL);
+    }
+    reloc_t *reloc = &code->relocs[code->num_relocs++];
+    reloc->offset = code->length;
+    strcpy(reloc->name, name);
+    reloc->type = type;
+    reloc->addend = -(int64_t) (sizeof(uint32_t) + trailing);
+    put_value(code, 0, sizeof(uint32_t));
+}
+
+/*
+ * Returns true iff a value fits in a sign-extended 8-bit field.
+ */
+bool fits_8(int64_t value) {
+    return value >= INT8_MIN && value <= INT8_MAX;
+}
+
+/*
+ * Returns true iff a value fits in a sign-extended 32-bit field.
+ */
+bool fits_32(int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+/*
+ * Finds a register by name. Returns false if text names none.
+ */
+bool parse_reg(char *text, uint8_t *reg, bool *is_32) {
+    for (uint8_t r = 0; r < NUM_ENCODED_REGS; r++) {
+        if (strcmp(text, ENCODED_REGS[r]) == 0 || strcmp(text, ENCODED_REGS_32[r]) == 0) {
+            *reg = r;
+            *is_32 = strcmp(text, ENCODED_REGS_32[r]) == 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Parses a decimal number, which may be unsigned 64-bit like the magic
+ * multipliers of divisions. Sets *end past it.
+ */
+int64_t parse_number(char *text, char **end) {
+    if (text[0] == '-') {
+        return strtoll(text, end, 10);
+    }
+    return (int64_t) strtoull(text, end, 10);
+}
+
+/*
+ * Decodes the memory operand inside the parentheses of text, starting at
+ * paren. Returns false if it is malformed or cannot be encoded.
+ */
+bool parse_address(char *paren, operand_t *operand) {
+    char *parts[3] = {paren + 1, NULL, NULL};
+    size_t num_parts = 1;
+    char *close = strchr(paren, ')');
+    if (close == NULL || close[1] != '\0') {
+        return false;
+    }
+    for (char *c = paren + 1; c < close; c++) {
+        if (*c == ',') {
+            if (num_parts == 3) {
+                return false;
+            }
+            parts[num_parts++] = c + 1;
+        }
+    }
+
+    // Each part ends at the comma or parenthesis after it
+    char texts[3][ASM_TOKEN_SIZE];
+    for (size_t p = 0; p < num_parts; p++) {
+        char *end = p + 1 < num_parts ? parts[p + 1] - 1 : close;
+        size_t length = end - parts[p];
+        memcpy(texts[p], parts[p], length);
+        texts[p][length] = '\0';
+    }
+    bool is_32;
+    if (strcmp(texts[0], "%rip") == 0) {
+        return num_parts == 1 && operand->name != NULL && operand->imm == 0;
+    }
+    if (operand->name != NULL ||
+        (texts[0][0] != '\0' && (!parse_reg(texts[0], &operand->reg, &is_32) || is_32))) {
+        return false;
+    }
+    if (num_parts >= 2 &&
+        (!parse_reg(texts[1], &operand->index, &is_32) || is_32 || operand->index == 4)) {
+        return false;
+    }
+    if (num_parts == 3) {
+        char *end;
+        operand->scale = parse_number(texts[2], &end);
+        if (*end != '\0' || (operand->scale != 1 && operand->scale != 2 &&
+                             operand->scale != 4 && operand->scale != 8)) {
+            return false;
+        }
+    }
+    return fits_32(operand->imm);
+}
+
+/*
+ * Decodes an operand from its text. Returns false if it is malformed or
+ * cannot be encoded.
+ */
+bool parse_operand(char *text, operand_t *operand) {
+    *operand = (operand_t){.reg = NO_REG, .index = NO_REG, .scale = 1, .name = NULL};
+    char *end;
+    if (text[0] == '%') {
+        operand->kind = OPERAND_REG;
+        return parse_reg(text, &operand->reg, &operand->is_32);
+    }
+    if (text[0] == '$') {
+        operand->kind = OPERAND_IMM;
+        operand->imm = parse_number(text + 1, &end);
+        return end != text + 1 && *end == '\0';
+    }
+    char *paren = strchr(text, '(');
+    if (paren == NULL) {
+        operand->kind = OPERAND_NAME;
+        operand->name = text;
+        return true;
+    }
+    operand->kind = OPERAND_MEM;
+    if (paren != text && (text[0] == '-' || (text[0] >= '0' && text[0] <= '9'))) {
+        operand->imm = parse_number(text, &end);
+        if (end != paren) {
+            return false;
+        }
+    }
+    else if (paren != text) {
+        // A symbol, which is only supported relative to %rip
+        *paren = '\0';
+        operand->name = strdup(text);
+        *paren = '(';
+        assert(operand->name != NULL);
+    }
+    return parse_address(paren, operand);
+}
+
+/*
+ * Frees what parsing an operand allocated.
+ */
+void free_operand(operand_t *operand) {
+    if (operand->kind == OPERAND_MEM) {
+        free(operand->name);
+    }
+}
+
+/*
+ * Appends an instruction that addresses a register or memory operand with a
+ * ModRM byte: its REX prefix if it needs one, its opcode, the ModRM byte with
+ * reg in the reg field, and any SIB byte and displacement. trailing is the
+ * number of immediate bytes that will follow, which a %rip-relative address
+ * is measured past.
+ */
+void encode_modrm(machine_code_t *code, bool wide, const uint8_t *opcode,
+                  size_t opcode_length, uint8_t reg, operand_t *rm, size_t trailing) {
+    uint8_t base = rm->reg;
+    uint8_t rex = (wide ? 0x8 : 0) | (reg & 0x8 ? 0x4 : 0);
+    if (rm->kind == OPERAND_MEM && rm->index != NO_REG && (rm->index & 0x8)) {
+        rex |= 0x2;
+    }
+    if (base != NO_REG && (base & 0x8)) {
+        rex |= 0x1;
+    }
+    if (rex != 0) {
+        put_value(code, 0x40 | rex, 1);
+    }
+    put_bytes(code, opcode, opcode_length);
+
+    reg &= 0x7;
+    if (rm->kind == OPERAND_REG) {
+        put_value(code, 0xC0 | reg << 3 | (base & 0x7), 1);
+        return;
+    }
+    if (rm->name != NULL) {
+        // %rip-relative: mod 0 with r/m 5
+        put_value(code, reg << 3 | 0x5, 1);
+        put_reloc(code, rm->name, R_X86_64_PC32, trailing);
+        return;
+    }
+    if (base == NO_REG) {
+        // No base: a SIB byte with base 5 and a 32-bit displacement
+        uint8_t index = rm->index == NO_REG ? 0x4 : rm->index & 0x7;
+        put_value(code, reg << 3 | 0x4, 1);
+        put_value(code, (__builtin_ctz(rm->scale) << 6) | index << 3 | 0x5, 1);
+        put_value(code, rm->imm, sizeof(uint32_t));
+        return;
+    }
+    // %rbp and %r13 as a base always need a displacement
+    uint8_t mod = rm->imm == 0 && (base & 0x7) != 0x5 ? 0x0 : fits_8(rm->imm) ? 0x1 : 0x2;
+    // %rsp and %r12 as a base, and any index, need a SIB byte
+    bool sib = rm->index != NO_REG || (base & 0x7) == 0x4;
+    put_value(code, mod << 6 | reg << 3 | (sib ? 0x4 : base & 0x7), 1);
+    if (sib) {
+        uint8_t index = rm->index == NO_REG ? 0x4 : rm->index & 0x7;
+        put_value(code, (__builtin_ctz(rm->scale) << 6) | index << 3 | (base & 0x7), 1);
+    }
+    if (mod == 0x1) {
+        put_value(code, rm->imm, 1);
+    }
+    else if (mod == 0x2) {
+        put_value(code, rm->imm, sizeof(uint32_t));
+    }
+}
+
+/*
+ * Appends an instruction with a one-byte opcode and a ModRM byte.
+ */
+void encode_simple(machine_code_t *code, bool wide, uint8_t opcode, uint8_t reg,
+                   operand_t *rm, size_t trailing) {
+    encode_modrm(code, wide, &opcode, 1, reg, rm, trailing);
+}
+
+/*
+ * Returns true iff an operand is a register or memory operand whose size
+ * matches an instruction's.
+ */
+bool is_rm(operand_t *operand, bool wide) {
+    return (operand->kind == OPERAND_REG && operand->is_32 == !wide) ||
+           operand->kind == OPERAND_MEM;
+}
+
+/*
+ * Returns true iff an operand is a register whose size matches an instruction's.
+ */
+bool is_sized_reg(operand_t *operand, bool wide) {
+    return operand->kind == OPERAND_REG && operand->is_32 == !wide;
+}
+
+/*
+ * Appends a two-operand arithmetic instruction. Returns false if its
+ * operands cannot be encoded.
+ */
+bool encode_alu(machine_code_t *code, const encoding_t *instr, operand_t *src,
+                operand_t *dest) {
+    bool wide = instr->wide;
+    if (src->kind == OPERAND_IMM && is_rm(dest, wide)) {
+        if (fits_8(src->imm)) {
+            encode_simple(code, wide, 0x83, instr->extension, dest, 1);
+            put_value(code, src->imm, 1);
+            return true;
+        }
+        if (!fits_32(src->imm)) {
+            return false;
+        }
+        if (dest->kind == OPERAND_REG && dest->reg == 0) {
+            // The shorter form with %rax (or %eax) as the implicit operand
+            if (wide) {
+                put_value(code, 0x40 | 0x8, 1);
+            }
+            put_value(code, instr->extension << 3 | 0x5, 1);
+            put_value(code, src->imm, sizeof(uint32_t));
+            return true;
+        }
+        encode_simple(code, wide, 0x81, instr->extension, dest, sizeof(uint32_t));
+        put_value(code, src->imm, sizeof(uint32_t));
+        return true;
+    }
+    if (is_sized_reg(src, wide) && is_rm(dest, wide)) {
+        encode_simple(code, wide, instr->store, src->reg, dest, 0);
+        return true;
+    }
+    if (src->kind == OPERAND_MEM && is_sized_reg(dest, wide)) {
+        encode_simple(code, wide, instr->load, dest->reg, src, 0);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Appends a movq or movl. Returns false if its operands cannot be encoded.
+ */
+bool encode_move(machine_code_t *code, bool wide, operand_t *src, operand_t *dest) {
+    if (src->kind != OPERAND_IMM) {
+        encoding_t move = {"mov", wide, 0x89, 0x8B, 0};
+        return encode_alu(code, &move, src, dest);
+    }
+    // movq sign-extends a 32-bit immediate, and movl takes any 32 bits
+    bool fits = fits_32(src->imm) || (!wide && (uint64_t) src->imm <= UINT32_MAX);
+    if (is_sized_reg(dest, wide) && (wide ? !fits : fits)) {
+        // movl $c, r and movabs $c, r encode the register in the opcode
+        uint8_t rex = (wide ? 0x8 : 0) | (dest->reg & 0x8 ? 0x1 : 0);
+        if (rex != 0) {
+            put_value(code, 0x40 | rex, 1);
+        }
+        put_value(code, 0xB8 + (dest->reg & 0x7), 1);
+        put_value(code, src->imm, wide ? sizeof(uint64_t) : sizeof(uint32_t));
+        return true;
+    }
+    if (!fits || !is_rm(dest, wide)) {
+        return false;
+    }
+    encode_simple(code, wide, 0xC7, 0, dest, sizeof(uint32_t));
+    put_value(code, src->imm, sizeof(uint32_t));
+    return true;
+}
+
+/*
+ * Appends an imulq in any of its one-, two- and three-operand forms.
+ * Returns false if its operands cannot be encoded.
+ */
+bool encode_multiply(machine_code_t *code, operand_t *args, uint8_t num_args) {
+    if (num_args == 2 && args[0].kind == OPERAND_IMM) {
+        // imulq $c, r is imulq $c, r, r
+        operand_t three[] = {args[0], args[1], args[1]};
+        return encode_multiply(code, three, 3);
+    }
+    if (num_args == 2) {
+        if (!is_rm(&args[0], true) || !is_sized_reg(&args[1], true)) {
+            return false;
+        }
+        uint8_t opcode[] = {0x0F, 0xAF};
+        encode_modrm(code, true, opcode, sizeof(opcode), args[1].reg, &args[0], 0);
+        return true;
+    }
+    if (num_args != 3 || args[0].kind != OPERAND_IMM || !is_rm(&args[1], true) ||
+        !is_sized_reg(&args[2], true) || !fits_32(args[0].imm)) {
+        return false;
+    }
+    if (fits_8(args[0].imm)) {
+        encode_simple(code, true, 0x6B, args[2].reg, &args[1], 1);
+        put_value(code, args[0].imm, 1);
+    }
+    else {
+        encode_simple(code, true, 0x69, args[2].reg, &args[1], sizeof(uint32_t));
+        put_value(code, args[0].imm, sizeof(uint32_t));
+    }
+    return true;
+}
+
+/*
+ * Finds the number a condition code suffix is encoded as.
+ * Returns false if it is not one.
+ */
+bool parse_cond_code(char *suffix, uint8_t *code) {
+    for (size_t c = 0; c < NUM_COND_CODES; c++) {
+        if (strcmp(suffix, COND_CODES[c].suffix) == 0) {
+            *code = COND_CODES[c].code;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Appends a jump or call to a name. Jumps to labels in the code use an 8-bit
+ * displacement unless the encoder has found it too short; other names are
+ * left to the linker. cond is the condition code of a conditional jump, or
+ * NO_REG for an unconditional one.
+ */
+void encode_jump(encoder_t *encoder, size_t i, bool call, uint8_t cond, char *name) {
+    machine_code_t *code = &encoder->code;
+    size_t target = encoder->targets[i];
+    bool is_long = target == SIZE_MAX || encoder->long_jumps[i] || call;
+    if (call) {
+        put_value(code, 0xE8, 1);
+    }
+    else if (cond == NO_REG) {
+        put_value(code, is_long ? 0xE9 : 0xEB, 1);
+    }
+    else if (is_long) {
+        put_value(code, 0x0F, 1);
+        put_value(code, 0x80 + cond, 1);
+    }
+    else {
+        put_value(code, 0x70 + cond, 1);
+    }
+    if (target == SIZE_MAX) {
+        put_reloc(code, name, R_X86_64_PLT32, 0);
+        return;
+    }
+    size_t size = is_long ? sizeof(uint32_t) : 1;
+    int64_t displacement =
+        (int64_t) encoder->offsets[target] - (int64_t) (code->length + size);
+    put_value(code, displacement, size);
+}
+
+/*
+ * Finds an instruction's encoding in a table, or returns NULL.
+ */
+const encoding_t *find_encoding(const encoding_t *table, size_t length, char *mnemonic) {
+    for (size_t k = 0; k < length; k++) {
+        if (strcmp(mnemonic, table[k].mnemonic) == 0) {
+            return &table[k];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Appends the padding of a .p2align directive: NOPs up to the next multiple
+ * of 2^power bytes. Returns false if the directive is malformed.
+ */
+bool encode_alignment(machine_code_t *code, asm_line_t *line) {
+    char *end;
+    int64_t power = parse_number(line->args[0], &end);
+    if (line->num_args != 1 || *end != '\0' || power < 0 || power > 12) {
+        return false;
+    }
+    size_t padding = -code->length & ((1 << power) - 1);
+    while (padding > 0) {
+        size_t length = padding < MAX_NOP_LENGTH ? padding : MAX_NOP_LENGTH;
+        put_bytes(code, NOPS[length - 1], length);
+        padding -= length;
+    }
+    return true;
+}
+
+/*
+ * Appends the machine code for the instruction on the line at index i of the
+ * buffer, whose operands have been decoded. Returns false if it is not an
+ * instruction the encoder supports with those operands.
+ */
+bool encode_instr(encoder_t *encoder, size_t i, operand_t *args, uint8_t num_args) {
+    machine_code_t *code = &encoder->code;
+    char *mnemonic = encoder->buffer->lines[i].mnemonic;
+    const encoding_t *alu = find_encoding(ALU_INSTRS, NUM_ALU_INSTRS, mnemonic);
+    const encoding_t *unary = find_encoding(UNARY_INSTRS, NUM_UNARY_INSTRS, mnemonic);
+    const encoding_t *shift = find_encoding(SHIFT_INSTRS, NUM_SHIFT_INSTRS, mnemonic);
+    uint8_t cond;
+    if (alu != NULL) {
+        return num_args == 2 && encode_alu(code, alu, &args[0], &args[1]);
+    }
+    if (unary != NULL && num_args == 1) {
+        if (!is_rm(&args[0], unary->wide)) {
+            return false;
+        }
+        encode_simple(code, unary->wide, 0xF7, unary->extension, &args[0], 0);
+        return true;
+    }
+    if (shift != NULL) {
+        if (num_args != 2 || args[0].kind != OPERAND_IMM || args[0].imm < 0 ||
+            args[0].imm >= 64 || !is_rm(&args[1], true)) {
+            return false;
+        }
+        if (args[0].imm == 1) {
+            encode_simple(code, true, 0xD1, shift->extension, &args[1], 0);
+        }
+        else {
+            encode_simple(code, true, 0xC1, shift->extension, &args[1], 1);
+            put_value(code, args[0].imm, 1);
+        }
+        return true;
+    }
+    if (strcmp(mnemonic, "movq") == 0 || strcmp(mnemonic, "movl") == 0) {
+        return num_args == 2 && encode_move(code, mnemonic[3] == 'q', &args[0], &args[1]);
+    }
+    if (strcmp(mnemonic, "imulq") == 0) {
+        return encode_multiply(code, args, num_args);
+    }
+    if (strcmp(mnemonic, "leaq") == 0) {
+        if (num_args != 2 || args[0].kind != OPERAND_MEM ||
+            !is_sized_reg(&args[1], true)) {
+            return false;
+        }
+        encode_simple(code, true, 0x8D, args[1].reg, &args[0], 0);
+        return true;
+    }
+    if (strcmp(mnemonic, "testq") == 0) {
+        if (num_args != 2 || !is_sized_reg(&args[0], true) || !is_rm(&args[1], true)) {
+            return false;
+        }
+        encode_simple(code, true, 0x85, args[0].reg, &args[1], 0);
+        return true;
+    }
+    if (strncmp(mnemonic, "cmov", 4) == 0 && parse_cond_code(mnemonic + 4, &cond)) {
+        if (num_args != 2 || !is_rm(&args[0], true) || !is_sized_reg(&args[1], true)) {
+            return false;
+        }
+        uint8_t opcode[] = {0x0F, 0x40 + cond};
+        encode_modrm(code, true, opcode, sizeof(opcode), args[1].reg, &args[0], 0);
+        return true;
+    }
+    if (strcmp(mnemonic, "pushq") == 0 || strcmp(mnemonic, "popq") == 0) {
+        if (num_args != 1 || !is_sized_reg(&args[0], true)) {
+            return false;
+        }
+        if (args[0].reg & 0x8) {
+            put_value(code, 0x41, 1);
+        }
+        put_value(code, (mnemonic[1] == 'u' ? 0x50 : 0x58) + (args[0].reg & 0x7), 1);
+        return true;
+    }
+    if (strcmp(mnemonic, "cqto") == 0 && num_args == 0) {
+        put_value(code, 0x9948, 2);
+        return true;
+    }
+    if (strcmp(mnemonic, "retq") == 0 && num_args == 0) {
+        put_value(code, 0xC3, 1);
+        return true;
+    }
+    bool call = strcmp(mnemonic, "call") == 0;
+    bool jump = strcmp(mnemonic, "jmp") == 0;
+    if (call || jump || (mnemonic[0] == 'j' && parse_cond_code(mnemonic + 1, &cond))) {
+        if (num_args != 1 || args[0].kind != OPERAND_NAME) {
+            return false;
+        }
+        encode_jump(encoder, i, call, call || jump ? NO_REG : cond, args[0].name);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Appends the machine code for the line at index i of the buffer.
+ * Returns false if it has an instruction that cannot be encoded.
+ */
+bool encode_line(encoder_t *encoder, size_t i) {
+    asm_line_t *line = &encoder->buffer->lines[i];
+    if (line->is_label) {
+        return true;
+    }
+    if (strcmp(line->mnemonic, ".p2align") == 0) {
+        return encode_alignment(&encoder->code, line);
+    }
+
+    operand_t args[MAX_ASM_ARGS];
+    uint8_t num_args = 0;
+    bool parsed = true;
+    while (num_args < line->num_args && parsed) {
+        parsed = parse_operand(line->args[num_args], &args[num_args]);
+        num_args++;
+    }
+    bool encoded = parsed && encode_instr(encoder, i, args, num_args);
+    for (uint8_t a = 0; a < num_args; a++) {
+        free_operand(&args[a]);
+    }
+    return encoded;
+}
+
+/*
+ * Encodes every line of a buffer, placing each jump's target at its offset
+ * from the previous pass. Returns false if a line cannot be encoded.
+ */
+bool encode_pass(encoder_t *encoder, size_t *offsets) {
+    encoder->code.length = 0;
+    encoder->code.num_relocs = 0;
+    for (size_t i = 0; i < encoder->buffer->num_lines; i++) {
+        offsets[i] = encoder->code.length;
+        if (!encode_line(encoder, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Sorts label lines by name, and lines with the same name by position.
+ */
+int compare_labels(const void *a, const void *b) {
+    asm_line_t *label_a = *(asm_line_t **) a;
+    asm_line_t *label_b = *(asm_line_t **) b;
+    int order = strcmp(label_a->mnemonic, label_b->mnemonic);
+    return order != 0 ? order : label_a < label_b ? -1 : label_a > label_b ? 1 : 0;
+}
+
+/*
+ * Compares a name with the name of a label line, for bsearch().
+ */
+int compare_label_name(const void *name, const void *label) {
+    return strcmp((const char *) name, (*(asm_line_t **) label)->mnemonic);
+}
+
+/*
+ * Finds the line each jump or call to a label in the code targets, the first
+ * label with its name, by looking its name up in the labels sorted by name.
+ */
+void find_targets(encoder_t *encoder) {
+    asm_buffer_t *buffer = encoder->buffer;
+    asm_line_t **labels = malloc(sizeof(asm_line_t *[buffer->num_lines + 1]));
+    assert(labels != NULL);
+    size_t num_labels = 0;
+    for (size_t i = 0; i < buffer->num_lines; i++) {
+        if (buffer->lines[i].is_label) {
+            labels[num_labels++] = &buffer->lines[i];
+        }
+    }
+    qsort(labels, num_labels, sizeof(asm_line_t *), compare_labels);
+
+    for (size_t i = 0; i < buffer->num_lines; i++) {
+        asm_line_t *line = &buffer->lines[i];
+        encoder->targets[i] = SIZE_MAX;
+        if (line->is_label || line->num_args != 1 ||
+            (line->mnemonic[0] != 'j' && strcmp(line->mnemonic, "call") != 0)) {
+            continue;
+        }
+        asm_line_t **found = bsearch(line->args[0], labels, num_labels,
+                                     sizeof(asm_line_t *), compare_label_name);
+        if (found == NULL) {
+            continue;
+        }
+        while (found > labels && compare_label_name(line->args[0], found - 1) == 0) {
+            found--;
+        }
+        encoder->targets[i] = *found - buffer->lines;
+    }
+    free(labels);
+}
+
+/*
+ * Encodes a buffer, choosing the shortest displacement each jump to a label
+ * can use. Jumps start short and are lengthened until every one reaches its
+ * target; lengthening only moves code further apart, so this terminates.
+ */
+bool encode_buffer(encoder_t *encoder) {
+    asm_buffer_t *buffer = encoder->buffer;
+    size_t n = buffer->num_lines;
+    size_t *offsets = calloc(n + 1, sizeof(size_t));
+    assert(offsets != NULL);
+    find_targets(encoder);
+
+    bool stable = false;
+    bool encoded = true;
+    while (!stable && encoded) {
+        encoded = encode_pass(encoder, offsets);
+        stable = memcmp(offsets, encoder->offsets, n * sizeof(size_t)) == 0;
+        memcpy(encoder->offsets, offsets, n * sizeof(size_t));
+        for (size_t i = 0; i < n && encoded; i++) {
+            size_t target = encoder->targets[i];
+            if (target == SIZE_MAX || encoder->long_jumps[i]) {
+                continue;
+            }
+            // A short jump is two bytes long
+            int64_t displacement = (int64_t) offsets[target] - (int64_t) (offsets[i] + 2);
+            if (!fits_8(displacement)) {
+                encoder->long_jumps[i] = true;
+                stable = false;
+            }
+        }
+    }
+    free(offsets);
+    return encoded;
+}
+
+/*
+ * Appends a string to a string table. Returns its offset in the table.
+ */
+size_t add_string(output_t *table, const char *string) {
+    size_t length = strlen(string) + 1;
+    if (table->capacity - table->length < length) {
+        table->capacity = table->capacity * 2 + length;
+        table->text = realloc(table->text, table->capacity);
+        assert(table->text != NULL);
+    }
+    memcpy(table->text + table->length, string, length);
+    table->length += length;
+    return table->length - length;
+}
+
+/*
+ * Writes data at an offset in the stream, padding with zeros from the
+ * current position, which *position tracks.
+ */
+void write_at(FILE *stream, size_t *position, size_t offset, const void *data,
+              size_t size) {
+    assert(offset >= *position);
+    for (; *position < offset; (*position)++) {
+        fputc(0, stream);
+    }
+    fwrite(data, 1, size, stream);
+    *position += size;
+}
+
+/*
+ * Rounds an offset up to a multiple of alignment, which is a power of 2.
+ */
+size_t align_offset(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) & -alignment;
+}
+
+// The sections of the object file, in order
+typedef enum {
+    SECTION_NULL,
+    SECTION_TEXT,
+    SECTION_RODATA,
+    SECTION_RELA_TEXT,
+    SECTION_SYMTAB,
+    SECTION_STRTAB,
+    SECTION_SHSTRTAB,
+    SECTION_NOTE,
+    NUM_SECTIONS
+} section_t;
+
+char *const SECTION_NAMES[NUM_SECTIONS] = {
+    "", ".text", ".rodata", ".rela.text", ".symtab", ".strtab", ".shstrtab",
+    // Marks the stack as non-executable
+    ".note.GNU-stack",
+};
+
+/*
+ * Writes the ELF object file for encoded machine code.
+ */
+void write_elf(machine_code_t *code, output_t *output, FILE *stream) {
+    output_t strtab = {.text = NULL, .length = 0, .capacity = 0};
+    output_t shstrtab = {.text = NULL, .length = 0, .capacity = 0};
+    add_string(&strtab, "");
+    size_t name_offsets[NUM_SECTIONS];
+    for (size_t s = 0; s < NUM_SECTIONS; s++) {
+        name_offsets[s] = add_string(&shstrtab, SECTION_NAMES[s]);
+    }
+
+    // The local symbol of the data, then basic_main and the undefined
+    // symbols the relocations refer to
+    Elf64_Sym *symbols = calloc(code->num_relocs + 3, sizeof(Elf64_Sym));
+    Elf64_Rela *relas = calloc(code->num_relocs + 1, sizeof(Elf64_Rela));
+    assert(symbols != NULL && relas != NULL);
+    size_t num_symbols = 1;
+    size_t data_symbol = num_symbols++;
+    symbols[data_symbol] = (Elf64_Sym){
+        .st_name = add_string(&strtab, OUTPUT_LABEL),
+        .st_info = ELF64_ST_INFO(STB_LOCAL, STT_OBJECT),
+        .st_shndx = SECTION_RODATA,
+        .st_size = output->length,
+    };
+    size_t first_global = num_symbols;
+    symbols[num_symbols++] = (Elf64_Sym){
+        .st_name = add_string(&strtab, "basic_main"),
+        .st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC),
+        .st_shndx = SECTION_TEXT,
+        .st_size = code->length,
+    };
+    for (size_t r = 0; r < code->num_relocs; r++) {
+        reloc_t *reloc = &code->relocs[r];
+        size_t symbol = strcmp(reloc->name, OUTPUT_LABEL) == 0 ? data_symbol : 0;
+        for (size_t s = first_global + 1; s < num_symbols && symbol == 0; s++) {
+            if (strcmp(strtab.text + symbols[s].st_name, reloc->name) == 0) {
+                symbol = s;
+            }
+        }
+        if (symbol == 0) {
+            symbol = num_symbols++;
+            symbols[symbol] = (Elf64_Sym){
+                .st_name = add_string(&strtab, reloc->name),
+                .st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE),
+                .st_shndx = SHN_UNDEF,
+            };
+        }
+        relas[r] = (Elf64_Rela){
+            .r_offset = reloc->offset,
+            .r_info = ELF64_R_INFO(symbol, reloc->type),
+            .r_addend = reloc->addend,
+        };
+    }
+
+    Elf64_Shdr sections[NUM_SECTIONS] = {{0}};
+    const void *contents[NUM_SECTIONS] = {NULL};
+    sections[SECTION_TEXT] = (Elf64_Shdr){.sh_type = SHT_PROGBITS,
+                                          .sh_flags = SHF_ALLOC | SHF_EXECINSTR,
+                                          .sh_size = code->length,
+                                          .sh_addralign = 16};
+    contents[SECTION_TEXT] = code->bytes;
+    sections[SECTION_RODATA] = (Elf64_Shdr){
+        .sh_type = SHT_PROGBITS, .sh_flags = SHF_ALLOC, .sh_size = output->length,
+        .sh_addralign = 1};
+    contents[SECTION_RODATA] = output->text;
+    sections[SECTION_RELA_TEXT] = (Elf64_Shdr){
+        .sh_type = SHT_RELA,
+        .sh_flags = SHF_INFO_LINK,
+        .sh_size = code->num_relocs * sizeof(Elf64_Rela),
+        .sh_link = SECTION_SYMTAB,
+        .sh_info = SECTION_TEXT,
+        .sh_addralign = 8,
+        .sh_entsize = sizeof(Elf64_Rela)};
+    contents[SECTION_RELA_TEXT] = relas;
+    sections[SECTION_SYMTAB] = (Elf64_Shdr){.sh_type = SHT_SYMTAB,
+                                            .sh_size = num_symbols * sizeof(Elf64_Sym),
+                                            .sh_link = SECTION_STRTAB,
+                                            .sh_info = first_global,
+                                            .sh_addralign = 8,
+                                            .sh_entsize = sizeof(Elf64_Sym)};
+    contents[SECTION_SYMTAB] = symbols;
+    sections[SECTION_STRTAB] = (Elf64_Shdr){
+        .sh_type = SHT_STRTAB, .sh_size = strtab.length, .sh_addralign = 1};
+    contents[SECTION_STRTAB] = strtab.text;
+    sections[SECTION_SHSTRTAB] = (Elf64_Shdr){
+        .sh_type = SHT_STRTAB, .sh_size = shstrtab.length, .sh_addralign = 1};
+    contents[SECTION_SHSTRTAB] = shstrtab.text;
+    sections[SECTION_NOTE] = (Elf64_Shdr){.sh_type = SHT_PROGBITS, .sh_addralign = 1};
+
+    // The sections follow the ELF header in order, then the section headers
+    size_t offset = sizeof(Elf64_Ehdr);
+    for (size_t s = 1; s < NUM_SECTIONS; s++) {
+        sections[s].sh_name = name_offsets[s];
+        offset = align_offset(offset, sections[s].sh_addralign);
+        sections[s].sh_offset = offset;
+        offset += sections[s].sh_size;
+    }
+    Elf64_Ehdr header = {
+        .e_ident = {ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS64, ELFDATA2LSB,
+                    EV_CURRENT, ELFOSABI_SYSV},
+        .e_type = ET_REL,
+        .e_machine = EM_X86_64,
+        .e_version = EV_CURRENT,
+        .e_shoff = align_offset(offset, 8),
+        .e_ehsize = sizeof(Elf64_Ehdr),
+        .e_shentsize = sizeof(Elf64_Shdr),
+        .e_shnum = NUM_SECTIONS,
+        .e_shstrndx = SECTION_SHSTRTAB,
+    };
+    size_t position = 0;
+    write_at(stream, &position, 0, &header, sizeof(header));
+    for (size_t s = 1; s < NUM_SECTIONS; s++) {
+        write_at(stream, &position, sections[s].sh_offset, contents[s],
+                 sections[s].sh_size);
+    }
+    write_at(stream, &position, header.e_shoff, sections, sizeof(sections));
+
+    free(strtab.text);
+    free(shstrtab.text);
+    free(symbols);
+    free(relas);
+}
+
+bool assemble_buffer(asm_buffer_t *code, machine_code_t *machine_code) {
+    size_t n = code->num_lines;
+    encoder_t encoder = {
+        .buffer = code,
+        .code = {.bytes = NULL, .length = 0, .capacity = 0, .relocs = NULL,
+                 .num_relocs = 0, .relocs_capacity = 0},
+        .offsets = calloc(n + 1, sizeof(size_t)),
+        .targets = calloc(n + 1, sizeof(size_t)),
+        .long_jumps = calloc(n + 1, sizeof(bool)),
+    };
+    assert(encoder.offsets != NULL && encoder.targets != NULL &&
+           encoder.long_jumps != NULL);
+    bool encoded = encode_buffer(&encoder);
+    *machine_code = encoder.code;
+    free(encoder.offsets);
+    free(encoder.targets);
+    free(encoder.long_jumps);
+    return encoded;
+}
+
+void free_machine_code(machine_code_t *code) {
+    free(code->bytes);
+    free(code->relocs);
+}
+
+bool write_object(asm_buffer_t *code, output_t *output, FILE *stream) {
+    machine_code_t machine_code;
+    bool encoded = assemble_buffer(code, &machine_code);
+    if (encoded) {
+        write_elf(&machine_code, output, stream);
+    }
+    free_machine_code(&machine_code);
+    return encoded;
+}
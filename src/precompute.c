@@ -0,0 +1,335 @@
+#include "precompute.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ir.h"
+
+// The longest text print_int writes for one value, including the newline
+#define MAX_PRINTED_LENGTH 21
+// How many budgets' worth of steps the interpreter may take in all. Each loop
+// has its own budget, so without a limit nested loops would multiply them.
+#define TOTAL_BUDGETS 64
+
+typedef struct {
+    value_t vars[NUM_VARS];
+    // Whether each variable has been assigned, so reading it is defined
+    bool assigned[NUM_VARS];
+    // The number of steps the innermost running loop (or, outside loops, the
+    // current top-level statement) may still take
+    size_t steps_left;
+    // The number of steps each loop and each top-level statement may take
+    size_t budget;
+    // The number of steps left before the interpreter stops altogether
+    size_t total_steps_left;
+    output_t *output;
+    // The statements that continue the program from where a loop stopped,
+    // in the order they run. They belong to the program being run.
+    node_t **rest;
+    size_t rest_count;
+    size_t rest_capacity;
+} interpreter_t;
+
+// The state between two statements, which running can go back to
+typedef struct {
+    value_t vars[NUM_VARS];
+    bool assigned[NUM_VARS];
+    size_t output_length;
+} checkpoint_t;
+
+typedef enum {
+    // The statement finished
+    STATEMENT_RAN,
+    // A loop in the statement stopped after its last finished iteration. The
+    // state is the state after that iteration, and the interpreter's rest
+    // holds the statements that finish the statement from there.
+    STATEMENT_STOPPED,
+    // The statement cannot be run at compile time, and left the state
+    // partially updated
+    STATEMENT_FAILED
+} statement_result_t;
+
+statement_result_t interpret_statement(node_t *node, interpreter_t *state);
+
+/*
+ * Appends the line print_int would print for a value to the output.
+ */
+void append_output(output_t *output, value_t value) {
+    if (output->capacity - output->length < MAX_PRINTED_LENGTH + 1) {
+        output->capacity = output->capacity * 2 + MAX_PRINTED_LENGTH + 1;
+        output->text = realloc(output->text, output->capacity);
+        assert(output->text != NULL);
+    }
+    output->length += sprintf(output->text + output->length, "%" PRId64 "\n", value);
+}
+
+/*
+ * Appends statements to those that continue the program after a loop stopped.
+ */
+void append_rest(interpreter_t *state, node_t **statements, size_t count) {
+    if (state->rest_capacity - state->rest_count < count) {
+        state->rest_capacity = state->rest_capacity * 2 + count;
+        state->rest = realloc(state->rest, sizeof(node_t *[state->rest_capacity]));
+        assert(state->rest != NULL);
+    }
+    memcpy(&state->rest[state->rest_count], statements, sizeof(node_t *[count]));
+    state->rest_count += count;
+}
+
+/*
+ * Records the variables and the length of the output so far.
+ */
+void save_checkpoint(interpreter_t *state, checkpoint_t *checkpoint) {
+    memcpy(checkpoint->vars, state->vars, sizeof(state->vars));
+    memcpy(checkpoint->assigned, state->assigned, sizeof(state->assigned));
+    checkpoint->output_length = state->output->length;
+}
+
+/*
+ * Goes back to a recorded state, dropping the output printed since.
+ */
+void restore_checkpoint(interpreter_t *state, checkpoint_t *checkpoint) {
+    memcpy(state->vars, checkpoint->vars, sizeof(state->vars));
+    memcpy(state->assigned, checkpoint->assigned, sizeof(state->assigned));
+    state->output->length = checkpoint->output_length;
+}
+
+/*
+ * Evaluates an expression. Returns false if evaluating it would trap at
+ * runtime or read a variable that has no value yet.
+ */
+bool interpret_expr(node_t *node, interpreter_t *state, value_t *value) {
+    if (node->type == NUM) {
+        *value = ((num_node_t *) node)->value;
+        return true;
+    }
+    if (node->type == VAR) {
+        size_t var = ((var_node_t *) node)->name - 'A';
+        *value = state->vars[var];
+        return state->assigned[var];
+    }
+    assert(node->type == BINARY_OP);
+    binary_node_t *bin_node = (binary_node_t *) node;
+    value_t left, right;
+    if (!interpret_expr(bin_node->left, state, &left) ||
+        !interpret_expr(bin_node->right, state, &right)) {
+        return false;
+    }
+    char op = bin_node->op;
+    if (op == '<' || op == '=' || op == '>') {
+        *value = eval_cond(ir_cond(op), left, right);
+        return true;
+    }
+    return fold_op(ir_op(op), left, right, value);
+}
+
+/*
+ * Charges a step to the innermost running loop.
+ * Returns false if its budget, or the interpreter's, has run out.
+ */
+bool take_step(interpreter_t *state) {
+    if (state->steps_left == 0 || state->total_steps_left == 0) {
+        return false;
+    }
+    state->steps_left--;
+    state->total_steps_left--;
+    return true;
+}
+
+/*
+ * Runs a loop with its own budget, which the loops nested in it do not use
+ * up. If the loop cannot finish, it stops after its last finished iteration,
+ * where the compiled loop can pick up by testing its condition again.
+ */
+statement_result_t interpret_loop(while_node_t *while_node, interpreter_t *state) {
+    size_t outer_steps_left = state->steps_left;
+    state->steps_left = state->budget;
+    checkpoint_t checkpoint;
+    statement_result_t result;
+    while (true) {
+        save_checkpoint(state, &checkpoint);
+        value_t condition;
+        if (!take_step(state) ||
+            !interpret_expr(while_node->condition, state, &condition)) {
+            result = STATEMENT_FAILED;
+            break;
+        }
+        if (!condition) {
+            result = STATEMENT_RAN;
+            break;
+        }
+        result = interpret_statement(while_node->body, state);
+        if (result != STATEMENT_RAN) {
+            break;
+        }
+    }
+    state->steps_left = outer_steps_left;
+    if (result == STATEMENT_RAN) {
+        return result;
+    }
+
+    // A nested loop that stopped has put what is left of this iteration in
+    // the rest already
+    if (result == STATEMENT_FAILED) {
+        restore_checkpoint(state, &checkpoint);
+    }
+    node_t *loop = (node_t *) while_node;
+    append_rest(state, &loop, 1);
+    return STATEMENT_STOPPED;
+}
+
+/*
+ * Runs a statement, returning whether it finished, stopped in a loop, or
+ * failed.
+ */
+statement_result_t interpret_statement(node_t *node, interpreter_t *state) {
+    if (!take_step(state)) {
+        return STATEMENT_FAILED;
+    }
+    if (node->type == SEQUENCE) {
+        sequence_node_t *sequence = (sequence_node_t *) node;
+        for (size_t i = 0; i < sequence->statement_count; i++) {
+            statement_result_t result =
+                interpret_statement(sequence->statements[i], state);
+            if (result == STATEMENT_STOPPED) {
+                append_rest(state, &sequence->statements[i + 1],
+                            sequence->statement_count - i - 1);
+            }
+            if (result != STATEMENT_RAN) {
+                return result;
+            }
+        }
+        return STATEMENT_RAN;
+    }
+    if (node->type == PRINT) {
+        value_t value;
+        if (!interpret_expr(((print_node_t *) node)->expr, state, &value)) {
+            return STATEMENT_FAILED;
+        }
+        append_output(state->output, value);
+        return STATEMENT_RAN;
+    }
+    if (node->type == LET) {
+        let_node_t *let_node = (let_node_t *) node;
+        size_t var = let_node->var - 'A';
+        if (!interpret_expr(let_node->value, state, &state->vars[var])) {
+            return STATEMENT_FAILED;
+        }
+        state->assigned[var] = true;
+        return STATEMENT_RAN;
+    }
+    if (node->type == IF) {
+        if_node_t *if_node = (if_node_t *) node;
+        value_t condition;
+        if (!interpret_expr(if_node->condition, state, &condition)) {
+            return STATEMENT_FAILED;
+        }
+        node_t *branch = condition ? if_node->if_branch : if_node->else_branch;
+        return branch == NULL ? STATEMENT_RAN : interpret_statement(branch, state);
+    }
+    assert(node->type == WHILE);
+    return interpret_loop((while_node_t *) node, state);
+}
+
+void precompute(node_t **program, size_t budget, output_t *output) {
+    node_t **statements = program;
+    size_t count = 1;
+    if ((*program)->type == SEQUENCE) {
+        statements = ((sequence_node_t *) *program)->statements;
+        count = ((sequence_node_t *) *program)->statement_count;
+    }
+
+    size_t total_budget =
+        budget > SIZE_MAX / TOTAL_BUDGETS ? SIZE_MAX : budget * TOTAL_BUDGETS;
+    interpreter_t state = {
+        .budget = budget, .total_steps_left = total_budget, .output = output};
+    size_t ran = 0;
+    for (; ran < count; ran++) {
+        // A statement that fails outside any loop is left to run, from the
+        // start, in the compiled program
+        checkpoint_t before;
+        save_checkpoint(&state, &before);
+        state.steps_left = budget;
+        statement_result_t result = interpret_statement(statements[ran], &state);
+        if (result == STATEMENT_FAILED) {
+            restore_checkpoint(&state, &before);
+            break;
+        }
+        if (result == STATEMENT_STOPPED) {
+            ran++;
+            break;
+        }
+    }
+    append_rest(&state, &statements[ran], count - ran);
+    if (state.rest_count == 0) {
+        free(state.rest);
+        free_ast(*program);
+        *program = NULL;
+        return;
+    }
+    if (ran == 0) {
+        free(state.rest);
+        return;
+    }
+
+    size_t num_assigned = 0;
+    for (size_t var = 0; var < NUM_VARS; var++) {
+        num_assigned += state.assigned[var];
+    }
+    size_t rest_count = num_assigned + state.rest_count;
+    node_t **rest = malloc(sizeof(node_t *[rest_count]));
+    assert(rest != NULL);
+    size_t index = 0;
+    for (size_t var = 0; var < NUM_VARS; var++) {
+        if (state.assigned[var]) {
+            node_t *value = init_num_node(state.vars[var]);
+            rest[index++] = init_let_node('A' + var, value);
+        }
+    }
+    // The statements left may be nested anywhere in the program, so they
+    // are copied out of it before it is freed
+    for (size_t i = 0; i < state.rest_count; i++) {
+        rest[index++] = copy_ast(state.rest[i]);
+    }
+    free(state.rest);
+    free_ast(*program);
+    *program = init_sequence_node(rest_count, rest);
+}
+
+void emit_output_data(output_t *output) {
+    printf(
+        "# The output of the statements run by the compiler\n"
+        ".section .rodata\n"
+        OUTPUT_LABEL ":\n");
+    size_t start = 0;
+    for (size_t i = 0; i < output->length; i++) {
+        if (output->text[i] == '\n') {
+            printf("    .ascii \"%.*s\\n\"\n", (int) (i - start), output->text + start);
+            start = i + 1;
+        }
+    }
+}
+
+void emit_output_writer(asm_buffer_t *buffer, output_t *output, bool finished) {
+    if (output->length == 0) {
+        if (finished) {
+            emit(buffer, "retq");
+        }
+        return;
+    }
+
+    // print_output(precomputed_output, length)
+    emit(buffer, "leaq " OUTPUT_LABEL "(%%rip), %%rdi");
+    emit(buffer, "movq $%zu, %%rsi", output->length);
+    if (finished) {
+        emit(buffer, "jmp print_output");
+        return;
+    }
+    // The return address leaves the stack 8 bytes short of 16-byte alignment
+    emit(buffer, "subq $8, %%rsp");
+    emit(buffer, "call print_output");
+    emit(buffer, "addq $8, %%rsp");
+}
@@ -0,0 +1,532 @@
+#include "passes.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The number of times a block's entry state can grow before growing bounds
+// jump straight to the extremes, so loops reach a fixed point quickly
+#define WIDEN_AFTER 2
+// The number of passes that recompute the states after widening, recovering
+// the bounds that branches impose on loop variables
+#define NARROWING_ROUNDS 2
+// The bounds widening tries before the extremes, besides the constants that
+// branches compare against, so incrementing a widened counter does not wrap
+#define NUM_FIXED_THRESHOLDS 6
+
+/*
+ * The values a value can hold at a point in the program: every number from lo
+ * to hi inclusive.
+ */
+typedef struct {
+    value_t lo;
+    value_t hi;
+} range_t;
+
+const range_t FULL_RANGE = {INT64_MIN, INT64_MAX};
+
+const value_t FIXED_THRESHOLDS[NUM_FIXED_THRESHOLDS] = {
+    -((value_t) 1 << 62), -((value_t) 1 << 32), INT32_MIN,
+    INT32_MAX,            UINT32_MAX,           (value_t) 1 << 62,
+};
+
+typedef struct {
+    ir_program_t *program;
+    // The range of each value on entry to each block, indexed by block id
+    range_t **in_states;
+    // Whether any path from the entry block can reach each block, considering
+    // only the branches whose conditions the ranges allow
+    bool *executable;
+    // The number of times each block's entry state has grown
+    size_t *updates;
+    // Whether each block is the target of an edge that closes a cycle, so
+    // widening its entry state is enough to make every loop stabilize
+    bool *widens;
+    // The bounds a widened range can take short of the extremes, in order
+    value_t *thresholds;
+    size_t num_thresholds;
+    ir_block_t **worklist;
+    size_t worklist_size;
+    bool *queued;
+} range_data;
+
+/*
+ * Returns the range of an operand's value in a state.
+ */
+range_t operand_range(ir_operand_t operand, range_t *state) {
+    if (operand.is_imm) {
+        range_t range = {operand.imm, operand.imm};
+        return range;
+    }
+    return state[operand.value];
+}
+
+/*
+ * Returns the smallest range containing a set of numbers, or the full range if
+ * any of them does not fit in 64 bits, since the operation producing them
+ * wraps around.
+ */
+range_t hull(__int128 *numbers, size_t count) {
+    __int128 lo = numbers[0], hi = numbers[0];
+    for (size_t i = 1; i < count; i++) {
+        lo = numbers[i] < lo ? numbers[i] : lo;
+        hi = numbers[i] > hi ? numbers[i] : hi;
+    }
+    if (lo < INT64_MIN || hi > INT64_MAX) {
+        return FULL_RANGE;
+    }
+    range_t range = {(value_t) lo, (value_t) hi};
+    return range;
+}
+
+/*
+ * Returns the range of a / b for divisors that are all positive or all
+ * negative. The quotient only moves one way as either operand grows, so its
+ * extremes are at the corners. The one quotient that does not fit,
+ * INT64_MIN / -1, traps, so it is clamped rather than wrapped.
+ */
+range_t quotient_range(range_t a, range_t b) {
+    __int128 corners[] = {
+        (__int128) a.lo / b.lo,
+        (__int128) a.lo / b.hi,
+        (__int128) a.hi / b.lo,
+        (__int128) a.hi / b.hi,
+    };
+    for (size_t i = 0; i < 4; i++) {
+        corners[i] = corners[i] > INT64_MAX ? INT64_MAX : corners[i];
+    }
+    return hull(corners, 4);
+}
+
+/*
+ * Returns the smallest range containing two ranges.
+ */
+range_t union_range(range_t a, range_t b) {
+    range_t range = {a.lo < b.lo ? a.lo : b.lo, a.hi > b.hi ? a.hi : b.hi};
+    return range;
+}
+
+/*
+ * Returns the range of `a op b` given the ranges of its operands.
+ */
+range_t binary_range(ir_op_t op, range_t a, range_t b) {
+    if (op == IR_ADD) {
+        __int128 bounds[] = {(__int128) a.lo + b.lo, (__int128) a.hi + b.hi};
+        return hull(bounds, 2);
+    }
+    if (op == IR_SUB) {
+        __int128 bounds[] = {(__int128) a.lo - b.hi, (__int128) a.hi - b.lo};
+        return hull(bounds, 2);
+    }
+    if (op == IR_MUL) {
+        __int128 corners[] = {
+            (__int128) a.lo * b.lo,
+            (__int128) a.lo * b.hi,
+            (__int128) a.hi * b.lo,
+            (__int128) a.hi * b.hi,
+        };
+        return hull(corners, 4);
+    }
+    if (op == IR_DIV) {
+        // Dividing by 0 traps, so only the nonzero divisors matter.
+        range_t negative = {b.lo, b.hi < -1 ? b.hi : -1};
+        range_t positive = {b.lo > 1 ? b.lo : 1, b.hi};
+        if (negative.lo > negative.hi) {
+            return positive.lo > positive.hi ? FULL_RANGE : quotient_range(a, positive);
+        }
+        if (positive.lo > positive.hi) {
+            return quotient_range(a, negative);
+        }
+        return union_range(quotient_range(a, negative), quotient_range(a, positive));
+    }
+    // The remainder has the sign of the dividend and is smaller than both
+    // operands in magnitude.
+    __int128 max_divisor = -(__int128) b.lo > b.hi ? -(__int128) b.lo : b.hi;
+    value_t limit = max_divisor > 0 ? (value_t) (max_divisor - 1) : 0;
+    range_t range = {a.lo > 0 ? 0 : a.lo, a.hi < 0 ? 0 : a.hi};
+    range.lo = range.lo < -limit ? -limit : range.lo;
+    range.hi = range.hi > limit ? limit : range.hi;
+    return range;
+}
+
+/*
+ * Updates a state to reflect the effect of an instruction.
+ */
+void apply_range(ir_instr_t *instr, range_t *state) {
+    if (!has_dest(instr)) {
+        return;
+    }
+    range_t result = operand_range(instr->a, state);
+    if (is_binary(instr->op)) {
+        result = binary_range(instr->op, result, operand_range(instr->b, state));
+    }
+    state[instr->dest] = result;
+}
+
+/*
+ * Narrows the ranges of two operands to the values for which `a cond b` can
+ * hold. Returns false if no values in the ranges satisfy the condition.
+ */
+bool refine_ranges(ir_cond_t cond, range_t *a, range_t *b) {
+    if (cond == COND_GT || cond == COND_GE) {
+        return refine_ranges(swap_cond(cond), b, a);
+    }
+    if (cond == COND_LT || cond == COND_LE) {
+        // a < b is a <= b - 1, and b->hi > a->lo rules out overflow below.
+        value_t gap = cond == COND_LT ? 1 : 0;
+        if ((gap == 1 && b->hi == INT64_MIN) || a->lo > b->hi - gap) {
+            return false;
+        }
+        a->hi = a->hi > b->hi - gap ? b->hi - gap : a->hi;
+        b->lo = b->lo < a->lo + gap ? a->lo + gap : b->lo;
+        return true;
+    }
+    if (cond == COND_EQ) {
+        range_t both = {a->lo > b->lo ? a->lo : b->lo, a->hi < b->hi ? a->hi : b->hi};
+        if (both.lo > both.hi) {
+            return false;
+        }
+        *a = both;
+        *b = both;
+        return true;
+    }
+    // Only excluding a single value at either end of a range narrows it.
+    if (a->lo == a->hi && b->lo == b->hi) {
+        return a->lo != b->lo;
+    }
+    range_t *single = a->lo == a->hi ? a : b;
+    range_t *other = single == a ? b : a;
+    if (single->lo == single->hi && other->lo == single->lo) {
+        other->lo++;
+    }
+    else if (single->lo == single->hi && other->hi == single->lo) {
+        other->hi--;
+    }
+    return true;
+}
+
+/*
+ * Computes the state along one edge out of a block, given the state at the
+ * end of the block: the ranges of the branch's operands are narrowed to the
+ * values that take the edge. Returns false if no values can take it.
+ */
+bool edge_state(ir_block_t *block, size_t succ, range_t *state) {
+    ir_term_t *term = &block->term;
+    if (term->kind != TERM_BRANCH) {
+        return true;
+    }
+    ir_cond_t cond = succ == 0 ? term->cond : negate_cond(term->cond);
+    if (!term->a.is_imm && !term->b.is_imm && term->a.value == term->b.value) {
+        return cond == COND_EQ || cond == COND_LE || cond == COND_GE;
+    }
+    range_t a = operand_range(term->a, state);
+    range_t b = operand_range(term->b, state);
+    if (!refine_ranges(cond, &a, &b)) {
+        return false;
+    }
+    if (!term->a.is_imm) {
+        state[term->a.value] = a;
+    }
+    if (!term->b.is_imm) {
+        state[term->b.value] = b;
+    }
+    return true;
+}
+
+/*
+ * Computes the state at the end of a block from the state on entry to it.
+ */
+void block_ranges(ir_block_t *block, range_t *state) {
+    for (size_t j = 0; j < block->num_instrs; j++) {
+        apply_range(&block->instrs[j], state);
+    }
+}
+
+/*
+ * Sorts numbers in increasing order.
+ */
+int compare_thresholds(const void *a, const void *b) {
+    value_t value_a = *(value_t *) a;
+    value_t value_b = *(value_t *) b;
+    return value_a < value_b ? -1 : value_a > value_b ? 1 : 0;
+}
+
+/*
+ * Collects the thresholds widening can stop at: each constant a branch
+ * compares against and its neighbors, where a loop's exit test puts the
+ * bound of its counter, and the fixed thresholds.
+ */
+void find_thresholds(range_data *data) {
+    ir_program_t *program = data->program;
+    data->thresholds =
+        malloc((3 * 2 * program->num_blocks + NUM_FIXED_THRESHOLDS) * sizeof(value_t));
+    assert(data->thresholds != NULL);
+    memcpy(data->thresholds, FIXED_THRESHOLDS, sizeof(FIXED_THRESHOLDS));
+    size_t count = NUM_FIXED_THRESHOLDS;
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_term_t *term = &program->blocks[i]->term;
+        for (size_t k = 0; k < 2 && term->kind == TERM_BRANCH; k++) {
+            ir_operand_t operand = k == 0 ? term->a : term->b;
+            if (!operand.is_imm) {
+                continue;
+            }
+            data->thresholds[count++] = operand.imm;
+            if (operand.imm > INT64_MIN) {
+                data->thresholds[count++] = operand.imm - 1;
+            }
+            if (operand.imm < INT64_MAX) {
+                data->thresholds[count++] = operand.imm + 1;
+            }
+        }
+    }
+    qsort(data->thresholds, count, sizeof(value_t), compare_thresholds);
+    data->num_thresholds = count;
+}
+
+/*
+ * Widens a bound that grew past its old value to the nearest threshold at or
+ * beyond the new value (upwards if up, otherwise downwards), or the extreme
+ * if there is none.
+ */
+value_t widen_bound(value_t bound, bool up, range_data *data) {
+    for (size_t i = 0; i < data->num_thresholds; i++) {
+        value_t threshold = data->thresholds[up ? i : data->num_thresholds - 1 - i];
+        if (up ? threshold >= bound : threshold <= bound) {
+            return threshold;
+        }
+    }
+    return up ? INT64_MAX : INT64_MIN;
+}
+
+/*
+ * Widens a block's entry state to include the values along one more path.
+ * Once the state of a block that starts a cycle has grown WIDEN_AFTER times,
+ * a bound that grows jumps to the next threshold, so every loop stabilizes
+ * after a few passes. Other blocks are never widened, so the bounds a loop's
+ * exit test places on the loop body survive. Returns true iff the entry
+ * state changed.
+ */
+bool join_ranges(ir_block_t *block, range_t *from, range_data *data) {
+    range_t *into = data->in_states[block->id];
+    size_t num_values = data->program->num_values;
+    if (!data->executable[block->id]) {
+        memcpy(into, from, num_values * sizeof(range_t));
+        return true;
+    }
+    bool widen = data->widens[block->id] && data->updates[block->id] >= WIDEN_AFTER;
+    bool changed = false;
+    for (size_t v = 0; v < num_values; v++) {
+        if (from[v].lo < into[v].lo) {
+            into[v].lo = widen ? widen_bound(from[v].lo, false, data) : from[v].lo;
+            changed = true;
+        }
+        if (from[v].hi > into[v].hi) {
+            into[v].hi = widen ? widen_bound(from[v].hi, true, data) : from[v].hi;
+            changed = true;
+        }
+    }
+    data->updates[block->id] += changed;
+    return changed;
+}
+
+/*
+ * Propagates the state at the end of a block along the edges whose conditions
+ * can hold, queueing the successors whose entry states change.
+ */
+void propagate_ranges(ir_block_t *block, range_t *state, range_t *scratch,
+                      range_data *data) {
+    size_t num_values = data->program->num_values;
+    for (size_t s = 0; s < num_succs(block); s++) {
+        memcpy(scratch, state, num_values * sizeof(range_t));
+        if (!edge_state(block, s, scratch)) {
+            continue;
+        }
+        ir_block_t *succ = block->term.targets[s];
+        bool changed = join_ranges(succ, scratch, data);
+        data->executable[succ->id] = true;
+        if (changed && !data->queued[succ->id]) {
+            data->queued[succ->id] = true;
+            data->worklist[data->worklist_size++] = succ;
+        }
+    }
+}
+
+/*
+ * Recomputes each block's entry state from its predecessors' without
+ * widening, visiting the blocks in reverse postorder (sequence lists them in
+ * postorder, ending with the entry block). Starting from states that already
+ * include every number each value can hold, each recomputation still does,
+ * but recovers bounds that widening gave up, like those a loop's exit test
+ * places on its counter.
+ */
+void narrow_states(size_t *sequence, size_t count, range_data *data) {
+    ir_program_t *program = data->program;
+    size_t num_values = program->num_values;
+    range_t *state = malloc(num_values * sizeof(range_t));
+    range_t *joined = malloc(num_values * sizeof(range_t));
+    assert(state != NULL && joined != NULL);
+    for (size_t round = 0; round < NARROWING_ROUNDS; round++) {
+        for (size_t i = count - 1; i-- > 0;) {
+            ir_block_t *block = program->blocks[sequence[i]];
+            bool reached = false;
+            for (size_t p = 0; p < block->num_preds; p++) {
+                ir_block_t *pred = block->preds[p];
+                if (!data->executable[pred->id]) {
+                    continue;
+                }
+                for (size_t s = 0; s < num_succs(pred); s++) {
+                    if (pred->term.targets[s] != block) {
+                        continue;
+                    }
+                    memcpy(state, data->in_states[pred->id],
+                           num_values * sizeof(range_t));
+                    block_ranges(pred, state);
+                    if (!edge_state(pred, s, state)) {
+                        continue;
+                    }
+                    if (!reached) {
+                        memcpy(joined, state, num_values * sizeof(range_t));
+                    }
+                    for (size_t v = 0; v < num_values && reached; v++) {
+                        joined[v] = union_range(joined[v], state[v]);
+                    }
+                    reached = true;
+                }
+            }
+            data->executable[block->id] = reached;
+            if (reached) {
+                memcpy(data->in_states[block->id], joined, num_values * sizeof(range_t));
+            }
+        }
+    }
+    free(state);
+    free(joined);
+}
+
+/*
+ * Records what a state proves about a division's operands.
+ */
+void classify_division(ir_instr_t *instr, range_t *state, ir_stats_t *stats) {
+    range_t a = operand_range(instr->a, state);
+    range_t b = operand_range(instr->b, state);
+    instr->range = RANGE_ANY;
+    if (a.lo >= 0 && a.hi <= UINT32_MAX && b.lo >= 1 && b.hi <= UINT32_MAX) {
+        instr->range = RANGE_32_BIT;
+    }
+    else if (a.lo >= 0) {
+        instr->range = RANGE_NON_NEGATIVE;
+    }
+    stats->narrowed_divisions += instr->range != RANGE_ANY;
+}
+
+/*
+ * Rewrites an executable block given the ranges on entry to it: divisions
+ * record what is known about their operands, and a branch that only one edge
+ * can take becomes a jump.
+ */
+void narrow_block(ir_block_t *block, range_t *state, range_t *scratch, range_data *data) {
+    ir_program_t *program = data->program;
+    for (size_t j = 0; j < block->num_instrs; j++) {
+        ir_instr_t *instr = &block->instrs[j];
+        if (instr->op == IR_DIV || instr->op == IR_MOD) {
+            classify_division(instr, state, &program->stats);
+        }
+        apply_range(instr, state);
+    }
+    if (block->term.kind != TERM_BRANCH) {
+        return;
+    }
+    bool feasible[2];
+    for (size_t s = 0; s < 2; s++) {
+        memcpy(scratch, state, program->num_values * sizeof(range_t));
+        feasible[s] = edge_state(block, s, scratch);
+    }
+    if (feasible[0] != feasible[1]) {
+        block->term.kind = TERM_JUMP;
+        block->term.targets[0] = block->term.targets[feasible[0] ? 0 : 1];
+        program->stats.folded_branches++;
+    }
+}
+
+void narrow_ranges(ir_program_t *program) {
+    compute_preds(program);
+    size_t n = program->num_blocks;
+    size_t num_values = program->num_values;
+    range_data data;
+    data.program = program;
+    data.in_states = malloc(n * sizeof(range_t *));
+    data.executable = calloc(n, sizeof(bool));
+    data.updates = calloc(n, sizeof(size_t));
+    data.widens = calloc(n, sizeof(bool));
+    data.worklist = malloc(n * sizeof(ir_block_t *));
+    data.queued = calloc(n, sizeof(bool));
+    range_t *state = malloc(num_values * sizeof(range_t));
+    range_t *scratch = malloc(num_values * sizeof(range_t));
+    size_t *order = malloc(n * sizeof(size_t));
+    size_t *sequence = malloc(n * sizeof(size_t));
+    bool *visited = calloc(n, sizeof(bool));
+    assert(data.in_states != NULL && data.executable != NULL && data.updates != NULL &&
+           data.widens != NULL && data.worklist != NULL && data.queued != NULL &&
+           state != NULL && scratch != NULL && order != NULL && sequence != NULL &&
+           visited != NULL);
+    for (size_t i = 0; i < n; i++) {
+        data.in_states[i] = malloc(num_values * sizeof(range_t));
+        assert(data.in_states[i] != NULL);
+    }
+
+    // A cycle must contain an edge to a block that comes no later in postorder.
+    size_t count = 0;
+    postorder(program->blocks[0], visited, order, &count);
+    for (size_t i = 0; i < n; i++) {
+        if (!visited[i]) {
+            continue;
+        }
+        sequence[order[i]] = i;
+        ir_block_t *block = program->blocks[i];
+        for (size_t p = 0; p < block->num_preds; p++) {
+            size_t pred = block->preds[p]->id;
+            data.widens[i] |= visited[pred] && order[pred] <= order[i];
+        }
+    }
+
+    find_thresholds(&data);
+
+    // Nothing is known about values on entry, including uninitialized variables.
+    for (size_t v = 0; v < num_values; v++) {
+        data.in_states[0][v] = FULL_RANGE;
+    }
+    data.executable[0] = true;
+    data.queued[0] = true;
+    data.worklist[0] = program->blocks[0];
+    data.worklist_size = 1;
+    while (data.worklist_size > 0) {
+        ir_block_t *block = data.worklist[--data.worklist_size];
+        data.queued[block->id] = false;
+        memcpy(state, data.in_states[block->id], num_values * sizeof(range_t));
+        block_ranges(block, state);
+        propagate_ranges(block, state, scratch, &data);
+    }
+
+    narrow_states(sequence, count, &data);
+
+    for (size_t i = 0; i < n; i++) {
+        if (data.executable[i]) {
+            memcpy(state, data.in_states[i], num_values * sizeof(range_t));
+            narrow_block(program->blocks[i], state, scratch, &data);
+        }
+        free(data.in_states[i]);
+    }
+    free(data.in_states);
+    free(data.executable);
+    free(data.updates);
+    free(data.widens);
+    free(data.thresholds);
+    free(data.worklist);
+    free(data.queued);
+    free(state);
+    free(scratch);
+    free(order);
+    free(sequence);
+    free(visited);
+    remove_unreachable(program);
+}
@@ -0,0 +1,523 @@
+#include "passes.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+typedef struct {
+    ir_program_t *program;
+    // uses[v] is the number of operands reading value v
+    size_t *uses;
+    // The index in the current block of the operation assigning each
+    // temporary, or NO_DEF if the block has not assigned it yet
+    size_t *def_index;
+} reassociation_data;
+
+typedef enum {
+    /** The operation could not be simplified */
+    UNCHANGED,
+    /** The operation was rewritten in place */
+    REWRITTEN,
+    /** An earlier operation was moved next to it, so indices have changed */
+    MOVED
+} simplification_t;
+
+// Marks a temporary that the current block has not assigned
+const size_t NO_DEF = SIZE_MAX;
+
+/*
+ * Adds delta to the use count of an operand's value.
+ */
+void count_use(ir_operand_t operand, int delta, reassociation_data *data) {
+    if (!operand.is_imm) {
+        data->uses[operand.value] += delta;
+    }
+}
+
+/*
+ * Replaces an instruction, keeping the use counts up to date.
+ */
+void replace_instr(ir_instr_t *instr, ir_instr_t replacement, reassociation_data *data) {
+    count_use(instr->a, -1, data);
+    if (is_binary(instr->op)) {
+        count_use(instr->b, -1, data);
+    }
+    count_use(replacement.a, 1, data);
+    if (is_binary(replacement.op)) {
+        count_use(replacement.b, 1, data);
+    }
+    *instr = replacement;
+}
+
+/*
+ * Constructs the instruction `dest = a op b`.
+ */
+ir_instr_t binary_instr(ir_op_t op, size_t dest, ir_operand_t a, ir_operand_t b) {
+    ir_instr_t instr = {.op = op, .dest = dest, .a = a, .b = b};
+    return instr;
+}
+
+/*
+ * Rewrites an instruction into `dest = a op b`.
+ */
+simplification_t rewrite_binary(ir_instr_t *instr, ir_op_t op, ir_operand_t a,
+                                ir_operand_t b, reassociation_data *data) {
+    replace_instr(instr, binary_instr(op, instr->dest, a, b), data);
+    return REWRITTEN;
+}
+
+/*
+ * Rewrites an instruction into `dest = a`.
+ */
+simplification_t rewrite_copy(ir_instr_t *instr, ir_operand_t a,
+                              reassociation_data *data) {
+    ir_instr_t replacement = {.op = IR_MOV, .dest = instr->dest, .a = a};
+    replace_instr(instr, replacement, data);
+    return REWRITTEN;
+}
+
+/*
+ * Returns true iff an operand is the constant c.
+ */
+bool is_constant(ir_operand_t operand, value_t c) {
+    return operand.is_imm && operand.imm == c;
+}
+
+/*
+ * Puts operations into the forms the other rules expect: the constant operand
+ * of + and * goes second, and subtracting a constant adds its negation.
+ */
+bool normalize_operands(ir_instr_t *instr) {
+    if ((instr->op == IR_ADD || instr->op == IR_MUL) && instr->a.is_imm &&
+        !instr->b.is_imm) {
+        ir_operand_t a = instr->a;
+        instr->a = instr->b;
+        instr->b = a;
+        return true;
+    }
+    if (instr->op == IR_SUB && !instr->a.is_imm && instr->b.is_imm) {
+        instr->op = IR_ADD;
+        instr->b.imm = -(uint64_t) instr->b.imm;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Returns the operation in block before index j that assigns the temporary an
+ * operand reads, if its operands still hold the same values at j.
+ * Returns NULL if there is no such operation.
+ */
+ir_instr_t *operand_def(ir_operand_t operand, ir_block_t *block, size_t j,
+                        reassociation_data *data) {
+    if (operand.is_imm || data->def_index[operand.value] == NO_DEF) {
+        return NULL;
+    }
+    size_t p = data->def_index[operand.value];
+    ir_instr_t *def = &block->instrs[p];
+    for (size_t k = p + 1; k < j; k++) {
+        ir_instr_t *instr = &block->instrs[k];
+        if (has_dest(instr) && ((!def->a.is_imm && def->a.value == instr->dest) ||
+                                (!def->b.is_imm && def->b.value == instr->dest))) {
+            return NULL;
+        }
+    }
+    return def;
+}
+
+/*
+ * Applies the identities x + 0 = x * 1 = x / 1 = x, x * 0 = x - x = x % 1 = 0,
+ * and x * -1 = 0 - x, and folds operations on two constants.
+ */
+simplification_t apply_identities(ir_instr_t *instr, reassociation_data *data) {
+    ir_operand_t a = instr->a, b = instr->b;
+    value_t result;
+    if (a.is_imm && b.is_imm && fold_op(instr->op, a.imm, b.imm, &result)) {
+        return rewrite_copy(instr, imm_operand(result), data);
+    }
+    if ((instr->op == IR_ADD && is_constant(b, 0)) ||
+        ((instr->op == IR_MUL || instr->op == IR_DIV) && is_constant(b, 1))) {
+        return rewrite_copy(instr, a, data);
+    }
+    if ((instr->op == IR_MUL && is_constant(b, 0)) ||
+        (instr->op == IR_SUB && !a.is_imm && same_operand(a, b)) ||
+        (instr->op == IR_MOD && is_constant(b, 1))) {
+        return rewrite_copy(instr, imm_operand(0), data);
+    }
+    if (instr->op == IR_MUL && is_constant(b, -1)) {
+        return rewrite_binary(instr, IR_SUB, imm_operand(0), a, data);
+    }
+    return UNCHANGED;
+}
+
+/*
+ * Combines an operation on a constant with the operation on a constant that
+ * computes its other operand: (x + k) + c = x + (k + c), c - (k - x) = x + (c - k),
+ * (x * k) * c = x * (k * c), (0 - x) * c = x * -c, and so on.
+ * Every identity holds with wrapping arithmetic. Nested divisions are only
+ * combined when both divisors are positive and their product does not overflow,
+ * which is exactly when truncating twice is the same as truncating once.
+ */
+simplification_t combine_constants(ir_instr_t *instr, ir_instr_t *def,
+                                   reassociation_data *data) {
+    ir_operand_t x = def->a;
+    value_t k = def->b.imm;
+    bool def_adds = def->op == IR_ADD && def->b.is_imm;
+    bool def_negates = def->op == IR_SUB && def->a.is_imm && !def->b.is_imm;
+    bool def_scales = def->op == IR_MUL && def->b.is_imm;
+    if (def_negates) {
+        x = def->b;
+        k = def->a.imm;
+    }
+    uint64_t c = instr->op == IR_SUB ? instr->a.imm : instr->b.imm;
+
+    if (instr->op == IR_ADD && def_adds) {
+        return rewrite_binary(instr, IR_ADD, x, imm_operand(k + c), data);
+    }
+    if (instr->op == IR_ADD && def_negates) {
+        return rewrite_binary(instr, IR_SUB, imm_operand(k + c), x, data);
+    }
+    if (instr->op == IR_SUB && def_adds) {
+        return rewrite_binary(instr, IR_SUB, imm_operand(c - k), x, data);
+    }
+    if (instr->op == IR_SUB && def_negates) {
+        return rewrite_binary(instr, IR_ADD, x, imm_operand(c - k), data);
+    }
+    if (instr->op == IR_SUB && c == 0 && def_scales) {
+        return rewrite_binary(instr, IR_MUL, x, imm_operand(-(uint64_t) k), data);
+    }
+    if (instr->op == IR_SUB && c == 0 && def->op == IR_SUB && !def->a.is_imm) {
+        return rewrite_binary(instr, IR_SUB, def->b, def->a, data);
+    }
+    if (instr->op == IR_MUL && def_scales) {
+        return rewrite_binary(instr, IR_MUL, x, imm_operand((uint64_t) k * c), data);
+    }
+    if (instr->op == IR_MUL && def_negates && k == 0) {
+        return rewrite_binary(instr, IR_MUL, x, imm_operand(-c), data);
+    }
+    if (instr->op == IR_DIV && def->op == IR_DIV && def->b.is_imm && k > 0 &&
+        (value_t) c > 0 && k <= INT64_MAX / (value_t) c) {
+        return rewrite_binary(instr, IR_DIV, x, imm_operand(k * c), data);
+    }
+    return UNCHANGED;
+}
+
+/*
+ * Removes negations feeding additions and subtractions:
+ * a + (0 - y) = a - y, (0 - y) + b = b - y, and a - (0 - y) = a + y.
+ */
+simplification_t remove_negation(ir_instr_t *instr, ir_instr_t *def_a,
+                                 ir_instr_t *def_b, reassociation_data *data) {
+    bool a_negated = def_a != NULL && def_a->op == IR_SUB && is_constant(def_a->a, 0);
+    bool b_negated = def_b != NULL && def_b->op == IR_SUB && is_constant(def_b->a, 0);
+    if (instr->op == IR_ADD && b_negated) {
+        return rewrite_binary(instr, IR_SUB, instr->a, def_b->b, data);
+    }
+    if (instr->op == IR_ADD && a_negated) {
+        return rewrite_binary(instr, IR_SUB, instr->b, def_a->b, data);
+    }
+    if (instr->op == IR_SUB && b_negated) {
+        return rewrite_binary(instr, IR_ADD, instr->a, def_b->b, data);
+    }
+    return UNCHANGED;
+}
+
+/*
+ * Recognizes the remainder idiom, so one idivq computes what a division and a
+ * multiplication did: x - x / y * y becomes x % y, and x / y * y on its own
+ * becomes x - x % y when nothing else reads the quotient (the division is
+ * rewritten in place). Also applies x - (x - r) = r, which finishes the
+ * rewrite when both forms apply. Division by a constant is left alone, since
+ * it is already done without idivq.
+ */
+simplification_t fuse_remainder(ir_instr_t *instr, ir_instr_t *def_a, ir_instr_t *def_b,
+                                ir_block_t *block, size_t j, reassociation_data *data) {
+    if (instr->op == IR_SUB && def_b != NULL && def_b->op == IR_SUB &&
+        same_operand(def_b->a, instr->a)) {
+        return rewrite_copy(instr, def_b->b, data);
+    }
+    ir_instr_t *product = instr->op == IR_SUB ? def_b : instr;
+    if (product == NULL || product->op != IR_MUL || product->b.is_imm) {
+        return UNCHANGED;
+    }
+    ir_instr_t *quotient_def = instr->op == IR_SUB ? NULL : def_a;
+    ir_operand_t quotient = product->a, divisor = product->b;
+    if (instr->op == IR_SUB) {
+        quotient_def = operand_def(quotient, block, j, data);
+    }
+    if (quotient_def == NULL || quotient_def->op != IR_DIV) {
+        quotient = product->b;
+        divisor = product->a;
+        quotient_def = instr->op == IR_SUB ? operand_def(quotient, block, j, data)
+                                           : def_b;
+    }
+    if (quotient_def == NULL || quotient_def->op != IR_DIV ||
+        !same_operand(quotient_def->b, divisor)) {
+        return UNCHANGED;
+    }
+    ir_operand_t dividend = quotient_def->a;
+    if (instr->op == IR_SUB && same_operand(instr->a, dividend)) {
+        return rewrite_binary(instr, IR_MOD, dividend, divisor, data);
+    }
+    if (instr->op == IR_MUL && data->uses[quotient.value] == 1) {
+        ir_instr_t remainder = *quotient_def;
+        remainder.op = IR_MOD;
+        replace_instr(quotient_def, remainder, data);
+        return rewrite_binary(instr, IR_SUB, dividend, quotient, data);
+    }
+    return UNCHANGED;
+}
+
+/*
+ * Moves the constant out of an operand of an operation on two values, so it
+ * can combine with constants further out: (x + k) + b becomes (x + b) + k,
+ * a - (y + k) becomes (a - y) + -k, (x * k) * b becomes (x * b) * k, and so on.
+ * The operation computing the operand is only read here, so it is rewritten
+ * and moved to just before index j instead of adding an operation.
+ */
+simplification_t sink_constant(ir_block_t *block, size_t j, ir_instr_t *def,
+                               bool def_is_a, reassociation_data *data) {
+    ir_instr_t *instr = &block->instrs[j];
+    size_t temp = def->dest;
+    if (data->uses[temp] != 1 || (def_is_a && instr->b.is_imm) ||
+        (!def_is_a && instr->a.is_imm)) {
+        return UNCHANGED;
+    }
+    ir_operand_t other = def_is_a ? instr->b : instr->a;
+    bool def_adds = def->op == IR_ADD && def->b.is_imm;
+    bool def_negates = def->op == IR_SUB && def->a.is_imm && !def->b.is_imm;
+    bool def_scales = def->op == IR_MUL && def->b.is_imm;
+    ir_instr_t inner = {.dest = temp};
+    ir_instr_t outer = {.dest = instr->dest, .a = value_operand(temp)};
+    if (instr->op == IR_ADD && def_adds) {
+        // (x + k) + b = (x + b) + k
+        inner = binary_instr(IR_ADD, temp, def->a, other);
+        outer.op = IR_ADD;
+        outer.b = def->b;
+    }
+    else if (instr->op == IR_ADD && def_negates) {
+        // (k - x) + b = k - (x - b)
+        inner = binary_instr(IR_SUB, temp, def->b, other);
+        outer = binary_instr(IR_SUB, instr->dest, def->a, value_operand(temp));
+    }
+    else if (instr->op == IR_SUB && def_adds) {
+        // (x + k) - b = (x - b) + k and a - (y + k) = (a - y) + -k
+        inner = def_is_a ? binary_instr(IR_SUB, temp, def->a, other)
+                         : binary_instr(IR_SUB, temp, other, def->a);
+        outer.op = IR_ADD;
+        outer.b = def_is_a ? def->b : imm_operand(-(uint64_t) def->b.imm);
+    }
+    else if (instr->op == IR_SUB && def_negates && def_is_a) {
+        // (k - x) - b = k - (x + b)
+        inner = binary_instr(IR_ADD, temp, def->b, other);
+        outer = binary_instr(IR_SUB, instr->dest, def->a, value_operand(temp));
+    }
+    else if (instr->op == IR_SUB && def_negates) {
+        // a - (k - y) = (a + y) + -k
+        inner = binary_instr(IR_ADD, temp, other, def->b);
+        outer.op = IR_ADD;
+        outer.b = imm_operand(-(uint64_t) def->a.imm);
+    }
+    else if (instr->op == IR_MUL && def_scales) {
+        // (x * k) * b = (x * b) * k
+        inner = binary_instr(IR_MUL, temp, def->a, other);
+        outer.op = IR_MUL;
+        outer.b = def->b;
+    }
+    else {
+        return UNCHANGED;
+    }
+
+    size_t p = data->def_index[temp];
+    replace_instr(&block->instrs[p], inner, data);
+    replace_instr(instr, outer, data);
+    remove_instr(block, p);
+    insert_instr(block, j - 1, inner);
+    return MOVED;
+}
+
+/*
+ * Simplifies the operation at index j of a block using the operations in the
+ * block that compute its operands.
+ */
+simplification_t simplify_operation(ir_block_t *block, size_t j,
+                                    reassociation_data *data) {
+    ir_instr_t *instr = &block->instrs[j];
+    if (!is_binary(instr->op)) {
+        return UNCHANGED;
+    }
+    simplification_t result = normalize_operands(instr) ? REWRITTEN : UNCHANGED;
+    simplification_t identity = apply_identities(instr, data);
+    if (identity != UNCHANGED || !is_binary(instr->op)) {
+        return identity != UNCHANGED ? identity : result;
+    }
+
+    ir_instr_t *def_a = operand_def(instr->a, block, j, data);
+    ir_instr_t *def_b = operand_def(instr->b, block, j, data);
+    if (instr->op == IR_SUB && instr->a.is_imm && def_b != NULL) {
+        simplification_t combined = combine_constants(instr, def_b, data);
+        if (combined != UNCHANGED) {
+            return combined;
+        }
+    }
+    else if (instr->b.is_imm && def_a != NULL) {
+        simplification_t combined = combine_constants(instr, def_a, data);
+        if (combined != UNCHANGED) {
+            return combined;
+        }
+    }
+    if (instr->a.is_imm || instr->b.is_imm) {
+        return result;
+    }
+
+    simplification_t removed = remove_negation(instr, def_a, def_b, data);
+    if (removed != UNCHANGED) {
+        return removed;
+    }
+    simplification_t fused = fuse_remainder(instr, def_a, def_b, block, j, data);
+    if (fused != UNCHANGED) {
+        return fused;
+    }
+    if (def_a != NULL && sink_constant(block, j, def_a, true, data) == MOVED) {
+        return MOVED;
+    }
+    if (def_b != NULL && sink_constant(block, j, def_b, false, data) == MOVED) {
+        return MOVED;
+    }
+    return result;
+}
+
+/*
+ * Simplifies a branch testing whether x - y equals x into one testing
+ * whether y equals 0, which holds with wrapping arithmetic.
+ */
+void simplify_branch(ir_block_t *block, reassociation_data *data) {
+    ir_term_t *term = &block->term;
+    if (term->kind != TERM_BRANCH || (term->cond != COND_EQ && term->cond != COND_NE)) {
+        return;
+    }
+    for (size_t side = 0; side < 2; side++) {
+        ir_operand_t *difference = side == 0 ? &term->a : &term->b;
+        ir_operand_t *other = side == 0 ? &term->b : &term->a;
+        ir_instr_t *def = operand_def(*difference, block, block->num_instrs, data);
+        if (def != NULL && def->op == IR_SUB && same_operand(def->a, *other)) {
+            count_use(*difference, -1, data);
+            count_use(*other, -1, data);
+            count_use(def->b, 1, data);
+            *difference = def->b;
+            *other = imm_operand(0);
+            return;
+        }
+    }
+}
+
+/*
+ * Returns true iff an operation reads a value.
+ */
+bool reads_value(ir_instr_t *instr, size_t value) {
+    return (!instr->a.is_imm && instr->a.value == value) ||
+           (is_binary(instr->op) && !instr->b.is_imm && instr->b.value == value);
+}
+
+/*
+ * Moves each remainder up to just after the earliest division of the same
+ * operands before it in the block, so the emitter computes both with one
+ * idivq. The operations in between must not assign the operands, or read or
+ * assign the remainder. Division by a constant is left alone, as in
+ * fuse_remainder().
+ */
+void pair_remainders(ir_block_t *block) {
+    for (size_t j = 1; j < block->num_instrs; j++) {
+        ir_instr_t remainder = block->instrs[j];
+        if (remainder.op != IR_MOD || remainder.b.is_imm) {
+            continue;
+        }
+        size_t pair = j;
+        for (size_t k = j; k-- > 0;) {
+            ir_instr_t *instr = &block->instrs[k];
+            if (has_dest(instr) &&
+                (instr->dest == remainder.dest ||
+                 (!remainder.a.is_imm && instr->dest == remainder.a.value) ||
+                 instr->dest == remainder.b.value)) {
+                break;
+            }
+            if (instr->op == IR_DIV && same_operand(instr->a, remainder.a) &&
+                same_operand(instr->b, remainder.b)) {
+                pair = k + 1;
+            }
+            if (reads_value(instr, remainder.dest)) {
+                break;
+            }
+        }
+        if (pair < j) {
+            remove_instr(block, j);
+            insert_instr(block, pair, remainder);
+        }
+    }
+}
+
+/*
+ * Marks the temporaries assigned in a block as not yet assigned.
+ */
+void forget_defs(ir_block_t *block, reassociation_data *data) {
+    for (size_t j = 0; j < block->num_instrs; j++) {
+        if (has_dest(&block->instrs[j])) {
+            data->def_index[block->instrs[j].dest] = NO_DEF;
+        }
+    }
+}
+
+/*
+ * Simplifies each operation in a block until none changes, starting over
+ * whenever an operation is moved.
+ */
+void reassociate_block(ir_block_t *block, reassociation_data *data) {
+    bool restart = true;
+    while (restart) {
+        restart = false;
+        forget_defs(block, data);
+        for (size_t j = 0; j < block->num_instrs && !restart; j++) {
+            simplification_t result;
+            do {
+                result = simplify_operation(block, j, data);
+            } while (result == REWRITTEN);
+            restart = result == MOVED;
+
+            ir_instr_t *instr = &block->instrs[j];
+            if (is_binary(instr->op) && data->program->names[instr->dest] == '\0') {
+                data->def_index[instr->dest] = j;
+            }
+        }
+    }
+    simplify_branch(block, data);
+    pair_remainders(block);
+    forget_defs(block, data);
+}
+
+void reassociate(ir_program_t *program) {
+    size_t n = program->num_values;
+    reassociation_data data = {.program = program};
+    data.uses = calloc(n, sizeof(size_t));
+    data.def_index = malloc(n * sizeof(size_t));
+    assert(data.uses != NULL && data.def_index != NULL);
+    for (size_t v = 0; v < n; v++) {
+        data.def_index[v] = NO_DEF;
+    }
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        ir_block_t *block = program->blocks[i];
+        for (size_t j = 0; j < block->num_instrs; j++) {
+            count_use(block->instrs[j].a, 1, &data);
+            if (is_binary(block->instrs[j].op)) {
+                count_use(block->instrs[j].b, 1, &data);
+            }
+        }
+        if (block->term.kind == TERM_BRANCH) {
+            count_use(block->term.a, 1, &data);
+            count_use(block->term.b, 1, &data);
+        }
+    }
+    for (size_t i = 0; i < program->num_blocks; i++) {
+        reassociate_block(program->blocks[i], &data);
+    }
+    free(data.uses);
+    free(data.def_index);
+}
@@ -0,0 +1,334 @@
+#include "regalloc.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Returns the number of 64-bit words in a row of the edge matrix.
+ */
+size_t row_words(graph_t *graph) {
+    return (graph->num_nodes + 63) / 64;
+}
+
+/*
+ * Returns the row of the edge matrix listing the neighbors of node.
+ */
+uint64_t *row(graph_t *graph, size_t node) {
+    return graph->edges + node * row_words(graph);
+}
+
+graph_t *init_graph(size_t num_nodes, uint8_t num_colors) {
+    assert(num_nodes >= num_colors);
+    graph_t *graph = malloc(sizeof(graph_t));
+    assert(graph != NULL);
+    graph->num_nodes = num_nodes;
+    graph->num_colors = num_colors;
+    graph->edges = calloc(num_nodes * row_words(graph), sizeof(uint64_t));
+    graph->costs = calloc(num_nodes, sizeof(uint64_t));
+    graph->colors = malloc(num_nodes * sizeof(int8_t));
+    assert(graph->edges != NULL && graph->costs != NULL && graph->colors != NULL);
+    graph->moves = NULL;
+    graph->num_moves = 0;
+    graph->moves_capacity = 0;
+    graph->coalesced = 0;
+    for (size_t i = 0; i < num_nodes; i++) {
+        graph->colors[i] = i < num_colors ? (int8_t) i : SPILLED;
+    }
+
+    // Every register is distinct from every other register.
+    for (size_t i = 0; i < num_colors; i++) {
+        for (size_t j = i + 1; j < num_colors; j++) {
+            add_interference(graph, i, j);
+        }
+    }
+    return graph;
+}
+
+void add_interference(graph_t *graph, size_t a, size_t b) {
+    if (a == b) {
+        return;
+    }
+    row(graph, a)[b / 64] |= (uint64_t) 1 << (b % 64);
+    row(graph, b)[a / 64] |= (uint64_t) 1 << (a % 64);
+}
+
+bool interferes(graph_t *graph, size_t a, size_t b) {
+    return (row(graph, a)[b / 64] >> (b % 64)) & 1;
+}
+
+void add_cost(graph_t *graph, size_t node, uint64_t cost) {
+    if (graph->costs[node] > UINT64_MAX - cost) {
+        graph->costs[node] = UINT64_MAX;
+    }
+    else {
+        graph->costs[node] += cost;
+    }
+}
+
+void add_move(graph_t *graph, size_t a, size_t b, uint64_t weight, bool coalesce) {
+    if (a == b) {
+        return;
+    }
+    if (graph->num_moves == graph->moves_capacity) {
+        graph->moves_capacity =
+            graph->moves_capacity == 0 ? 16 : graph->moves_capacity * 2;
+        graph->moves = realloc(graph->moves, graph->moves_capacity * sizeof(move_t));
+        assert(graph->moves != NULL);
+    }
+    move_t *move = &graph->moves[graph->num_moves++];
+    move->a = a;
+    move->b = b;
+    move->weight = weight;
+    move->coalesce = coalesce;
+}
+
+/*
+ * Follows the chain of merged nodes to the node that represents node.
+ */
+size_t find(size_t *alias, size_t node) {
+    while (alias[node] != node) {
+        alias[node] = alias[alias[node]];
+        node = alias[node];
+    }
+    return node;
+}
+
+/*
+ * Counts the neighbors of node that are set in mask.
+ */
+size_t count_neighbors(graph_t *graph, size_t node, uint64_t *mask) {
+    uint64_t *neighbors = row(graph, node);
+    size_t count = 0;
+    for (size_t i = 0; i < row_words(graph); i++) {
+        count += __builtin_popcountll(neighbors[i] & mask[i]);
+    }
+    return count;
+}
+
+/*
+ * Briggs' test: nodes a and b can be merged without making the graph
+ * harder to color if the merged node has fewer than num_colors neighbors
+ * with num_colors or more neighbors of their own.
+ */
+bool can_merge(graph_t *graph, size_t a, size_t b, uint64_t *reps) {
+    size_t significant = 0;
+    for (size_t t = 0; t < graph->num_nodes; t++) {
+        if (!((reps[t / 64] >> (t % 64)) & 1) ||
+            !(interferes(graph, a, t) || interferes(graph, b, t))) {
+            continue;
+        }
+        size_t degree = count_neighbors(graph, t, reps);
+        if (interferes(graph, a, t) && interferes(graph, b, t)) {
+            degree--;
+        }
+        if (degree >= graph->num_colors && ++significant >= graph->num_colors) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * George's test for merging node b into the precolored node a: every
+ * neighbor of b already interferes with a or has few enough neighbors
+ * that it will be colorable anyway.
+ */
+bool can_merge_precolored(graph_t *graph, size_t a, size_t b, uint64_t *reps) {
+    for (size_t t = 0; t < graph->num_nodes; t++) {
+        if (!((reps[t / 64] >> (t % 64)) & 1) || !interferes(graph, b, t)) {
+            continue;
+        }
+        if (!interferes(graph, a, t) &&
+            count_neighbors(graph, t, reps) >= graph->num_colors) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Merges node b into node a, so a inherits b's edges and spill cost.
+ */
+void merge(graph_t *graph, size_t a, size_t b, size_t *alias, uint64_t *reps) {
+    uint64_t *a_row = row(graph, a);
+    uint64_t *b_row = row(graph, b);
+    for (size_t i = 0; i < row_words(graph); i++) {
+        a_row[i] |= b_row[i];
+    }
+    for (size_t t = 0; t < graph->num_nodes; t++) {
+        if (interferes(graph, b, t)) {
+            add_interference(graph, a, t);
+        }
+    }
+    add_cost(graph, a, graph->costs[b]);
+    alias[b] = a;
+    reps[b / 64] &= ~((uint64_t) 1 << (b % 64));
+    graph->coalesced++;
+}
+
+/*
+ * Sorts moves by decreasing weight, so the most frequently executed copies
+ * are the first to be coalesced.
+ */
+int compare_moves(const void *a, const void *b) {
+    uint64_t weight_a = ((move_t *) a)->weight;
+    uint64_t weight_b = ((move_t *) b)->weight;
+    return weight_a < weight_b ? 1 : weight_a > weight_b ? -1 : 0;
+}
+
+/*
+ * Merges the endpoints of copies conservatively, only when doing so
+ * cannot turn a colorable graph into an uncolorable one.
+ */
+void coalesce(graph_t *graph, size_t *alias, uint64_t *reps) {
+    qsort(graph->moves, graph->num_moves, sizeof(move_t), compare_moves);
+    for (size_t i = 0; i < graph->num_moves; i++) {
+        move_t *move = &graph->moves[i];
+        if (!move->coalesce) {
+            continue;
+        }
+        size_t a = find(alias, move->a);
+        size_t b = find(alias, move->b);
+        if (b < graph->num_colors) {
+            size_t tmp = a;
+            a = b;
+            b = tmp;
+        }
+        if (a == b || b < graph->num_colors || interferes(graph, a, b)) {
+            continue;
+        }
+        if (a < graph->num_colors ? can_merge_precolored(graph, a, b, reps)
+                                  : can_merge(graph, a, b, reps)) {
+            merge(graph, a, b, alias, reps);
+        }
+    }
+}
+
+/*
+ * Picks the color for node, preferring the colors of the nodes it is copied
+ * to or from so that the copies become no-ops.
+ * Returns SPILLED if every color is taken by a neighbor.
+ */
+int8_t pick_color(graph_t *graph, size_t node, size_t *alias, uint64_t *reps) {
+    bool *taken = calloc(graph->num_colors, sizeof(bool));
+    uint64_t *preference = calloc(graph->num_colors, sizeof(uint64_t));
+    assert(taken != NULL && preference != NULL);
+    for (size_t t = 0; t < graph->num_nodes; t++) {
+        if (((reps[t / 64] >> (t % 64)) & 1) && interferes(graph, node, t) &&
+            graph->colors[t] != SPILLED) {
+            taken[graph->colors[t]] = true;
+        }
+    }
+    for (size_t i = 0; i < graph->num_moves; i++) {
+        move_t *move = &graph->moves[i];
+        size_t a = find(alias, move->a);
+        size_t b = find(alias, move->b);
+        size_t other = a == node ? b : b == node ? a : node;
+        if (other != node && graph->colors[other] != SPILLED) {
+            preference[graph->colors[other]] += move->weight + 1;
+        }
+    }
+
+    int8_t color = SPILLED;
+    for (uint8_t c = 0; c < graph->num_colors; c++) {
+        if (!taken[c] && (color == SPILLED || preference[c] > preference[color])) {
+            color = c;
+        }
+    }
+    free(taken);
+    free(preference);
+    return color;
+}
+
+void color_graph(graph_t *graph) {
+    size_t n = graph->num_nodes;
+    size_t *alias = malloc(n * sizeof(size_t));
+    uint64_t *reps = calloc(row_words(graph), sizeof(uint64_t));
+    size_t *degrees = malloc(n * sizeof(size_t));
+    bool *removed = calloc(n, sizeof(bool));
+    size_t *stack = malloc(n * sizeof(size_t));
+    assert(alias != NULL && reps != NULL && degrees != NULL && removed != NULL &&
+           stack != NULL);
+    for (size_t i = 0; i < n; i++) {
+        alias[i] = i;
+        reps[i / 64] |= (uint64_t) 1 << (i % 64);
+    }
+
+    coalesce(graph, alias, reps);
+
+    // Simplify: repeatedly remove a node that is guaranteed a color.
+    size_t remaining = 0;
+    for (size_t i = graph->num_colors; i < n; i++) {
+        if (alias[i] == i) {
+            degrees[i] = count_neighbors(graph, i, reps);
+            remaining++;
+        }
+        else {
+            removed[i] = true;
+        }
+    }
+    for (size_t i = 0; i < graph->num_colors; i++) {
+        removed[i] = true;
+    }
+    size_t stack_size = 0;
+    while (remaining > 0) {
+        size_t chosen = n;
+        for (size_t i = graph->num_colors; i < n; i++) {
+            if (!removed[i] && degrees[i] < graph->num_colors) {
+                chosen = i;
+                break;
+            }
+        }
+
+        /*
+         * Every node left has many neighbors, so optimistically remove the
+         * one that is cheapest to spill relative to how many others it blocks.
+         * It may still get a color if its neighbors end up sharing colors.
+         */
+        if (chosen == n) {
+            for (size_t i = graph->num_colors; i < n; i++) {
+                if (removed[i]) {
+                    continue;
+                }
+                if (chosen == n ||
+                    (double) graph->costs[i] / (degrees[i] + 1) <
+                        (double) graph->costs[chosen] / (degrees[chosen] + 1)) {
+                    chosen = i;
+                }
+            }
+        }
+
+        removed[chosen] = true;
+        remaining--;
+        stack[stack_size++] = chosen;
+        for (size_t t = graph->num_colors; t < n; t++) {
+            if (!removed[t] && interferes(graph, chosen, t)) {
+                degrees[t]--;
+            }
+        }
+    }
+
+    // Select: give nodes colors in the reverse of the order they were removed.
+    while (stack_size > 0) {
+        size_t node = stack[--stack_size];
+        graph->colors[node] = pick_color(graph, node, alias, reps);
+    }
+    for (size_t i = graph->num_colors; i < n; i++) {
+        graph->colors[i] = graph->colors[find(alias, i)];
+    }
+
+    free(alias);
+    free(reps);
+    free(degrees);
+    free(removed);
+    free(stack);
+}
+
+void free_graph(graph_t *graph) {
+    free(graph->edges);
+    free(graph->costs);
+    free(graph->moves);
+    free(graph->colors);
+    free(graph);
+}
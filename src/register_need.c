@@ -0,0 +1,102 @@
+#include "register_need.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Returns the number of operations in an expression.
+ */
+size_t count_operations(node_t *node) {
+    if (node->type != BINARY_OP) {
+        return 0;
+    }
+    binary_node_t *bin_node = (binary_node_t *) node;
+    return 1 + count_operations(bin_node->left) + count_operations(bin_node->right);
+}
+
+/*
+ * Empties the labels, making room for those of the given number of operations
+ * with at most half the slots in use.
+ */
+void clear_labels(register_labels_t *labels, size_t operations) {
+    labels->capacity = 1;
+    while (labels->capacity < 2 * operations) {
+        labels->capacity *= 2;
+    }
+    if (labels->capacity > labels->allocated) {
+        labels->allocated = labels->capacity;
+        labels->nodes =
+            realloc(labels->nodes, sizeof(binary_node_t *[labels->allocated]));
+        labels->needs = realloc(labels->needs, sizeof(size_t[labels->allocated]));
+        assert(labels->nodes != NULL && labels->needs != NULL);
+    }
+    for (size_t i = 0; i < labels->capacity; i++) {
+        labels->nodes[i] = NULL;
+    }
+}
+
+/*
+ * Returns the slot holding an operation's label, claiming an empty one if it
+ * has none yet.
+ */
+size_t *label_slot(register_labels_t *labels, binary_node_t *bin_node) {
+    size_t slot = ((uintptr_t) bin_node >> 4) * 0x9E3779B97F4A7C15;
+    slot &= labels->capacity - 1;
+    while (labels->nodes[slot] != NULL && labels->nodes[slot] != bin_node) {
+        slot = (slot + 1) & (labels->capacity - 1);
+    }
+    labels->nodes[slot] = bin_node;
+    return &labels->needs[slot];
+}
+
+/*
+ * Returns the number of registers an operation needs when its operand
+ * evaluated first needs first registers and the other needs second: the
+ * result of the first is held while the second is evaluated.
+ */
+size_t combine_need(size_t first, size_t second) {
+    size_t need = second + (first > 0);
+    need = need > first ? need : first;
+    return need > 0 ? need : 1;
+}
+
+/*
+ * Labels the operations in an expression, returning the label of the whole
+ * expression and storing in fixed the number needed in left-to-right order.
+ */
+size_t label_operations(register_labels_t *labels, node_t *node, size_t *fixed) {
+    if (node->type != BINARY_OP) {
+        *fixed = 0;
+        return 0;
+    }
+    binary_node_t *bin_node = (binary_node_t *) node;
+    size_t left_fixed, right_fixed;
+    size_t left = label_operations(labels, bin_node->left, &left_fixed);
+    size_t right = label_operations(labels, bin_node->right, &right_fixed);
+    *fixed = combine_need(left_fixed, right_fixed);
+    size_t need = right > left ? combine_need(right, left) : combine_need(left, right);
+    *label_slot(labels, bin_node) = need;
+    return need;
+}
+
+size_t label_registers(register_labels_t *labels, node_t *node, size_t *fixed) {
+    clear_labels(labels, count_operations(node));
+    return label_operations(labels, node, fixed);
+}
+
+/*
+ * Returns the number of registers label_registers() found an expression needs.
+ */
+size_t stored_need(register_labels_t *labels, node_t *node) {
+    return node->type == BINARY_OP ? *label_slot(labels, (binary_node_t *) node) : 0;
+}
+
+bool right_first(register_labels_t *labels, binary_node_t *bin_node) {
+    return stored_need(labels, bin_node->right) > stored_need(labels, bin_node->left);
+}
+
+void free_labels(register_labels_t *labels) {
+    free(labels->nodes);
+    free(labels->needs);
+}
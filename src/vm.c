@@ -0,0 +1,159 @@
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "bytecode.h"
+
+// Continues at the instruction pc points to. Each handler ends with its own
+// indirect jump, so the processor predicts each one separately.
+#define DISPATCH() goto *HANDLERS[pc->op]
+// Continues at the next instruction
+#define NEXT()      \
+    do {            \
+        pc++;       \
+        DISPATCH(); \
+    } while (0)
+// Continues at the instruction's target if the condition holds
+#define BRANCH(condition)                              \
+    do {                                               \
+        pc = (condition) ? code + pc->target : pc + 1; \
+        DISPATCH();                                    \
+    } while (0)
+// Adds an OP_STEP instruction's step to its register
+#define STEP() regs[pc->dest] = (value_t) ((uint64_t) regs[pc->dest] + (int8_t) pc->a)
+// The handlers of the branches testing one condition, written as op
+#define CONDITION_HANDLERS(name, op)       \
+    branch_##name##_rr:                    \
+    BRANCH(regs[pc->a] op regs[pc->b]);    \
+    branch_##name##_rc:                    \
+    BRANCH(regs[pc->a] op pc->imm);        \
+    step_##name##_rr:                      \
+    STEP();                                \
+    BRANCH(regs[pc->dest] op regs[pc->b]); \
+    step_##name##_rc:                      \
+    STEP();                                \
+    BRANCH(regs[pc->dest] op pc->imm);
+
+/*
+ * Returns true iff dividing a by b traps, as idivq does.
+ */
+bool division_traps(value_t a, value_t b) {
+    return b == 0 || (a == INT64_MIN && b == -1);
+}
+
+bool run_bytecode(bytecode_t *bytecode, bool print) {
+    static void *const HANDLERS[NUM_OPCODES] = {
+        [OP_LOAD] = &&load,
+        [OP_MOVE] = &&move,
+        [OP_ADD_RR] = &&add_rr,
+        [OP_ADD_RC] = &&add_rc,
+        [OP_SUB_RR] = &&sub_rr,
+        [OP_SUB_RC] = &&sub_rc,
+        [OP_SUB_CR] = &&sub_cr,
+        [OP_MUL_RR] = &&mul_rr,
+        [OP_MUL_RC] = &&mul_rc,
+        [OP_DIV_RR] = &&div_rr,
+        [OP_DIV_RC] = &&div_rc,
+        [OP_DIV_CR] = &&div_cr,
+        [OP_PRINT_R] = &&print_r,
+        [OP_PRINT_C] = &&print_c,
+        [OP_JUMP] = &&jump,
+        [OP_BRANCH_LT_RR] = &&branch_lt_rr,
+        [OP_BRANCH_EQ_RR] = &&branch_eq_rr,
+        [OP_BRANCH_GT_RR] = &&branch_gt_rr,
+        [OP_BRANCH_LE_RR] = &&branch_le_rr,
+        [OP_BRANCH_NE_RR] = &&branch_ne_rr,
+        [OP_BRANCH_GE_RR] = &&branch_ge_rr,
+        [OP_BRANCH_LT_RC] = &&branch_lt_rc,
+        [OP_BRANCH_EQ_RC] = &&branch_eq_rc,
+        [OP_BRANCH_GT_RC] = &&branch_gt_rc,
+        [OP_BRANCH_LE_RC] = &&branch_le_rc,
+        [OP_BRANCH_NE_RC] = &&branch_ne_rc,
+        [OP_BRANCH_GE_RC] = &&branch_ge_rc,
+        [OP_STEP_LT_RR] = &&step_lt_rr,
+        [OP_STEP_EQ_RR] = &&step_eq_rr,
+        [OP_STEP_GT_RR] = &&step_gt_rr,
+        [OP_STEP_LE_RR] = &&step_le_rr,
+        [OP_STEP_NE_RR] = &&step_ne_rr,
+        [OP_STEP_GE_RR] = &&step_ge_rr,
+        [OP_STEP_LT_RC] = &&step_lt_rc,
+        [OP_STEP_EQ_RC] = &&step_eq_rc,
+        [OP_STEP_GT_RC] = &&step_gt_rc,
+        [OP_STEP_LE_RC] = &&step_le_rc,
+        [OP_STEP_NE_RC] = &&step_ne_rc,
+        [OP_STEP_GE_RC] = &&step_ge_rc,
+        [OP_HALT] = &&halt,
+    };
+    value_t regs[NUM_VM_REGS] = {0};
+    vm_instr_t *code = bytecode->instrs;
+    vm_instr_t *pc = code;
+    DISPATCH();
+
+    // Addition, subtraction and multiplication wrap around like the machine's
+load:
+    regs[pc->dest] = pc->imm;
+    NEXT();
+move:
+    regs[pc->dest] = regs[pc->a];
+    NEXT();
+add_rr:
+    regs[pc->dest] = (value_t) ((uint64_t) regs[pc->a] + (uint64_t) regs[pc->b]);
+    NEXT();
+add_rc:
+    regs[pc->dest] = (value_t) ((uint64_t) regs[pc->a] + (uint64_t) pc->imm);
+    NEXT();
+sub_rr:
+    regs[pc->dest] = (value_t) ((uint64_t) regs[pc->a] - (uint64_t) regs[pc->b]);
+    NEXT();
+sub_rc:
+    regs[pc->dest] = (value_t) ((uint64_t) regs[pc->a] - (uint64_t) pc->imm);
+    NEXT();
+sub_cr:
+    regs[pc->dest] = (value_t) ((uint64_t) pc->imm - (uint64_t) regs[pc->b]);
+    NEXT();
+mul_rr:
+    regs[pc->dest] = (value_t) ((uint64_t) regs[pc->a] * (uint64_t) regs[pc->b]);
+    NEXT();
+mul_rc:
+    regs[pc->dest] = (value_t) ((uint64_t) regs[pc->a] * (uint64_t) pc->imm);
+    NEXT();
+div_rr:
+    if (division_traps(regs[pc->a], regs[pc->b])) {
+        return false;
+    }
+    regs[pc->dest] = regs[pc->a] / regs[pc->b];
+    NEXT();
+div_rc:
+    if (division_traps(regs[pc->a], pc->imm)) {
+        return false;
+    }
+    regs[pc->dest] = regs[pc->a] / pc->imm;
+    NEXT();
+div_cr:
+    if (division_traps(pc->imm, regs[pc->b])) {
+        return false;
+    }
+    regs[pc->dest] = pc->imm / regs[pc->b];
+    NEXT();
+print_r:
+    if (print) {
+        printf("%" PRId64 "\n", regs[pc->a]);
+    }
+    NEXT();
+print_c:
+    if (print) {
+        printf("%" PRId64 "\n", pc->imm);
+    }
+    NEXT();
+jump:
+    BRANCH(true);
+
+    CONDITION_HANDLERS(lt, <)
+    CONDITION_HANDLERS(eq, ==)
+    CONDITION_HANDLERS(gt, >)
+    CONDITION_HANDLERS(le, <=)
+    CONDITION_HANDLERS(ne, !=)
+    CONDITION_HANDLERS(ge, >=)
+
+halt:
+    return true;
+}